@@ -0,0 +1,349 @@
+// Ahmiyat Blockchain - Admission benchmarks and consensus simulations
+
+#include "bench.h"
+#include "blockchain.h"
+#include "ecdsa_utils.h"
+#include "pow_kernel.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <map>
+#include <memory>
+#include <random>
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs fn(worker) on `threads` threads, worker = 0..threads-1
+template <typename Fn>
+static void runWorkers(unsigned threads, Fn fn) {
+    std::vector<std::thread> pool;
+    for (unsigned w = 0; w < threads; ++w) pool.emplace_back(fn, w);
+    for (auto& t : pool) t.join();
+}
+
+MempoolBenchReport runMempoolBench(const MempoolBenchConfig& config) {
+    MempoolBenchReport report;
+    report.threads = config.threads ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+    size_t total = config.wallets * config.txsPerWallet;
+    // In-memory database so the benchmark never touches the node's chain
+    Blockchain chain(":memory:");
+    chain.setMempoolLimits(total + 1, SIZE_MAX, 24 * 60 * 60);
+    double fee = chain.getTxFee();
+
+    // Setup: one key pair per wallet, nonces 1..M signed up front
+    auto setupStart = std::chrono::steady_clock::now();
+    std::vector<std::string> addresses(config.wallets);
+    std::vector<std::vector<Transaction>> txs(config.wallets);
+    runWorkers(report.threads, [&](unsigned worker) {
+        for (size_t w = worker; w < config.wallets; w += report.threads) {
+            std::string privPem, pubPem;
+            ECDSAUtils::generateKeyPair(privPem, pubPem);
+            addresses[w] = Wallet::publicKeyToAddress(pubPem);
+            for (size_t n = 1; n <= config.txsPerWallet; ++n) {
+                Transaction t = {addresses[w], "bench-receiver-" + std::to_string(n % 16), 1.0, "", pubPem, fee, n};
+                t.signature = ECDSAUtils::sign(Blockchain::txSigningData(t), privPem);
+                txs[w].push_back(t);
+            }
+        }
+    });
+    // One coin of headroom so float rounding in the pending-debit sum never rejects the last nonce
+    for (const auto& address : addresses) chain.creditBalance(address, (1.0 + fee) * config.txsPerWallet + 1.0);
+    report.setupSeconds = secondsSince(setupStart);
+
+    // Flood: each wallet stays on one thread so its nonces arrive in order
+    chain.resetAdmissionTimings();
+    std::vector<std::vector<double>> latencies(report.threads);
+    std::vector<size_t> accepted(report.threads, 0);
+    auto start = std::chrono::steady_clock::now();
+    runWorkers(report.threads, [&](unsigned worker) {
+        for (size_t n = 0; n < config.txsPerWallet; ++n) {
+            for (size_t w = worker; w < config.wallets; w += report.threads) {
+                auto callStart = std::chrono::steady_clock::now();
+                if (chain.addTransaction(txs[w][n])) ++accepted[worker];
+                latencies[worker].push_back(secondsSince(callStart) * 1e6);
+            }
+        }
+    });
+    report.seconds = secondsSince(start);
+
+    std::vector<double> all;
+    for (size_t w = 0; w < report.threads; ++w) {
+        report.accepted += accepted[w];
+        all.insert(all.end(), latencies[w].begin(), latencies[w].end());
+    }
+    report.submitted = all.size();
+    report.acceptedPerSecond = report.seconds > 0 ? report.accepted / report.seconds : 0;
+    if (!all.empty()) {
+        std::sort(all.begin(), all.end());
+        report.p50Micros = all[all.size() / 2];
+        report.p99Micros = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+    }
+    AdmissionTimings timings = chain.getAdmissionTimings();
+    if (timings.calls > 0) {
+        report.txIdMicros = timings.txIdNs / 1e3 / timings.calls;
+        report.addressMicros = timings.addressNs / 1e3 / timings.calls;
+        report.verifyMicros = timings.verifyNs / 1e3 / timings.calls;
+        report.admitMicros = timings.admitNs / 1e3 / timings.calls;
+    }
+    return report;
+}
+
+BftSimReport runBftSim(const BftSimConfig& config) {
+    BftSimReport report;
+    size_t nodes = std::max<size_t>(config.nodes, 1);
+    size_t byzantine = std::min(config.byzantine, nodes);
+    std::mt19937 rng(config.seed);
+    std::bernoulli_distribution dropped(std::min(std::max(config.dropRate, 0.0), 1.0));
+
+    // Setup: delegate keys and every vote signed up front, so the rounds time verification only
+    auto setupStart = std::chrono::steady_clock::now();
+    std::vector<std::string> privPems(nodes), pubPems(nodes);
+    std::map<std::string, double> voters;
+    for (size_t i = 0; i < nodes; ++i) {
+        ECDSAUtils::generateKeyPair(privPems[i], pubPems[i]);
+        voters[Wallet::publicKeyToAddress(pubPems[i])] = 1.0;
+    }
+    auto honestHash = [](size_t height) { return "block-" + std::to_string(height); };
+    std::vector<std::vector<FinalityVote>> rounds(config.blocks + 1);
+    for (size_t h = 1; h <= config.blocks; ++h) {
+        for (size_t i = 0; i < nodes; ++i) {
+            // Byzantine delegates sign the conflicting block first, so some nodes see that vote win
+            if (i >= nodes - byzantine) {
+                rounds[h].push_back(FinalityGadget::signVote("fork-" + std::to_string(h), (int)h, privPems[i], pubPems[i]));
+            }
+            rounds[h].push_back(FinalityGadget::signVote(honestHash(h), (int)h, privPems[i], pubPems[i]));
+        }
+    }
+    report.setupSeconds = secondsSince(setupStart);
+
+    std::vector<std::unique_ptr<FinalityGadget>> gadgets;
+    for (size_t n = 0; n < nodes; ++n) {
+        gadgets.push_back(std::make_unique<FinalityGadget>());
+        gadgets.back()->setVoters(voters);
+    }
+    double lagSum = 0;
+    for (size_t h = 1; h <= config.blocks; ++h) {
+        for (size_t n = 0; n < nodes; ++n) {
+            gadgets[n]->onBlock(honestHash(h), h > 1 ? honestHash(h - 1) : "genesis", (int)h);
+            gadgets[n]->onBlock("fork-" + std::to_string(h), h > 1 ? honestHash(h - 1) : "genesis", (int)h);
+            // Each node gets its own lossy copy of the round; a node always hears itself
+            std::vector<FinalityVote> delivered;
+            for (size_t v = 0; v < rounds[h].size(); ++v) {
+                const FinalityVote& vote = rounds[h][v];
+                bool own = vote.publicKeyPem == pubPems[n];
+                // Byzantine fork votes reach only the odd-numbered nodes
+                if (vote.blockHash[0] == 'f' && n % 2 == 0) continue;
+                if (!own && dropped(rng)) continue;
+                delivered.push_back(vote);
+            }
+            auto start = std::chrono::steady_clock::now();
+            gadgets[n]->addVotes(delivered, config.threads);
+            report.verifySeconds += secondsSince(start);
+            lagSum += h - gadgets[n]->getFinalizedHeight();
+        }
+    }
+    for (const auto& gadget : gadgets) {
+        int height = gadget->getFinalizedHeight();
+        report.finalizedHeights.push_back(height);
+        if (height > 0 && gadget->getFinalizedHash() != honestHash(height)) report.consistent = false;
+        report.votesVerified += gadget->verifiedCount();
+        report.invalidSignatures += gadget->invalidSignatureCount();
+        report.equivocations += gadget->equivocationCount();
+    }
+    if (config.blocks > 0) report.averageLag = lagSum / (nodes * config.blocks);
+    report.votesPerSecond = report.verifySeconds > 0 ? report.votesVerified / report.verifySeconds : 0;
+    return report;
+}
+
+static BlockTimeStats blockTimeStats(const std::vector<double>& solveTimes, int targetSeconds) {
+    BlockTimeStats stats;
+    if (solveTimes.empty()) return stats;
+    double sum = 0, sumSquares = 0;
+    size_t slow = 0;
+    for (double t : solveTimes) {
+        sum += t;
+        sumSquares += t * t;
+        stats.max = std::max(stats.max, t);
+        if (t > 4.0 * targetSeconds) ++slow;
+    }
+    stats.mean = sum / solveTimes.size();
+    stats.stddev = std::sqrt(std::max(0.0, sumSquares / solveTimes.size() - stats.mean * stats.mean));
+    stats.slowFraction = (double)slow / solveTimes.size();
+    return stats;
+}
+
+DifficultySimReport runDifficultySim(const DifficultySimConfig& config) {
+    DifficultySimReport report;
+    const int initialZeros = 3; // genesis difficulty
+    const double baseRate = std::pow(16.0, initialZeros) / config.targetSeconds;
+    const double phaseRates[] = {1.0, 10.0, 0.3, 3.0, 1.0};
+    auto hashRate = [&](size_t height) { return baseRate * phaseRates[std::min<size_t>(height * 5 / std::max<size_t>(config.blocks, 1), 4)]; };
+
+    // Same solve-time draws for both rules, scaled by each rule's expected hashes
+    std::mt19937 rng(config.seed);
+    std::exponential_distribution<double> unitSolve(1.0);
+    std::vector<double> draws(config.blocks);
+    for (auto& draw : draws) draw = unitSolve(rng);
+
+    // Before: what adjustDifficulty did, one hex zero (16x) per step
+    {
+        std::vector<double> timestamps{0.0}, solveTimes;
+        int zeros = initialZeros;
+        for (size_t h = 1; h <= config.blocks; ++h) {
+            double solve = std::pow(16.0, zeros) / hashRate(h) * draws[h - 1];
+            timestamps.push_back(timestamps.back() + solve);
+            solveTimes.push_back(solve);
+            size_t n = config.legacyInterval;
+            if (timestamps.size() > n) {
+                int actual = (int)timestamps.back() - (int)timestamps[timestamps.size() - n - 1];
+                int expected = (int)n * config.targetSeconds;
+                if (actual < expected / 2) ++zeros;
+                else if (actual > expected * 2 && zeros > 1) --zeros;
+            }
+        }
+        report.legacy = blockTimeStats(solveTimes, config.targetSeconds);
+    }
+    // After: compact targets from Blockchain::lwmaNextBits over synthetic headers
+    {
+        std::vector<Block> blocks(config.blocks + 1);
+        blocks[0].timestamp = 0;
+        blocks[0].difficulty = initialZeros;
+        std::vector<double> solveTimes;
+        double clock = 0;
+        for (size_t h = 1; h <= config.blocks; ++h) {
+            std::vector<const Block*> history;
+            for (size_t i = h > config.window + 1 ? h - config.window - 1 : 0; i < h; ++i) history.push_back(&blocks[i]);
+            Block& block = blocks[h];
+            block.bits = Blockchain::lwmaNextBits(history, config.targetSeconds, config.window);
+            block.difficulty = 1;
+            double solve = Uint256::fromCompact(block.bits).work() / hashRate(h) * draws[h - 1];
+            clock += solve;
+            block.timestamp = (std::time_t)clock;
+            solveTimes.push_back(solve);
+        }
+        report.lwma = blockTimeStats(solveTimes, config.targetSeconds);
+    }
+    return report;
+}
+
+// User + system CPU time of the whole process
+static double cpuSecondsUsed() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+MineBenchReport runMineBench(const MineBenchConfig& config) {
+    MineBenchReport report;
+    report.threads = config.threads ? config.threads : (unsigned)config.placement.miningSet().size();
+    report.threads = std::max(1u, report.threads);
+    // Synthetic template from a throwaway chain sealing `contents` uploads
+    Blockchain chain(":memory:");
+    chain.setPendingContentLimits(config.contents + 1, SIZE_MAX, 24 * 60 * 60);
+    for (size_t i = 0; i < config.contents; ++i) {
+        Content c = {"image", "bench-" + std::to_string(i) + ".png", "bench-uploader",
+                     std::string(63, 'a') + std::to_string(i % 10), std::time(nullptr), ""};
+        chain.addContent(c, "bench-miner");
+    }
+    BlockTemplatePtr tpl = chain.getBlockTemplate();
+    Block base = tpl->block;
+    base.miner = "bench-miner";
+    base.timestamp = std::time(nullptr);
+    base.bits = Uint256::fromLeadingZeros(std::min(std::max(config.zeros, 1), 63)).toCompact();
+    const std::string targetHex = Uint256::fromCompact(base.bits).toHex();
+    report.bits = base.bits;
+    report.expectedHashes = Uint256::fromCompact(base.bits).work();
+    report.bodyBytes = tpl->bodyData.size();
+
+    const PowKernel kernels[] = {PowKernel::OneShot, PowKernel::Midstate};
+    for (int k = -1; k < 2; ++k) { // -1: the calculateHash path
+        MineKernelStats stats;
+        stats.kernel = k < 0 ? "calculateHash" : powKernelName(kernels[k]);
+        std::vector<uint64_t> hashes(report.threads, 0);
+        std::vector<std::vector<double>> solveTimes(report.threads);
+        std::vector<char> valid(report.threads, 1);
+        double cpuStart = cpuSecondsUsed();
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(config.seconds));
+        std::atomic<bool> mining{true};
+        std::vector<double> validateMicros;
+        std::thread validator([&] {
+            config.placement.pinReserved();
+            while (mining) {
+                auto callStart = std::chrono::steady_clock::now();
+                chain.calculateHash(base);
+                validateMicros.push_back(secondsSince(callStart) * 1e6);
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        });
+        runWorkers(report.threads, [&](unsigned worker) {
+            // Pin first: the searcher's buffers are then first touched on this worker's NUMA node
+            config.placement.pinMiningWorker(worker);
+            uint64_t count = 0;
+            for (std::time_t round = 0;; ++round) {
+                // Distinct timestamps per (worker, round) keep every search independent
+                Block block = base;
+                block.timestamp = base.timestamp + round * report.threads + worker;
+                auto searchStart = std::chrono::steady_clock::now();
+                bool solved = false, expired = false;
+                if (k < 0) {
+                    for (int nonce = 1; !solved && !expired; ++nonce) {
+                        block.nonce = nonce;
+                        solved = chain.calculateHash(block) <= targetHex;
+                        ++count;
+                        if ((nonce & 0xff) == 0) expired = std::chrono::steady_clock::now() >= deadline;
+                    }
+                } else {
+                    PowSearcher searcher(Blockchain::headerPrefix(block), Blockchain::headerSuffix(block, tpl->bodyData),
+                                         targetHex, kernels[k]);
+                    int64_t found = 0;
+                    for (int64_t nonce = 1; !solved && !expired; nonce += 0x1000) {
+                        solved = searcher.search(nonce, nonce + 0x1000, &found, &count);
+                        expired = std::chrono::steady_clock::now() >= deadline;
+                    }
+                    block.nonce = (int)found;
+                    if (solved && chain.calculateHash(block) > targetHex) valid[worker] = 0;
+                }
+                if (solved) solveTimes[worker].push_back(secondsSince(searchStart));
+                if (expired || std::chrono::steady_clock::now() >= deadline) break;
+            }
+            hashes[worker] = count;
+        });
+        stats.seconds = secondsSince(start);
+        mining = false;
+        validator.join();
+        stats.cpuSeconds = cpuSecondsUsed() - cpuStart;
+        stats.cpuUtilization = stats.cpuSeconds / (stats.seconds * report.threads);
+        std::vector<double> all;
+        for (unsigned w = 0; w < report.threads; ++w) {
+            stats.hashes += hashes[w];
+            all.insert(all.end(), solveTimes[w].begin(), solveTimes[w].end());
+            if (!valid[w]) report.solutionsValid = false;
+        }
+        stats.hashesPerSecond = stats.hashes / stats.seconds;
+        stats.solutions = all.size();
+        if (!all.empty()) {
+            std::sort(all.begin(), all.end());
+            double sum = 0;
+            for (double t : all) sum += t;
+            stats.ttsMean = sum / all.size();
+            stats.ttsP50 = all[all.size() / 2];
+            stats.ttsP90 = all[std::min(all.size() - 1, all.size() * 9 / 10)];
+            stats.ttsMax = all.back();
+        }
+        if (!validateMicros.empty()) {
+            std::sort(validateMicros.begin(), validateMicros.end());
+            stats.validateP50Micros = validateMicros[validateMicros.size() / 2];
+            stats.validateP99Micros = validateMicros[std::min(validateMicros.size() - 1, validateMicros.size() * 99 / 100)];
+        }
+        if (!report.kernels.empty() && report.kernels[0].hashesPerSecond > 0)
+            stats.speedup = stats.hashesPerSecond / report.kernels[0].hashesPerSecond;
+        report.kernels.push_back(stats);
+    }
+    return report;
+}
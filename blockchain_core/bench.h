@@ -0,0 +1,129 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <cstddef>
+#include <vector>
+#include "cpu_affinity.h"
+
+// Floods a throwaway in-memory chain with pre-signed transactions from several
+// threads and measures addTransaction throughput and latency.
+struct MempoolBenchConfig {
+    size_t wallets = 100;
+    size_t txsPerWallet = 10;
+    unsigned threads = 0; // 0 = hardware concurrency
+};
+
+struct MempoolBenchReport {
+    size_t submitted = 0;
+    size_t accepted = 0;
+    unsigned threads = 1;
+    double setupSeconds = 0; // key generation + signing, excluded from throughput
+    double seconds = 0;
+    double acceptedPerSecond = 0;
+    double p50Micros = 0;
+    double p99Micros = 0;
+    // Average microseconds per call spent in each admission stage
+    double txIdMicros = 0;
+    double addressMicros = 0;
+    double verifyMicros = 0;
+    double admitMicros = 0;
+};
+
+MempoolBenchReport runMempoolBench(const MempoolBenchConfig& config);
+
+// In-process BFT finality harness: one FinalityGadget per simulated node over a
+// shared header chain, equal-stake delegates exchanging signed votes through a
+// lossy in-memory network. Byzantine delegates also vote for a conflicting block.
+struct BftSimConfig {
+    size_t nodes = 4;
+    size_t blocks = 50;
+    double dropRate = 0.0;   // chance each vote is lost on the way to each node
+    size_t byzantine = 0;    // the last `byzantine` delegates equivocate
+    unsigned threads = 0;    // signature verification workers per batch, 0 = all cores
+    unsigned seed = 1;
+};
+
+struct BftSimReport {
+    std::vector<int> finalizedHeights; // per node
+    bool consistent = true;            // every finalized block is on the honest chain
+    double averageLag = 0;             // blocks between tip and finalized height, over nodes and rounds
+    size_t votesVerified = 0;
+    size_t invalidSignatures = 0;
+    size_t equivocations = 0;
+    double setupSeconds = 0;           // key generation + signing
+    double verifySeconds = 0;
+    double votesPerSecond = 0;
+};
+
+BftSimReport runBftSim(const BftSimConfig& config);
+
+// Replays a hash-rate schedule (1x, 10x, 0.3x, 3x, 1x of the rate that meets the
+// target at the genesis difficulty, one phase per fifth of the run) against the
+// old interval rule and against LWMA retargeting, with exponentially distributed
+// solve times.
+struct DifficultySimConfig {
+    size_t blocks = 2000;
+    int targetSeconds = 30;
+    size_t window = 45;
+    int legacyInterval = 5; // the old rule: +/-1 hex zero every interval blocks
+    unsigned seed = 1;
+};
+
+struct BlockTimeStats {
+    double mean = 0;
+    double stddev = 0;
+    double max = 0;
+    double slowFraction = 0; // share of blocks slower than 4x the target
+};
+
+struct DifficultySimReport {
+    BlockTimeStats legacy;
+    BlockTimeStats lwma;
+};
+
+DifficultySimReport runDifficultySim(const DifficultySimConfig& config);
+
+// Grinds synthetic templates (a block sealing `contents` pending uploads) at a
+// fixed target for `seconds` per kernel on `threads` threads. Each solution
+// starts a new template with a fresh timestamp, so solve times are independent.
+// Alongside the miners a validator thread re-hashes the template every few
+// milliseconds, measuring how much mining delays block validation.
+struct MineBenchConfig {
+    int zeros = 4;        // target = leading hex zeros, 16^zeros expected hashes
+    double seconds = 5;   // per kernel
+    unsigned threads = 0; // 0 = one per mining CPU
+    size_t contents = 64;
+    ThreadPlacement placement; // miners on the mining set, the validator on the reserved cores
+};
+
+struct MineKernelStats {
+    std::string kernel;
+    uint64_t hashes = 0;
+    double seconds = 0;
+    double hashesPerSecond = 0;
+    double speedup = 1;        // hash rate relative to the calculateHash path
+    size_t solutions = 0;
+    // Time to solution in seconds; searches cut off by the deadline are not counted
+    double ttsMean = 0;
+    double ttsP50 = 0;
+    double ttsP90 = 0;
+    double ttsMax = 0;
+    double cpuSeconds = 0;     // user + system, from getrusage
+    double cpuUtilization = 0; // cpuSeconds / (seconds * threads)
+    double validateP50Micros = 0;
+    double validateP99Micros = 0;
+};
+
+struct MineBenchReport {
+    unsigned threads = 1;
+    uint32_t bits = 0;
+    double expectedHashes = 0;
+    size_t bodyBytes = 0;
+    bool solutionsValid = true; // every kernel solution also meets the target via calculateHash
+    std::vector<MineKernelStats> kernels; // calculateHash, one-shot, midstate
+};
+
+MineBenchReport runMineBench(const MineBenchConfig& config);
+
+#endif // BENCH_H
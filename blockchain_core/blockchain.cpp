@@ -4,6 +4,7 @@
 #include "blockchain.h"
 #include "ecdsa_utils.h"
 #include "storage.h"
+#include "pow_kernel.h"
 #include "sqlite3.h"
 #include <sstream>
 #include <iostream>
@@ -20,6 +21,8 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <poll.h>
+#include <csignal>
 #include <mutex>
 #include <set>
 #include <unordered_map>
@@ -27,6 +30,84 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <map>
+#include <algorithm>
+#include <limits>
+#include <climits>
+#include <cmath>
+
+// --- OpenSSL Context and Certificate Management ---
+namespace {
+SSL_CTX* global_ssl_ctx = nullptr;
+bool openssl_initialized = false;
+
+void init_openssl_ctx(const std::string& certFile, const std::string& keyFile) {
+    if (openssl_initialized) return;
+    // SSL_write cannot pass MSG_NOSIGNAL; a peer hanging up must fail the write, not end the node
+    signal(SIGPIPE, SIG_IGN);
+    SSL_load_error_strings();
+    OpenSSL_add_ssl_algorithms();
+    global_ssl_ctx = SSL_CTX_new(TLS_method());
+    if (!global_ssl_ctx) throw std::runtime_error("Failed to create SSL_CTX");
+    if (SSL_CTX_use_certificate_file(global_ssl_ctx, certFile.c_str(), SSL_FILETYPE_PEM) <= 0 ||
+        SSL_CTX_use_PrivateKey_file(global_ssl_ctx, keyFile.c_str(), SSL_FILETYPE_PEM) <= 0) {
+        throw std::runtime_error("Failed to load cert/key for TLS");
+    }
+    openssl_initialized = true;
+}
+
+// For demo: generate self-signed cert if not found (not secure for mainnet!)
+void ensure_cert_key(const std::string& certFile, const std::string& keyFile) {
+    std::ifstream cert(certFile), key(keyFile);
+    if (cert && key) return;
+    cert.close(); key.close();
+    std::string cmd = "openssl req -x509 -newkey rsa:2048 -keyout " + keyFile + " -out " + certFile + " -days 365 -nodes -subj '/CN=AhmiyatNode'";
+    std::system(cmd.c_str());
+}
+
+// Wire form of "tx" and "block" messages, as parsed by handleP2PMessage
+nlohmann::json txJson(const Transaction& tx) {
+    nlohmann::json jtx;
+    jtx["sender"] = tx.sender;
+    jtx["receiver"] = tx.receiver;
+    jtx["amount"] = tx.amount;
+    jtx["signature"] = tx.signature;
+    jtx["publicKeyPem"] = tx.publicKeyPem;
+    jtx["fee"] = tx.fee;
+    jtx["nonce"] = tx.nonce;
+    return jtx;
+}
+
+std::string txMessage(const Transaction& tx) {
+    nlohmann::json jmsg = txJson(tx);
+    jmsg["type"] = "tx";
+    return jmsg.dump();
+}
+
+std::string blockMessage(const Block& block) {
+    nlohmann::json jmsg;
+    jmsg["type"] = "block";
+    jmsg["index"] = block.index;
+    jmsg["prevHash"] = block.prevHash;
+    jmsg["hash"] = block.hash;
+    jmsg["merkleRoot"] = block.merkleRoot;
+    jmsg["timestamp"] = block.timestamp;
+    jmsg["miner"] = block.miner;
+    jmsg["nonce"] = block.nonce;
+    jmsg["difficulty"] = block.difficulty;
+    jmsg["bits"] = block.bits;
+    jmsg["transactions"] = nlohmann::json::array();
+    for (const auto& tx : block.transactions) jmsg["transactions"].push_back(txJson(tx));
+    jmsg["contents"] = nlohmann::json::array();
+    for (const auto& c : block.contents) {
+        jmsg["contents"].push_back({{"type", c.type}, {"filename", c.filename}, {"uploader", c.uploader},
+                                    {"hash", c.hash}, {"timestamp", c.timestamp}, {"publicKeyPem", c.publicKeyPem}});
+    }
+    return jmsg.dump();
+}
+
+// Largest message accepted from a peer: a full block plus its JSON framing
+const size_t kMaxPeerMessageBytes = 8 * 1024 * 1024;
+}
 
 // --- PRODUCTION-GRADE FEATURE STUBS & TODOs ---
 
@@ -41,6 +122,10 @@ void Blockchain::sendEncrypted(const std::string& peerAddress, const std::string
     int port = std::stoi(peerAddress.substr(pos + 1));
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) return;
+    // An unresponsive peer must not hang the caller (often the P2P handler thread)
+    timeval timeout{5, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
     sockaddr_in serv_addr{};
     serv_addr.sin_family = AF_INET;
     serv_addr.sin_port = htons(port);
@@ -159,8 +244,8 @@ std::string Blockchain::receiveEncrypted(const std::string& peerAddress) {
 // TODO: Slashing for malicious validators (if PoS/DPoS)
 // 1. Detect malicious behavior, slash stake
 
-Blockchain::Blockchain() {
-    if (sqlite3_open("ahmiyat.db", &db) != SQLITE_OK) {
+Blockchain::Blockchain(const std::string& dbPath) {
+    if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
         std::cerr << "Failed to open database: " << sqlite3_errmsg(db) << std::endl;
         db = nullptr;
     } else {
@@ -171,12 +256,59 @@ Blockchain::Blockchain() {
             std::cerr << "Failed to create blocks table: " << errMsg << std::endl;
             sqlite3_free(errMsg);
         }
+        // Exact confirmed-txid index backing replay protection
+        const char* createTxIndexSQL = "CREATE TABLE IF NOT EXISTS confirmed_txids (txid TEXT PRIMARY KEY, height INTEGER);"
+                                       "CREATE INDEX IF NOT EXISTS confirmed_txids_height ON confirmed_txids (height);";
+        if (sqlite3_exec(db, createTxIndexSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Failed to create confirmed_txids table: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+        }
+        // Key/value metadata (verified-height watermark, etc.)
+        const char* createMetaSQL = "CREATE TABLE IF NOT EXISTS chain_meta (key TEXT PRIMARY KEY, value TEXT);";
+        if (sqlite3_exec(db, createMetaSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Failed to create chain_meta table: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+        }
+        // Pending transactions, shared between CLI invocations and the web server
+        const char* createMempoolSQL = "CREATE TABLE IF NOT EXISTS mempool_txs (txid TEXT PRIMARY KEY, seq INTEGER, added_at INTEGER, data TEXT);";
+        if (sqlite3_exec(db, createMempoolSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Failed to create mempool_txs table: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+        }
+        // DPoS validator set per epoch, written once when the epoch is first scheduled
+        const char* createSnapshotsSQL = "CREATE TABLE IF NOT EXISTS stake_snapshots (epoch INTEGER PRIMARY KEY, total REAL, data TEXT);";
+        if (sqlite3_exec(db, createSnapshotsSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Failed to create stake_snapshots table: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+        }
+        // Uploads waiting to be sealed into a batch block
+        const char* createPendingSQL = "CREATE TABLE IF NOT EXISTS pending_contents (seq INTEGER PRIMARY KEY, data TEXT);";
+        if (sqlite3_exec(db, createPendingSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Failed to create pending_contents table: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+        }
+        // Peers added with add-peer, for connect-known-peers in later runs
+        const char* createKnownPeersSQL = "CREATE TABLE IF NOT EXISTS known_peers (host TEXT, port INTEGER, PRIMARY KEY (host, port));";
+        if (sqlite3_exec(db, createKnownPeersSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Failed to create known_peers table: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+        }
+        // Stakes, delegations, reward claims and commission changes, replayed with the blocks
+        const char* createStakeEventsSQL = "CREATE TABLE IF NOT EXISTS stake_events (seq INTEGER PRIMARY KEY, height INTEGER, "
+                                           "kind TEXT, account TEXT, delegate TEXT, amount REAL);";
+        if (sqlite3_exec(db, createStakeEventsSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Failed to create stake_events table: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+        }
     }
     createGenesisBlock();
+    publishSnapshot();
     // localAddress = "127.0.0.1:12345"; // Example, set appropriately
 }
 
 Blockchain::~Blockchain() {
+    stopBlockProducer();
+    stopP2PServer();
     if (db) sqlite3_close(db);
 }
 
@@ -190,20 +322,122 @@ void Blockchain::createGenesisBlock() {
     genesis.difficulty = difficulty;
     genesis.merkleRoot = calculateMerkleRoot(genesis.transactions);
     genesis.hash = calculateHash(genesis);
-    chain.push_back(genesis);
+    appendBlock(std::move(genesis));
+}
+
+// Expected number of hashes to find a block at its target (or with this many leading hex zeros)
+double Blockchain::blockWork(const Block& block) {
+    return block.bits ? Uint256::fromCompact(block.bits).work() : std::pow(16.0, block.difficulty);
+}
+
+// Caches cumulative work on the block before it becomes immutable
+void Blockchain::appendBlock(Block block) {
+    txIndexDirtyFrom = std::min(txIndexDirtyFrom, block.index);
+    block.chainWork = (chain.empty() ? 0 : chain.back()->chainWork) + blockWork(block);
+    if (consensusMode == ConsensusMode::DPoS && block.difficulty == 0 && block.index > 0) {
+        refreshFinalityVoters(epochOfSlot(slotAt(block.timestamp)), *chain.back());
+        finality.onBlock(block.hash, block.prevHash, block.index);
+    }
+    chain.push_back(std::make_shared<const Block>(std::move(block)));
+}
+
+// Applies (direction = 1) or reverts (direction = -1) a block's effect on balances and nonces
+void Blockchain::applyBlockState(const Block& block, int direction) {
+    double totalFees = 0;
+    for (const auto& tx : block.transactions) {
+        double fee = effectiveFee(tx);
+        balances.edit()[tx.sender] -= direction * (tx.amount + fee);
+        balances.edit()[tx.receiver] += direction * tx.amount;
+        totalFees += fee;
+        // Nonces are sequential, so reverting nonce n leaves n - 1 confirmed
+        if (tx.nonce > 0) accountNonces.edit()[tx.sender] = direction > 0 ? tx.nonce : tx.nonce - 1;
+        std::string txId = calculateTxId(tx);
+        std::lock_guard<std::mutex> replayLock(replayMutex);
+        if (direction > 0) {
+            unsavedConfirmedTxIds[txId] = block.index;
+            seenTxFilter.insert(txId);
+        } else {
+            unsavedConfirmedTxIds.erase(txId);
+        }
+    }
+    double payout = getBlockReward(block.index) + totalFees;
+    if (block.difficulty == 0) {
+        // The pool is the stake delegated before this block: events logged at or above
+        // its height are excluded, which keeps the split the same on replay and reorg
+        auto delegated = delegatedStakes.get().find(block.miner);
+        double pool = delegated == delegatedStakes.get().end() ? 0 : delegated->second;
+        std::vector<const StakeEvent*> later;
+        for (auto event = stakeEvents.rbegin(); event != stakeEvents.rend() && event->height >= block.index; ++event) {
+            if (event->kind != "delegate" || event->delegate != block.miner) continue;
+            pool -= event->amount;
+            later.push_back(&*event);
+        }
+        DelegatorPayout share{0, 0};
+        if (direction > 0 && pool > 1e-9) {
+            // Delegators' share goes into the producer's accumulator instead of being paid out now
+            share.total = payout * (1 - commissionAt(block.index));
+            share.perShare = share.total / pool;
+            delegatorPayouts[block.hash] = share;
+        } else if (direction < 0) {
+            auto recorded = delegatorPayouts.find(block.hash);
+            if (recorded != delegatorPayouts.end()) {
+                share = recorded->second;
+                delegatorPayouts.erase(recorded);
+            }
+        }
+        if (share.total > 0) {
+            accRewardPerShare[block.miner] += direction * share.perShare;
+            // Later delegations started from an accumulator that included this block
+            for (const StakeEvent* event : later) {
+                delegations[event->account][event->delegate].rewardDebt += direction * event->amount * share.perShare;
+            }
+            payout -= share.total;
+        }
+    }
+    balances.edit()[block.miner] += direction * payout;
 }
 
 std::string Blockchain::calculateHash(const Block& block) const {
+    return hashBlockWithBody(block, serializeBlockBody(block));
+}
+
+// Fee and nonce as committed by signatures, txids, merkle leaves and block hashes.
+// Empty for legacy transactions, which keep their original preimages.
+static std::string feeNonceData(const Transaction& tx) {
+    std::string data;
+    if (tx.fee > 0 || tx.nonce > 0) data += "|" + std::to_string(tx.fee);
+    if (tx.nonce > 0) data += "|" + std::to_string(tx.nonce);
+    return data;
+}
+
+// Transactions and contents part of the hash preimage; constant across nonce attempts
+std::string Blockchain::serializeBlockBody(const Block& block) const {
     std::stringstream ss;
-    ss << block.index << block.prevHash << block.timestamp << block.miner << block.nonce << block.difficulty;
     for (const auto& tx : block.transactions) {
-        ss << tx.sender << tx.receiver << tx.amount << tx.signature;
+        ss << tx.sender << tx.receiver << tx.amount << tx.signature << feeNonceData(tx);
     }
     for (const auto& c : block.contents) {
         ss << c.type << c.filename << c.uploader << c.hash << c.timestamp;
     }
+    return ss.str();
+}
+
+std::string Blockchain::headerPrefix(const Block& block) {
+    std::stringstream ss;
+    ss << block.index << block.prevHash << block.timestamp << block.miner;
+    return ss.str();
+}
+
+std::string Blockchain::headerSuffix(const Block& block, const std::string& bodyData) {
+    std::stringstream ss;
+    ss << block.difficulty;
+    if (block.bits) ss << block.bits; // legacy blocks keep their original preimage
+    return ss.str() + bodyData;
+}
+
+std::string Blockchain::hashBlockWithBody(const Block& block, const std::string& bodyData) const {
     unsigned char hash[SHA256_DIGEST_LENGTH];
-    std::string input = ss.str();
+    std::string input = headerPrefix(block) + std::to_string(block.nonce) + headerSuffix(block, bodyData);
     SHA256((unsigned char*)input.c_str(), input.size(), hash);
     std::stringstream out;
     for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i) out << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
@@ -214,7 +448,7 @@ std::string Blockchain::calculateMerkleRoot(const std::vector<Transaction>& tran
     if (transactions.empty()) return "";
     std::vector<std::string> hashes;
     for (const auto& tx : transactions) {
-        std::string txData = tx.sender + tx.receiver + std::to_string(tx.amount) + tx.signature + tx.publicKeyPem;
+        std::string txData = tx.sender + tx.receiver + std::to_string(tx.amount) + tx.signature + tx.publicKeyPem + feeNonceData(tx);
         unsigned char hash[SHA256_DIGEST_LENGTH];
         SHA256((unsigned char*)txData.c_str(), txData.size(), hash);
         std::stringstream out;
@@ -285,22 +519,55 @@ std::string Wallet::getLocalPublicKeyPem() {
 
 // --- Peer Reputation & DDoS Resistance ---
 void Blockchain::reportPeerMisbehavior(const std::string& peerAddress) {
-    peerReputation[peerAddress]--;
-    if (peerReputation[peerAddress] < -3) {
+    bool block;
+    {
+        std::lock_guard<std::mutex> lock(peerPolicyMutex);
+        block = --peerReputation[peerAddress] < -3;
+    }
+    if (block) {
         blockPeer(peerAddress);
         logError("Peer blocked for repeated misbehavior: " + peerAddress);
     }
 }
 void Blockchain::rewardPeer(const std::string& peerAddress) {
+    std::lock_guard<std::mutex> lock(peerPolicyMutex);
     peerReputation[peerAddress]++;
 }
 
-// --- BFT/Fork Resolution Stub ---
-bool Blockchain::resolveFork(const std::vector<Block>& candidateChain) {
-    // TODO: Implement fork resolution (longest chain, most work, BFT signatures, etc.)
-    // For now, stub returns false
-    logError("Fork resolution attempted (stub)");
-    return false;
+bool Blockchain::isPeerBlocked(const std::string& peerAddress) const {
+    std::lock_guard<std::mutex> lock(peerPolicyMutex);
+    return blockedPeers.count(peerAddress) > 0;
+}
+
+void Blockchain::blockPeer(const std::string& peerAddress) {
+    {
+        std::lock_guard<std::mutex> lock(peerPolicyMutex);
+        blockedPeers.insert(peerAddress);
+    }
+    std::lock_guard<std::mutex> lock(peersMutex);
+    peers.erase(peerAddress);
+}
+
+void Blockchain::unblockPeer(const std::string& peerAddress) {
+    std::lock_guard<std::mutex> lock(peerPolicyMutex);
+    blockedPeers.erase(peerAddress);
+    peerReputation.erase(peerAddress);
+}
+
+// Fixed one-second windows per peer; blocked peers are always refused
+bool Blockchain::checkPeerRateLimit(const std::string& peerAddress) {
+    std::lock_guard<std::mutex> lock(peerPolicyMutex);
+    if (blockedPeers.count(peerAddress)) return false;
+    std::time_t now = std::time(nullptr);
+    auto& window = peerMessageWindows[peerAddress];
+    if (window.first != now) window = {now, 0};
+    bool allowed = ++window.second <= maxPeerMessagesPerSecond;
+    if (peerMessageWindows.size() > 1024) {
+        for (auto it = peerMessageWindows.begin(); it != peerMessageWindows.end();) {
+            it = it->second.first != now ? peerMessageWindows.erase(it) : std::next(it);
+        }
+    }
+    return allowed;
 }
 
 // --- Monitoring/Observability Hook ---
@@ -310,6 +577,7 @@ void Blockchain::emitMetric(const std::string& metric, double value) {
     std::cout << "[METRIC] " << metric << ": " << value << std::endl;
 }
 
+// txFee is the minimum relay fee; legacy transactions without their own fee paid it implicitly
 void Blockchain::setTxFee(double fee) { txFee = fee; }
 double Blockchain::getTxFee() const { return txFee; }
 void Blockchain::setHalvingInterval(int interval) { halvingInterval = interval; }
@@ -323,13 +591,44 @@ double Blockchain::getBlockReward(int blockIndex) const {
 }
 
 // --- Replay/Double-Spend Protection ---
-// Set of seen transaction IDs (txids)
-std::set<std::string> seenTxIds;
+double Blockchain::effectiveFee(const Transaction& tx) const {
+    return tx.fee > 0 ? tx.fee : txFee;
+}
+
+// Legacy transactions signed sender+receiver+amount; fee-carrying ones also commit to the fee
+std::string Blockchain::txSigningData(const Transaction& tx) {
+    return tx.sender + tx.receiver + std::to_string(tx.amount) + feeNonceData(tx);
+}
+
+bool Blockchain::isTxConfirmed(const std::string& txId) const {
+    if (unsavedConfirmedTxIds.count(txId)) return true;
+    if (!db) return false;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM confirmed_txids WHERE txid = ?;", -1, &stmt, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_text(stmt, 1, txId.c_str(), -1, SQLITE_TRANSIENT);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Seeds the filter with the most recently confirmed txids so protection survives restarts.
+// Caller holds replayMutex.
+void Blockchain::loadReplayFilter() {
+    seenTxFilter.clear();
+    if (!db) return;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT txid FROM confirmed_txids ORDER BY height DESC LIMIT 100000;", -1, &stmt, nullptr) != SQLITE_OK) return;
+    std::vector<std::string> recent;
+    while (sqlite3_step(stmt) == SQLITE_ROW) recent.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+    sqlite3_finalize(stmt);
+    // Insert oldest first so the newest land in the current generation
+    for (auto it = recent.rbegin(); it != recent.rend(); ++it) seenTxFilter.insert(*it);
+}
 
 // Calculate a unique transaction ID (hash of tx fields)
 std::string Blockchain::calculateTxId(const Transaction& tx) const {
     std::stringstream ss;
-    ss << tx.sender << tx.receiver << tx.amount << tx.signature << tx.publicKeyPem;
+    ss << tx.sender << tx.receiver << tx.amount << tx.signature << tx.publicKeyPem << feeNonceData(tx);
     unsigned char hash[SHA256_DIGEST_LENGTH];
     std::string input = ss.str();
     SHA256((unsigned char*)input.c_str(), input.size(), hash);
@@ -338,193 +637,1354 @@ std::string Blockchain::calculateTxId(const Transaction& tx) const {
     return out.str();
 }
 
+// Adds the time since start to an admission-stage counter when it goes out of scope
+struct AdmissionStageTimer {
+    std::atomic<uint64_t>& total;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ~AdmissionStageTimer() {
+        total += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
 bool Blockchain::addTransaction(const Transaction& tx) {
-    std::string txId = calculateTxId(tx);
-    if (seenTxIds.count(txId)) {
-        logError("Replay/double-spend detected: duplicate txid");
-        return false;
+    ++admissionCalls;
+    std::string txId;
+    std::string expectedAddress;
+    {
+        AdmissionStageTimer timer{txIdNanos};
+        txId = calculateTxId(tx);
+    }
+    // Enforce signature verification using public key (no locks held: this is the expensive part)
+    {
+        AdmissionStageTimer timer{addressNanos};
+        expectedAddress = Wallet::publicKeyToAddress(tx.publicKeyPem);
     }
-    seenTxIds.insert(txId);
-    // Enforce signature verification using public key
-    std::string expectedAddress = Wallet::publicKeyToAddress(tx.publicKeyPem);
     if (tx.sender != expectedAddress) {
         logError("Transaction sender address does not match public key (Base58).");
         return false;
     }
-    if (!Wallet::verify(tx.sender + tx.receiver + std::to_string(tx.amount), tx.signature, tx.publicKeyPem)) {
+    if (tx.fee < txFee) {
+        logError("Transaction fee below minimum relay fee.");
+        return false;
+    }
+    if (tx.nonce == 0) {
+        logError("Transaction is missing its sender nonce.");
+        return false;
+    }
+    bool signatureValid;
+    {
+        AdmissionStageTimer timer{verifyNanos};
+        signatureValid = Wallet::verify(txSigningData(tx), tx.signature, tx.publicKeyPem);
+    }
+    if (!signatureValid) {
         logError(std::string("Invalid transaction signature for sender: ") + tx.sender);
         return false;
     }
-    if (balances[tx.sender] < tx.amount + txFee) {
-        logError("Insufficient balance for transaction + fee.");
+    AdmissionStageTimer admitTimer{admitNanos};
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    // Admission is checked against the published state, so it never waits on the writer
+    // lock. Anything that lowers a balance or confirms a nonce publishes while holding
+    // mempoolMutex, after reconciling the pool, so this view agrees with pendingDebits.
+    StateSnapshotPtr state = snapshot();
+    auto bal = state->balances->find(tx.sender);
+    auto confirmed = state->accountNonces->find(tx.sender);
+    uint64_t confirmedNonce = confirmed == state->accountNonces->end() ? 0 : confirmed->second;
+    expirePending(std::time(nullptr));
+    // The filter rules out almost every fresh txid without touching the exact indexes.
+    // Replays older than the filter's window still fail the nonce check below.
+    {
+        std::lock_guard<std::mutex> replayLock(replayMutex);
+        if (seenTxFilter.mayContain(txId) && (mempool.contains(txId) || isTxConfirmed(txId))) {
+            logError("Replay/double-spend detected: duplicate txid");
+            return false;
+        }
+    }
+    double available = bal == state->balances->end() ? 0 : bal->second;
+    // Replace-by-fee: a taken (sender, nonce) slot can be bumped by a clearly better-paying version
+    const Mempool::Entry* existing = tx.nonce > confirmedNonce ? mempool.findBySenderNonce(tx.sender, tx.nonce) : nullptr;
+    if (existing) {
+        const Transaction& old = existing->tx;
+        double feeRate = tx.fee / std::max<size_t>(Mempool::txSize(tx), 1);
+        if (tx.fee < old.fee * minReplacementFeeRatio || tx.fee - old.fee < txFee || feeRate <= existing->feeRate) {
+            logError("Replacement fee too low for nonce " + std::to_string(tx.nonce) + ", must exceed " +
+                     std::to_string(std::max(old.fee * minReplacementFeeRatio, old.fee + txFee)));
+            return false;
+        }
+        // Funding is re-checked with the replaced entry's debit released
+        if (available - (mempool.pendingDebit(tx.sender) - old.amount - old.fee) < tx.amount + tx.fee) {
+            logError("Insufficient balance for replacement transaction + fee (including pending transactions).");
+            return false;
+        }
+        Transaction replaced;
+        std::vector<Transaction> evicted;
+        if (!mempool.replace(tx, txId, &replaced, &evicted)) {
+            logError("Mempool full and replacement fee rate too low.");
+            return false;
+        }
+        {
+            // The replaced txid stays in the filter; a hit is resolved by the exact indexes,
+            // and a rebroadcast of it now loses the fee check above
+            std::lock_guard<std::mutex> replayLock(replayMutex);
+            seenTxFilter.insert(txId);
+        }
+        logConsensusEvent("Mempool replacement", calculateTxId(replaced) + " -> " + txId);
+        for (const auto& e : evicted) logConsensusEvent("Mempool eviction", calculateTxId(e));
+        return true;
+    }
+    // Admit strictly in nonce order, and only if the sender can fund everything already pending too
+    uint64_t expectedNonce = mempool.nextNonce(tx.sender, confirmedNonce);
+    if (tx.nonce != expectedNonce) {
+        logError("Transaction nonce " + std::to_string(tx.nonce) + " out of order, expected " + std::to_string(expectedNonce));
+        return false;
+    }
+    if (available - mempool.pendingDebit(tx.sender) < tx.amount + tx.fee) {
+        logError("Insufficient balance for transaction + fee (including pending transactions).");
+        return false;
+    }
+    std::vector<Transaction> evicted;
+    if (!mempool.insert(tx, txId, &evicted)) {
+        logError("Mempool full and transaction fee rate too low.");
         return false;
     }
-    mempool.push_back(tx);
+    {
+        std::lock_guard<std::mutex> replayLock(replayMutex);
+        seenTxFilter.insert(txId);
+    }
+    for (const auto& e : evicted) logConsensusEvent("Mempool eviction", calculateTxId(e));
     return true;
 }
 
+AdmissionTimings Blockchain::getAdmissionTimings() const {
+    AdmissionTimings timings;
+    timings.calls = admissionCalls;
+    timings.txIdNs = txIdNanos;
+    timings.addressNs = addressNanos;
+    timings.verifyNs = verifyNanos;
+    timings.admitNs = admitNanos;
+    return timings;
+}
+
+void Blockchain::resetAdmissionTimings() {
+    admissionCalls = 0;
+    txIdNanos = 0;
+    addressNanos = 0;
+    verifyNanos = 0;
+    admitNanos = 0;
+}
+
+// Local benchmarks/simulations only: not reachable from the network or the CLI
+void Blockchain::creditBalance(const std::string& address, double amount) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    balances.edit()[address] += amount;
+    publishSnapshot();
+}
+
 bool Blockchain::addContent(const Content& content, const std::string& miner) {
     // Optionally, verify content signature if you add one
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    expirePending(std::time(nullptr));
+    size_t usage = contentMemoryUsage(content);
+    if (pendingContents.size() >= maxPendingContents || pendingContentBytes + usage > maxPendingContentBytes) {
+        logError("Pending content pool full, rejecting upload: " + content.filename);
+        return false;
+    }
     pendingContents.push_back(content);
+    pendingContentArrivals.push_back(std::time(nullptr));
+    pendingContentBytes += usage;
+    ++contentsRevision;
     return true;
 }
 
-bool Blockchain::validProof(const Block& block) const {
-    // Check if hash meets difficulty requirement
-    return block.hash.substr(0, block.difficulty) == std::string(block.difficulty, '0');
+void Blockchain::setContentBatching(size_t batchSize, int windowSeconds) {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    contentBatchSize = std::max<size_t>(batchSize, 1);
+    contentBatchWindow = std::max(windowSeconds, 0);
 }
 
-void Blockchain::adjustDifficulty() {
-    int n = adjustmentInterval;
-    if (chain.size() <= n) return;
-    const Block& last = chain.back();
-    const Block& prev = chain[chain.size() - n - 1];
-    int actualTime = static_cast<int>(last.timestamp - prev.timestamp);
-    int expectedTime = n * targetBlockTime;
-    if (actualTime < expectedTime / 2) {
-        difficulty++;
-    } else if (actualTime > expectedTime * 2 && difficulty > 1) {
-        difficulty--;
-    }
+size_t Blockchain::getContentBatchSize() const {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    return contentBatchSize;
 }
 
-bool Blockchain::mineBlock(const std::string& miner) {
-    if (mempool.empty() && pendingContents.empty()) return false;
-    Block newBlock;
-    newBlock.index = chain.size();
-    newBlock.prevHash = chain.back().hash;
-    newBlock.timestamp = std::time(nullptr);
-    newBlock.transactions = mempool;
-    newBlock.contents = pendingContents;
-    newBlock.miner = miner;
-    newBlock.difficulty = difficulty;
-    newBlock.nonce = 0;
-    newBlock.merkleRoot = calculateMerkleRoot(newBlock.transactions);
-    // Improved Proof-of-Work: use validProof for clarity
-    do {
-        newBlock.nonce++;
-        newBlock.hash = calculateHash(newBlock);
-    } while (!validProof(newBlock));
-    // Validate before adding
-    if (!validateBlock(newBlock, chain.back())) {
-        logError("Invalid block mined, not adding to chain.");
-        return false;
+int Blockchain::getContentBatchWindow() const {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    return contentBatchWindow;
+}
+
+bool Blockchain::contentBatchDue() const {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    if (pendingContents.empty()) return false;
+    if (pendingContents.size() >= contentBatchSize) return true;
+    // pendingContents is in arrival order, so the front entry is the oldest. Measured from
+    // local arrival: the upload's own timestamp would let an uploader force an early seal.
+    return contentBatchWindow > 0 && std::time(nullptr) - pendingContentArrivals.front() >= contentBatchWindow;
+}
+
+bool Blockchain::sealContentBatch(const std::string& miner, bool force) {
+    if (!force && !contentBatchDue()) return false;
+    if (consensusMode == ConsensusMode::PoS) return mineBlockPoS();
+    if (consensusMode == ConsensusMode::DPoS) return mineBlockDPoS();
+    return mineBlock(miner);
+}
+
+ContentStatus Blockchain::getContentStatus(const std::string& hash) const {
+    ContentStatus status;
+    StateSnapshotPtr state = snapshot();
+    // Newest first: recent uploads are the ones being polled for
+    for (auto it = state->chain.rbegin(); it != state->chain.rend(); ++it) {
+        for (const auto& c : (*it)->contents) {
+            if (c.hash != hash) continue;
+            status.found = status.confirmed = true;
+            status.height = (*it)->index;
+            status.confirmations = (int)state->chain.size() - (*it)->index;
+            return status;
+        }
     }
-    chain.push_back(newBlock);
-    adjustDifficulty();
-    // Update balances
-    double reward = getBlockReward(newBlock.index);
-    double totalFees = 0;
-    for (const auto& tx : mempool) {
-        balances[tx.sender] -= (tx.amount + txFee);
-        balances[tx.receiver] += tx.amount;
-        totalFees += txFee;
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    status.pendingCount = pendingContents.size();
+    for (size_t i = 0; i < pendingContents.size(); ++i) {
+        if (pendingContents[i].hash != hash) continue;
+        status.found = true;
+        status.pendingPosition = i;
+        break;
     }
-    balances[miner] += reward + totalFees;
-    mempool.clear();
-    pendingContents.clear();
-    return true;
+    return status;
 }
 
-bool Blockchain::validateBlock(const Block& newBlock, const Block& prevBlock) const {
-    if (newBlock.prevHash != prevBlock.hash) return false;
-    if (newBlock.hash != calculateHash(newBlock)) return false;
-    if (!validProof(newBlock)) return false;
-    if (newBlock.timestamp < prevBlock.timestamp) return false;
-    // Optionally: validate all transactions and contents
+// Rewrites the pending batch and its settings so the next process picks them up
+bool Blockchain::savePendingContents() {
+    if (!db) return false;
+    std::vector<Content> pending;
+    std::vector<std::time_t> arrivals;
+    size_t batchSize;
+    int batchWindow;
+    {
+        std::lock_guard<std::mutex> lock(mempoolMutex);
+        pending = pendingContents;
+        arrivals = pendingContentArrivals;
+        batchSize = contentBatchSize;
+        batchWindow = contentBatchWindow;
+    }
+    std::string metaSql = "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('content_batch_size', '" + std::to_string(batchSize) + "');"
+                          "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('content_batch_window', '" + std::to_string(batchWindow) + "');";
+    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+    sqlite3_exec(db, metaSql.c_str(), nullptr, nullptr, nullptr);
+    sqlite3_exec(db, "DELETE FROM pending_contents;", nullptr, nullptr, nullptr);
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "INSERT INTO pending_contents (seq, data) VALUES (?, ?);", -1, &stmt, nullptr) != SQLITE_OK) {
+        logError(std::string("Failed to save pending contents: ") + sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const Content& c = pending[i];
+        nlohmann::json jc;
+        jc["type"] = c.type;
+        jc["filename"] = c.filename;
+        jc["uploader"] = c.uploader;
+        jc["hash"] = c.hash;
+        jc["timestamp"] = c.timestamp;
+        jc["publicKeyPem"] = c.publicKeyPem;
+        jc["arrivedAt"] = arrivals[i];
+        std::string data = jc.dump();
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)i);
+        sqlite3_bind_text(stmt, 2, data.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
     return true;
 }
 
-bool Blockchain::isValidChain() const {
-    for (size_t i = 1; i < chain.size(); ++i) {
-        const Block& prev = chain[i-1];
-        const Block& curr = chain[i];
-        if (curr.prevHash != prev.hash) return false;
-        if (curr.hash != calculateHash(curr)) return false;
-        if (curr.hash.substr(0, curr.difficulty) != std::string(curr.difficulty, '0')) return false;
+bool Blockchain::saveMempool() {
+    if (!db) return false;
+    std::vector<Mempool::Entry> pending = queryMempool(MempoolOrder::Newest, 0, SIZE_MAX);
+    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+    sqlite3_exec(db, "DELETE FROM mempool_txs;", nullptr, nullptr, nullptr);
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "INSERT INTO mempool_txs (txid, seq, added_at, data) VALUES (?, ?, ?, ?);", -1, &stmt, nullptr) != SQLITE_OK) {
+        logError(std::string("Failed to save mempool: ") + sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
     }
+    for (const auto& entry : pending) {
+        const Transaction& tx = entry.tx;
+        nlohmann::json jtx;
+        jtx["sender"] = tx.sender;
+        jtx["receiver"] = tx.receiver;
+        jtx["amount"] = tx.amount;
+        jtx["signature"] = tx.signature;
+        jtx["publicKeyPem"] = tx.publicKeyPem;
+        jtx["fee"] = tx.fee;
+        jtx["nonce"] = tx.nonce;
+        std::string data = jtx.dump();
+        sqlite3_bind_text(stmt, 1, entry.txId.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, (sqlite3_int64)entry.sequence);
+        sqlite3_bind_int64(stmt, 3, (sqlite3_int64)entry.addedAt);
+        sqlite3_bind_text(stmt, 4, data.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
     return true;
 }
 
-bool Blockchain::saveToDb() {
+// Entries were verified when first admitted; only their nonce/funding against the
+// loaded chain is re-checked. Caller holds chainMutex.
+bool Blockchain::loadMempool() {
     if (!db) return false;
-    char* errMsg = nullptr;
-    sqlite3_exec(db, "DELETE FROM blocks;", nullptr, nullptr, &errMsg);
-    for (const auto& block : chain) {
-        nlohmann::json jblock;
-        jblock["index"] = block.index;
-        jblock["prevHash"] = block.prevHash;
-        jblock["hash"] = block.hash;
-        jblock["merkleRoot"] = block.merkleRoot;
-        jblock["timestamp"] = block.timestamp;
-        jblock["miner"] = block.miner;
-        jblock["nonce"] = block.nonce;
-        jblock["difficulty"] = block.difficulty;
-        // Transactions
-        for (const auto& tx : block.transactions) {
-            nlohmann::json jtx;
-            jtx["sender"] = tx.sender;
-            jtx["receiver"] = tx.receiver;
-            jtx["amount"] = tx.amount;
-            jtx["signature"] = tx.signature;
-            jtx["publicKeyPem"] = tx.publicKeyPem;
-            jblock["transactions"].push_back(jtx);
-        }
-        // Contents
-        for (const auto& c : block.contents) {
-            nlohmann::json jc;
-            jc["type"] = c.type;
-            jc["filename"] = c.filename;
-            jc["uploader"] = c.uploader;
-            jc["hash"] = c.hash;
-            jc["timestamp"] = c.timestamp;
-            jc["publicKeyPem"] = c.publicKeyPem;
-            jblock["contents"].push_back(jc);
-        }
-        std::string sql = "INSERT INTO blocks (id, data) VALUES (" + std::to_string(block.index) + ", '" + jblock.dump() + "');";
-        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
-            std::cerr << "DB insert error: " << errMsg << std::endl;
-            sqlite3_free(errMsg);
-            return false;
-        }
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    mempool.clear();
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT txid, added_at, data FROM mempool_txs ORDER BY seq ASC;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
     }
+    std::set<std::string> senders;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* txId = sqlite3_column_text(stmt, 0);
+        const unsigned char* data = sqlite3_column_text(stmt, 2);
+        if (!txId || !data) continue;
+        nlohmann::json jtx = nlohmann::json::parse(reinterpret_cast<const char*>(data));
+        Transaction tx;
+        tx.sender = jtx["sender"];
+        tx.receiver = jtx["receiver"];
+        tx.amount = jtx["amount"];
+        tx.signature = jtx["signature"];
+        tx.publicKeyPem = jtx["publicKeyPem"];
+        tx.fee = jtx.value("fee", 0.0);
+        tx.nonce = jtx.value("nonce", (uint64_t)0);
+        std::string id = reinterpret_cast<const char*>(txId);
+        if (!mempool.restore(tx, id, (std::time_t)sqlite3_column_int64(stmt, 1))) continue;
+        senders.insert(tx.sender);
+        std::lock_guard<std::mutex> replayLock(replayMutex);
+        seenTxFilter.insert(id);
+    }
+    sqlite3_finalize(stmt);
+    for (const auto& sender : senders) reconcileMempoolSender(sender);
     return true;
 }
 
-bool Blockchain::loadFromDb() {
+// Caller holds chainMutex
+bool Blockchain::loadPendingContents() {
     if (!db) return false;
-    chain.clear();
-    const char* sql = "SELECT data FROM blocks ORDER BY id ASC;";
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    pendingContents.clear();
+    pendingContentArrivals.clear();
+    pendingContentBytes = 0;
+    ++contentsRevision;
     sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "DB select error: " << sqlite3_errmsg(db) << std::endl;
+    if (sqlite3_prepare_v2(db, "SELECT data FROM pending_contents ORDER BY seq ASC;", -1, &stmt, nullptr) != SQLITE_OK) {
         return false;
     }
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         const unsigned char* data = sqlite3_column_text(stmt, 0);
-        if (data) {
-            nlohmann::json jblock = nlohmann::json::parse(reinterpret_cast<const char*>(data));
-            Block block;
-            block.index = jblock["index"];
-            block.prevHash = jblock["prevHash"];
-            block.hash = jblock["hash"];
-            block.merkleRoot = jblock.value("merkleRoot", "");
-            block.timestamp = jblock["timestamp"];
-            block.miner = jblock["miner"];
-            block.nonce = jblock["nonce"];
-            block.difficulty = jblock["difficulty"];
-            // Transactions
-            for (const auto& jtx : jblock["transactions"]) {
-                Transaction tx;
-                tx.sender = jtx["sender"];
-                tx.receiver = jtx["receiver"];
-                tx.amount = jtx["amount"];
-                tx.signature = jtx["signature"];
-                tx.publicKeyPem = jtx["publicKeyPem"];
-                block.transactions.push_back(tx);
-            }
-            // Contents
-            for (const auto& jc : jblock["contents"]) {
+        if (!data) continue;
+        nlohmann::json jc = nlohmann::json::parse(reinterpret_cast<const char*>(data));
+        Content c;
+        c.type = jc["type"];
+        c.filename = jc["filename"];
+        c.uploader = jc["uploader"];
+        c.hash = jc["hash"];
+        c.timestamp = jc["timestamp"];
+        c.publicKeyPem = jc.value("publicKeyPem", "");
+        pendingContentBytes += contentMemoryUsage(c);
+        pendingContents.push_back(c);
+        // Rows saved before arrival times were recorded count as arriving now
+        pendingContentArrivals.push_back(jc.value("arrivedAt", (std::time_t)std::time(nullptr)));
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+size_t Blockchain::contentMemoryUsage(const Content& c) {
+    return sizeof(Content) + c.type.capacity() + c.filename.capacity() + c.uploader.capacity() +
+           c.hash.capacity() + c.publicKeyPem.capacity();
+}
+
+// Caller holds mempoolMutex
+template <typename Pred>
+size_t Blockchain::erasePendingContentsIf(Pred drop) {
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingContents.size(); ++i) {
+        if (drop(pendingContents[i], pendingContentArrivals[i])) {
+            pendingContentBytes -= contentMemoryUsage(pendingContents[i]);
+            continue;
+        }
+        if (kept != i) {
+            pendingContents[kept] = std::move(pendingContents[i]);
+            pendingContentArrivals[kept] = pendingContentArrivals[i];
+        }
+        ++kept;
+    }
+    size_t removed = pendingContents.size() - kept;
+    pendingContents.resize(kept);
+    pendingContentArrivals.resize(kept);
+    return removed;
+}
+
+// TTL sweep for both pending pools, at most once per second. Caller holds mempoolMutex.
+// Uploads expire by local arrival time; Content::timestamp is uploader-supplied.
+void Blockchain::expirePending(std::time_t now) {
+    if (now == lastPendingExpiry) return;
+    lastPendingExpiry = now;
+    std::vector<Transaction> expired;
+    mempool.expire(now, &expired);
+    for (const auto& tx : expired) logConsensusEvent("Mempool expiry", calculateTxId(tx));
+    size_t removed = erasePendingContentsIf([&](const Content&, std::time_t arrivedAt) {
+        return now - arrivedAt >= pendingContentTtl;
+    });
+    pendingContentExpirations += removed;
+    if (removed) ++contentsRevision;
+}
+
+void Blockchain::setReplacementFeeRatio(double ratio) {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    minReplacementFeeRatio = std::max(ratio, 1.0);
+}
+
+void Blockchain::setMempoolLimits(size_t maxCount, size_t maxBytes, int ttlSeconds) {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    mempool.setLimits(maxCount, maxBytes, ttlSeconds);
+}
+
+void Blockchain::setMempoolEvictionPolicy(MempoolEvictionPolicy policy) {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    mempool.setEvictionPolicy(policy);
+}
+
+void Blockchain::setPendingContentLimits(size_t maxCount, size_t maxBytes, int ttlSeconds) {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    maxPendingContents = maxCount;
+    maxPendingContentBytes = maxBytes;
+    pendingContentTtl = ttlSeconds;
+}
+
+std::vector<Transaction> Blockchain::getMempool() const {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    std::vector<Transaction> txs;
+    for (const auto* entry : mempool.bestFirst(mempool.size())) txs.push_back(entry->tx);
+    return txs;
+}
+
+MempoolStats Blockchain::getMempoolStats() const {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    MempoolStats stats;
+    stats.count = mempool.size();
+    stats.bytes = mempool.bytes();
+    stats.txBytes = mempool.txBytes();
+    stats.minFeeRate = mempool.minFeeRate();
+    stats.maxFeeRate = mempool.maxFeeRate();
+    stats.feeHistogram = mempool.feeHistogram(2.0, 16);
+    stats.pendingContents = pendingContents.size();
+    stats.pendingContentBytes = pendingContentBytes;
+    return stats;
+}
+
+std::vector<Mempool::Entry> Blockchain::queryMempool(MempoolOrder order, size_t offset, size_t limit) const {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    std::vector<Mempool::Entry> result;
+    for (const auto* entry : mempool.page(order, offset, limit)) result.push_back(*entry);
+    return result;
+}
+
+bool Blockchain::findMempoolTx(const std::string& txId, Mempool::Entry* out) const {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    const Mempool::Entry* entry = mempool.find(txId);
+    if (!entry) return false;
+    if (out) *out = *entry;
+    return true;
+}
+
+std::vector<Mempool::Entry> Blockchain::getMempoolBySender(const std::string& sender) const {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    std::vector<Mempool::Entry> result;
+    for (const auto* entry : mempool.bySender(sender)) result.push_back(*entry);
+    return result;
+}
+
+std::vector<Content> Blockchain::getPendingContents(size_t offset, size_t limit) const {
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    if (offset >= pendingContents.size()) return {};
+    auto begin = pendingContents.begin() + offset;
+    return std::vector<Content>(begin, begin + std::min(limit, pendingContents.size() - offset));
+}
+
+size_t Blockchain::contentSize(const Content& c) {
+    return c.type.size() + c.filename.size() + c.uploader.size() + c.hash.size() + c.publicKeyPem.size() + sizeof(c.timestamp);
+}
+
+void Blockchain::setBlockLimits(size_t maxBytes, size_t maxTxs, size_t maxContents) {
+    std::lock_guard<std::mutex> chainLock(chainMutex);
+    std::lock_guard<std::mutex> poolLock(mempoolMutex);
+    maxBlockBytes = maxBytes;
+    maxBlockTxs = maxTxs;
+    maxBlockContents = maxContents;
+    cachedTemplate.reset();
+}
+
+BlockTemplatePtr Blockchain::getBlockTemplate() {
+    std::lock_guard<std::mutex> chainLock(chainMutex);
+    std::lock_guard<std::mutex> poolLock(mempoolMutex);
+    return buildBlockTemplate();
+}
+
+// Fills a block up to the byte and count limits. Contents go first, in arrival
+// order and under their own count limit; transactions then take the remaining
+// bytes by fee priority. Everything left over stays pending. The previous
+// template (with its merkle root and serialized body) is reused until the tip
+// (and with it the target) or either pool changes. Caller holds chainMutex and mempoolMutex.
+BlockTemplatePtr Blockchain::buildBlockTemplate() {
+    if (cachedTemplate && cachedTemplate->block.prevHash == chain.back()->hash &&
+        cachedTemplate->mempoolRevision == mempool.getRevision() &&
+        cachedTemplate->contentsRevision == contentsRevision) {
+        return cachedTemplate;
+    }
+    auto tpl = std::make_shared<BlockTemplate>();
+    Block& block = tpl->block;
+    block.index = chain.size();
+    block.prevHash = chain.back()->hash;
+    block.bits = lwmaNextBits(retargetHistory(chain.back()->index), targetBlockTime, retargetWindow);
+    // Informational for the explorer: hex zeros the target guarantees, at least 1 so the block reads as PoW
+    block.difficulty = std::max(1, (int)(256 - Uint256::fromCompact(block.bits).bitLength()) / 4);
+    block.nonce = 0;
+    for (const auto& c : pendingContents) {
+        size_t size = contentSize(c);
+        if (block.contents.size() >= maxBlockContents || tpl->contentBytes + size > maxBlockBytes) break;
+        block.contents.push_back(c);
+        tpl->contentBytes += size;
+    }
+    for (const auto* entry : mempool.selectForBlock(maxBlockTxs, maxBlockBytes - tpl->contentBytes)) {
+        block.transactions.push_back(entry->tx);
+        tpl->txBytes += entry->size;
+    }
+    block.merkleRoot = calculateMerkleRoot(block.transactions);
+    tpl->bodyData = serializeBlockBody(block);
+    tpl->mempoolRevision = mempool.getRevision();
+    tpl->contentsRevision = contentsRevision;
+    cachedTemplate = tpl;
+    return cachedTemplate;
+}
+
+// Re-establishes the admission invariants for one sender after its confirmed state
+// changed underneath the pool (a block from a peer or a reorg): pending nonces must
+// continue the confirmed one without gaps and stay jointly fundable.
+// Caller holds chainMutex and mempoolMutex.
+void Blockchain::reconcileMempoolSender(const std::string& sender) {
+    uint64_t confirmedNonce = accountNonces.get().count(sender) ? accountNonces.get().at(sender) : 0;
+    double available = balances.get().count(sender) ? balances.get().at(sender) : 0;
+    uint64_t expected = confirmedNonce + 1;
+    double debit = 0;
+    for (const auto* entry : mempool.bySender(sender)) {
+        if (entry->tx.nonce <= confirmedNonce) {
+            mempool.remove(entry->txId); // conflicts with a confirmed transaction
+            continue;
+        }
+        debit += entry->tx.amount + entry->tx.fee;
+        if (entry->tx.nonce != expected || debit > available) {
+            mempool.removeWithDescendants(entry->txId);
+            break;
+        }
+        ++expected;
+    }
+}
+
+uint64_t Blockchain::getNextNonce(const std::string& address) const {
+    StateSnapshotPtr state = snapshot();
+    auto it = state->accountNonces->find(address);
+    uint64_t confirmedNonce = it == state->accountNonces->end() ? 0 : it->second;
+    std::lock_guard<std::mutex> lock(mempoolMutex);
+    return mempool.nextNonce(address, confirmedNonce);
+}
+
+// Drops everything a newly connected block included; entries added since the
+// block's template was taken stay pending. Caller holds chainMutex and mempoolMutex.
+void Blockchain::removeIncludedFromPending(const Block& block) {
+    std::set<std::string> senders;
+    for (const auto& tx : block.transactions) {
+        mempool.remove(calculateTxId(tx));
+        senders.insert(tx.sender);
+    }
+    for (const auto& sender : senders) reconcileMempoolSender(sender);
+    std::set<std::pair<std::string, std::string>> minedContents;
+    for (const auto& c : block.contents) minedContents.insert({c.hash, c.uploader});
+    erasePendingContentsIf([&](const Content& c, std::time_t) { return minedContents.count({c.hash, c.uploader}) > 0; });
+    ++contentsRevision;
+}
+
+// Caller holds chainMutex. The state maps are shared, not copied (an edited map
+// was already cloned by its first edit); the block pointer list is still copied,
+// O(height) pointer copies, and that cost is exported as a metric.
+void Blockchain::publishSnapshot() {
+    auto start = std::chrono::steady_clock::now();
+    auto next = std::make_shared<ChainStateSnapshot>();
+    next->version = ++stateVersion;
+    next->chain = chain.share();
+    next->balances = balances.share();
+    next->stakes = stakes.share();
+    next->delegatedStakes = delegatedStakes.share();
+    next->accountNonces = accountNonces.share();
+    std::atomic_store(&stateSnapshot, StateSnapshotPtr(std::move(next)));
+    publishNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Caller holds chainMutex
+double Blockchain::getBalanceLocked(const std::string& address) const {
+    auto it = balances.get().find(address);
+    return it == balances.get().end() ? 0 : it->second;
+}
+
+StateSnapshotPtr Blockchain::snapshot() const {
+    return std::atomic_load(&stateSnapshot);
+}
+
+bool Blockchain::validProof(const Block& block) const {
+    if (block.bits) {
+        Uint256 target = Uint256::fromCompact(block.bits);
+        return !target.isZero() && target <= powLimit() && Uint256::fromHex(block.hash) <= target;
+    }
+    // Legacy rule: leading hex zeros
+    return block.hash.substr(0, block.difficulty) == std::string(block.difficulty, '0');
+}
+
+// Easiest target allowed: one leading hex zero, the old minimum difficulty
+Uint256 Blockchain::powLimit() {
+    return Uint256::fromLeadingZeros(1);
+}
+
+Uint256 Blockchain::blockTarget(const Block& block) {
+    return block.bits ? Uint256::fromCompact(block.bits) : Uint256::fromLeadingZeros(block.difficulty);
+}
+
+// LWMA: next = average target * sum(i * solvetime_i) / (sum(i) * T) over the last
+// n blocks, i = 1 for the oldest. Solve times are clamped to [1, 6T] so a single
+// bad timestamp cannot swing the target far.
+uint32_t Blockchain::lwmaNextBits(const std::vector<const Block*>& history, int targetSeconds, size_t window) {
+    if (history.empty()) return powLimit().toCompact();
+    if (history.size() < 2) return blockTarget(*history.back()).toCompact();
+    size_t n = std::min(window, history.size() - 1);
+    size_t base = history.size() - 1 - n;
+    Uint256 averageTarget;
+    uint64_t weightedSolveTime = 0;
+    for (size_t i = 1; i <= n; ++i) {
+        int64_t solveTime = (int64_t)history[base + i]->timestamp - (int64_t)history[base + i - 1]->timestamp;
+        solveTime = std::min<int64_t>(std::max<int64_t>(solveTime, 1), 6 * (int64_t)targetSeconds);
+        weightedSolveTime += (uint64_t)solveTime * i;
+        Uint256 target = blockTarget(*history[base + i]);
+        target /= (uint32_t)n;
+        averageTarget += target;
+    }
+    uint64_t expected = (uint64_t)n * (n + 1) / 2 * targetSeconds;
+    // Ratio in 1/65536 units (at most 6 * 65536); shift first so the product stays in 256 bits
+    uint64_t ratio = std::max<uint64_t>(weightedSolveTime * 65536 / expected, 1);
+    averageTarget >>= 16;
+    averageTarget *= (uint32_t)ratio;
+    if (averageTarget.isZero()) averageTarget = Uint256(1);
+    if (averageTarget > powLimit()) averageTarget = powLimit();
+    return averageTarget.toCompact();
+}
+
+std::vector<const Block*> Blockchain::retargetHistory(int parentHeight) const {
+    return retargetHistory(chain.view(), parentHeight, retargetWindow);
+}
+
+std::vector<const Block*> Blockchain::retargetHistory(const ChainView& blocks, int parentHeight, size_t window) {
+    std::vector<const Block*> history;
+    for (int h = std::min(parentHeight, (int)blocks.size() - 1); h >= 0 && history.size() <= window; --h) {
+        if (blocks[h]->difficulty != 0) history.push_back(blocks[h].get()); // stake blocks carry no target
+    }
+    std::reverse(history.begin(), history.end());
+    return history;
+}
+
+// Target rules for a stored block, re-derived from its own ancestry in blocks rather
+// than from our active chain, so audits of any snapshot check bits too
+bool Blockchain::checkBlockBits(const ChainView& blocks, size_t height, int targetSeconds, size_t window, int activationHeight,
+                                std::string& reason) {
+    const Block& block = *blocks[height];
+    if (block.difficulty == 0) {
+        if (block.bits != 0) { reason = "stake block carries a target"; return false; }
+        return true;
+    }
+    // Mined before LWMA: validProof already held it to its leading zeros
+    if (block.bits == 0 && (int)height < activationHeight) return true;
+    if (block.bits != lwmaNextBits(retargetHistory(blocks, (int)height - 1, window), targetSeconds, window)) {
+        reason = "bits do not match the retarget";
+        return false;
+    }
+    return true;
+}
+
+bool Blockchain::setRetargetParams(int targetSeconds, size_t window) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    // Audits re-derive every stored target from these, so they cannot change under history
+    for (int h = (int)chain.size() - 1; h >= lwmaActivationHeight; --h) {
+        if (chain[h]->bits != 0) {
+            logError("Retarget parameters are pinned: block " + std::to_string(h) + " was mined under them");
+            return false;
+        }
+    }
+    // Bounds keep sum(i) * T inside the 32-bit divisor lwmaNextBits uses
+    targetBlockTime = std::min(std::max(targetSeconds, 1), 3600);
+    retargetWindow = std::min<size_t>(std::max<size_t>(window, 2), 1000);
+    cachedTemplate.reset();
+    return true;
+}
+
+int Blockchain::getTargetBlockTime() const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return targetBlockTime;
+}
+
+size_t Blockchain::getRetargetWindow() const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return retargetWindow;
+}
+
+uint32_t Blockchain::getNextBits() const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return lwmaNextBits(retargetHistory(chain.back()->index), targetBlockTime, retargetWindow);
+}
+
+bool Blockchain::mineBlock(const std::string& miner) {
+    return mineBlockUntil(miner, nullptr);
+}
+
+// Build the template from a consistent view, then search without holding any lock
+bool Blockchain::mineBlockUntil(const std::string& miner, const std::atomic<bool>* keepRunning) {
+    for (;;) {
+        BlockTemplatePtr tpl;
+        {
+            std::lock_guard<std::mutex> chainLock(chainMutex);
+            std::lock_guard<std::mutex> poolLock(mempoolMutex);
+            if (mempool.empty() && pendingContents.empty()) return false;
+            tpl = buildBlockTemplate();
+        }
+        Block newBlock = tpl->block;
+        newBlock.timestamp = std::time(nullptr);
+        newBlock.miner = miner;
+        newBlock.nonce = 0;
+        // Improved Proof-of-Work: the body is serialized once and the header prefix
+        // is absorbed once, so each attempt only hashes the nonce and the suffix.
+        PowSearcher searcher(headerPrefix(newBlock), headerSuffix(newBlock, tpl->bodyData),
+                             Uint256::fromCompact(newBlock.bits).toHex());
+        int64_t nonce = 1, found = 0;
+        uint64_t hashes = 0;
+        bool stale = false;
+        // Every 4096 attempts: stop if asked, restart if a newer template exists
+        while (!searcher.search(nonce, nonce + 0x1000, &found, &hashes)) {
+            nonce += 0x1000;
+            if (keepRunning && !keepRunning->load()) return false;
+            // Nonces are ints on disk; a fresh template also brings a fresh timestamp
+            stale = templateStale(*tpl) || nonce > INT_MAX - 0x1000;
+            if (stale) break;
+        }
+        if (stale) {
+            ++templateRefreshes;
+            continue;
+        }
+        newBlock.nonce = (int)found;
+        newBlock.hash = hashBlockWithBody(newBlock, tpl->bodyData);
+        bool staleTip = false;
+        if (connectMinedBlock(newBlock, &staleTip)) return true;
+        if (!staleTip) return false;
+        logError("Tip changed while mining, retrying on the new tip.");
+    }
+}
+
+bool Blockchain::connectMinedBlock(const Block& block, bool* staleTip) {
+    std::lock_guard<std::mutex> chainLock(chainMutex);
+    // A peer block may have been applied since the template was taken
+    if (chain.back()->hash != block.prevHash) {
+        ++staleBlocks;
+        *staleTip = true;
+        return false;
+    }
+    // Validate before adding
+    if (!validateBlock(block, *chain.back())) {
+        logError("Invalid block mined, not adding to chain.");
+        return false;
+    }
+    appendBlock(block);
+    applyBlockState(block, 1);
+    std::lock_guard<std::mutex> poolLock(mempoolMutex);
+    removeIncludedFromPending(block);
+    publishSnapshot();
+    return true;
+}
+
+bool Blockchain::submitBlock(const Block& block) {
+    bool staleTip = false;
+    return connectMinedBlock(block, &staleTip);
+}
+
+// The tip is read from the published snapshot so the check never waits on chainMutex
+bool Blockchain::templateStale(const BlockTemplate& tpl) const {
+    if (snapshot()->chain.back()->hash != tpl.block.prevHash) return true;
+    std::lock_guard<std::mutex> poolLock(mempoolMutex);
+    return mempool.getRevision() != tpl.mempoolRevision || contentsRevision != tpl.contentsRevision;
+}
+
+bool Blockchain::startBlockProducer(const std::string& producer) {
+    if (producerRunning.exchange(true)) return false;
+    producerThread = std::thread(&Blockchain::producerLoop, this, producer);
+    return true;
+}
+
+void Blockchain::stopBlockProducer() {
+    {
+        std::lock_guard<std::mutex> lock(producerWakeMutex);
+        producerRunning = false;
+    }
+    producerWake.notify_all();
+    if (producerThread.joinable()) producerThread.join();
+}
+
+BlockProducerStats Blockchain::getBlockProducerStats() const {
+    BlockProducerStats stats;
+    stats.running = producerRunning;
+    stats.blocks = producedBlocks;
+    stats.templateRefreshes = templateRefreshes;
+    stats.staleBlocks = staleBlocks;
+    stats.lastBlockAt = lastProducedAt;
+    return stats;
+}
+
+bool Blockchain::setThreadPlacement(const std::string& miningCpus, const std::string& reservedCpus) {
+    ThreadPlacement placement;
+    if (!placement.configure(miningCpus, reservedCpus)) {
+        logError("Rejected thread placement: mining '" + miningCpus + "', reserved '" + reservedCpus + "'");
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(placementMutex);
+    threadPlacement = placement;
+    return true;
+}
+
+ThreadPlacement Blockchain::getThreadPlacement() const {
+    std::lock_guard<std::mutex> lock(placementMutex);
+    return threadPlacement;
+}
+
+bool Blockchain::saveThreadPlacement() {
+    if (!db) return false;
+    ThreadPlacement placement = getThreadPlacement();
+    std::string sql = "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('mining_cpus', '" + formatCpuList(placement.getMiningCpus()) + "');"
+                      "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('reserved_cpus', '" + formatCpuList(placement.getReservedCpus()) + "');";
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        logError(std::string("Failed to save thread placement: ") + errMsg);
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+// Stake modes wake on slot boundaries, so a block (if anything is pending) lands
+// at most one slot after an upload. PoW idles briefly when there is nothing to mine.
+void Blockchain::producerLoop(const std::string& producer) {
+    // The producer is mining worker 0; its templates are built after pinning
+    getThreadPlacement().pinMiningWorker(0);
+    while (producerRunning) {
+        ConsensusMode mode = getConsensusMode();
+        bool produced = false;
+        if (mode == ConsensusMode::PoW) {
+            produced = mineBlockUntil(producer, &producerRunning);
+            if (!produced) {
+                std::unique_lock<std::mutex> lock(producerWakeMutex);
+                producerWake.wait_for(lock, std::chrono::milliseconds(500), [this] { return !producerRunning; });
+            }
+        } else {
+            uint64_t nextSlot = slotAt(std::time(nullptr)) + 1;
+            auto boundary = std::chrono::system_clock::from_time_t((std::time_t)(nextSlot * dposSlotSeconds));
+            {
+                std::unique_lock<std::mutex> lock(producerWakeMutex);
+                if (producerWake.wait_until(lock, boundary, [this] { return !producerRunning; })) break;
+            }
+            produced = mode == ConsensusMode::PoS ? mineBlockPoS() : mineBlockDPoS(producer);
+        }
+        if (produced) {
+            ++producedBlocks;
+            lastProducedAt = std::time(nullptr);
+            logConsensusEvent("Block produced", "Height " + std::to_string(getHeight()) + " by " + producer);
+        }
+    }
+}
+
+bool Blockchain::validateBlock(const Block& newBlock, const Block& prevBlock, const std::vector<Block>* branch) const {
+    if (newBlock.prevHash != prevBlock.hash) return false;
+    if (newBlock.hash != calculateHash(newBlock)) return false;
+    if (!validProof(newBlock)) return false;
+    if (newBlock.timestamp < prevBlock.timestamp) return false;
+    if (newBlock.difficulty != 0) {
+        // New PoW blocks carry the LWMA target computed from their own history; only
+        // blocks below the activation height may be legacy ones without
+        if (newBlock.bits == 0 && newBlock.index >= lwmaActivationHeight) return false;
+        bool parentInChain = prevBlock.index < (int)chain.size() && chain[prevBlock.index]->hash == prevBlock.hash;
+        if (newBlock.bits != 0 && parentInChain &&
+            newBlock.bits != lwmaNextBits(retargetHistory(prevBlock.index), targetBlockTime, retargetWindow)) return false;
+    } else if (newBlock.bits != 0) {
+        return false;
+    } else if (consensusMode == ConsensusMode::PoW) {
+        return false; // zero-work blocks are only produced by stake consensus
+    }
+    if (consensusMode == ConsensusMode::PoS && newBlock.difficulty == 0) {
+        // Same seeded draw the producer made over the stakes it saw, so only the selected
+        // staker can sign off a block and later stake changes cannot unseat it
+        if (newBlock.miner != stakerAt(prevBlock.index, prevBlock.hash)) return false;
+    }
+    if (consensusMode == ConsensusMode::DPoS && newBlock.difficulty == 0) {
+        // Only the scheduled delegate may fill a slot, and only once
+        uint64_t slot = slotAt(newBlock.timestamp);
+        if (prevBlock.index > 0 && slot <= slotAt(prevBlock.timestamp)) return false;
+        if (newBlock.miner != producerForSlot(slot, prevBlock, branch)) return false;
+        if (!validateBlockBFT(newBlock)) return false;
+    }
+    return true;
+}
+
+// Wall-clock rule for blocks arriving now: a DPoS block may not claim a slot ahead of
+// the current one. Kept out of validateBlock so re-checking stored blocks never
+// depends on the local clock; the slot schedule itself comes from the chain.
+bool Blockchain::timestampAcceptable(const Block& block, std::time_t now) const {
+    if (consensusMode == ConsensusMode::DPoS && block.difficulty == 0) return block.timestamp <= now + dposSlotSeconds;
+    return true;
+}
+
+// Checks a block's transactions against the state it builds on: signatures, each
+// sender's nonces continuing its confirmed one, and every debit funded by the time
+// it runs. Caller holds chainMutex and the block must extend the current state.
+bool Blockchain::validateBlockTransactions(const Block& block, std::string& reason) const {
+    if (!block.merkleRoot.empty() && block.merkleRoot != calculateMerkleRoot(block.transactions)) {
+        reason = "merkle root mismatch";
+        return false;
+    }
+    std::map<std::string, double> funds;     // running balance of every account touched
+    std::map<std::string, uint64_t> nonces;  // next nonce expected per sender
+    auto fundsOf = [&](const std::string& address) -> double& {
+        auto it = funds.find(address);
+        if (it == funds.end()) it = funds.emplace(address, getBalanceLocked(address)).first;
+        return it->second;
+    };
+    for (const auto& tx : block.transactions) {
+        if (tx.amount <= 0 || tx.fee < 0) { reason = "invalid tx amount or fee"; return false; }
+        if (tx.sender != Wallet::publicKeyToAddress(tx.publicKeyPem)) { reason = "tx sender does not match public key"; return false; }
+        if (!Wallet::verify(txSigningData(tx), tx.signature, tx.publicKeyPem)) { reason = "invalid tx signature"; return false; }
+        auto next = nonces.find(tx.sender);
+        if (next == nonces.end()) {
+            auto confirmed = accountNonces.get().find(tx.sender);
+            next = nonces.emplace(tx.sender, (confirmed == accountNonces.get().end() ? 0 : confirmed->second) + 1).first;
+        }
+        if (tx.nonce != next->second++) { reason = "tx nonce out of sequence for " + tx.sender; return false; }
+        double& available = fundsOf(tx.sender);
+        if (available < tx.amount + effectiveFee(tx)) { reason = "tx overspends " + tx.sender; return false; }
+        available -= tx.amount + effectiveFee(tx);
+        fundsOf(tx.receiver) += tx.amount;
+    }
+    return true;
+}
+
+// Same per-block checks as verifyChainParallel, so both audits accept the same chains
+bool Blockchain::validateChainFrom(const ChainView& blocks, size_t start) const {
+    int targetSeconds, activationHeight;
+    size_t window;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        targetSeconds = targetBlockTime;
+        window = retargetWindow;
+        activationHeight = lwmaActivationHeight;
+    }
+    std::string reason;
+    for (size_t i = std::max<size_t>(start, 1); i < blocks.size(); ++i) {
+        if (!checkBlockStandalone(*blocks[i], *blocks[i-1], reason) || !checkBlockBits(blocks, i, targetSeconds, window, activationHeight, reason)) {
+            std::cerr << "Chain invalid at height " << i << ": " << reason << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Only re-checks blocks above the verified watermark; falls back to a full pass
+// if the watermark block is no longer on our chain (e.g. after a reorg).
+// An advanced watermark is persisted so the next run starts from it too.
+bool Blockchain::isValidChain() {
+    StateSnapshotPtr state = snapshot();
+    const auto& blocks = state->chain;
+    size_t start = 1;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        if (verifiedHeight > 0 && verifiedHeight < (int)blocks.size() && blocks[verifiedHeight]->hash == verifiedHash) {
+            start = verifiedHeight + 1;
+        }
+    }
+    if (!validateChainFrom(blocks, start)) return false;
+    if (blocks.empty()) return true;
+    bool advanced;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        advanced = verifiedHeight != (int)blocks.size() - 1 || verifiedHash != blocks.back()->hash;
+        verifiedHeight = (int)blocks.size() - 1;
+        verifiedHash = blocks.back()->hash;
+    }
+    if (advanced) saveVerifiedWatermark();
+    return true;
+}
+
+bool Blockchain::verifyChain(bool full) {
+    if (full) {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        verifiedHeight = 0;
+        verifiedHash.clear();
+    }
+    return isValidChain();
+}
+
+// The checks an orphan can pass without its parent: hash, proof of work against its
+// own target and merkle root. Context rules run again once the parent arrives.
+bool Blockchain::checkOrphanHeader(const Block& block, std::string& reason) const {
+    if (block.hash != calculateHash(block)) { reason = "hash mismatch"; return false; }
+    if (block.difficulty != 0 && block.bits == 0 && block.index >= lwmaActivationHeight) { reason = "missing PoW target"; return false; }
+    if (block.difficulty == 0 && block.bits != 0) { reason = "stake block with a PoW target"; return false; }
+    if (block.difficulty == 0 && consensusMode == ConsensusMode::PoW) { reason = "zero-work block under PoW"; return false; }
+    if (!timestampAcceptable(block, std::time(nullptr))) { reason = "timestamp too far in the future"; return false; }
+    if (!validProof(block)) { reason = "insufficient proof of work"; return false; }
+    // Without the parent the exact retarget is unknown, but it cannot have eased far from
+    // ours; otherwise a powLimit hash (about 16 tries) would be enough to take a pool slot
+    if (block.bits != 0) {
+        Uint256 ceiling = Uint256::fromCompact(lwmaNextBits(retargetHistory(chain.back()->index), targetBlockTime, retargetWindow));
+        ceiling <<= orphanTargetSlackBits;
+        if (ceiling > powLimit()) ceiling = powLimit();
+        if (Uint256::fromCompact(block.bits) > ceiling) { reason = "target far easier than ours"; return false; }
+    }
+    if (block.merkleRoot != calculateMerkleRoot(block.transactions)) { reason = "merkle root mismatch"; return false; }
+    return true;
+}
+
+// Checks everything about a block that does not depend on chain state:
+// linkage to its stored parent, hash, PoW, merkle root and transaction signatures
+bool Blockchain::checkBlockStandalone(const Block& block, const Block& prevBlock, std::string& reason) const {
+    if (block.prevHash != prevBlock.hash) { reason = "prevHash mismatch"; return false; }
+    if (block.timestamp < prevBlock.timestamp) { reason = "timestamp before parent"; return false; }
+    if (block.hash != calculateHash(block)) { reason = "hash mismatch"; return false; }
+    if (!validProof(block)) { reason = "insufficient proof of work"; return false; }
+    // Legacy blocks may have been stored without a merkle root
+    if (!block.merkleRoot.empty() && block.merkleRoot != calculateMerkleRoot(block.transactions)) {
+        reason = "merkle root mismatch";
+        return false;
+    }
+    for (const auto& tx : block.transactions) {
+        if (tx.sender != Wallet::publicKeyToAddress(tx.publicKeyPem)) { reason = "tx sender does not match public key"; return false; }
+        if (!Wallet::verify(txSigningData(tx), tx.signature, tx.publicKeyPem)) {
+            reason = "invalid tx signature";
+            return false;
+        }
+    }
+    return true;
+}
+
+ChainVerifyReport Blockchain::verifyChainParallel(unsigned threads) {
+    ChainVerifyReport report;
+    ThreadPlacement placement = getThreadPlacement();
+    if (threads == 0) threads = placement.getReservedCpus().empty() ? std::max(1u, std::thread::hardware_concurrency())
+                                                                     : (unsigned)placement.getReservedCpus().size();
+    report.threads = threads;
+    auto start = std::chrono::steady_clock::now();
+    // Work on a pointer snapshot so writers are not blocked during the audit
+    ChainView blocks = snapshot()->chain;
+    int targetSeconds, activationHeight;
+    size_t window;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        targetSeconds = targetBlockTime;
+        window = retargetWindow;
+        activationHeight = lwmaActivationHeight;
+    }
+    // Workers pull fixed-size chunks so uneven block sizes still balance across cores
+    const size_t chunkSize = 64;
+    std::atomic<size_t> nextChunk{1};
+    std::atomic<int> firstInvalid{std::numeric_limits<int>::max()};
+    std::atomic<size_t> txsChecked{0};
+    std::mutex reasonMutex;
+    std::string firstReason;
+    auto worker = [&]() {
+        placement.pinReserved();
+        for (;;) {
+            size_t begin = nextChunk.fetch_add(chunkSize);
+            if (begin >= blocks.size()) return;
+            // Nothing past an already-found failure can change the result
+            if ((int)begin > firstInvalid.load()) return;
+            size_t end = std::min(begin + chunkSize, blocks.size());
+            for (size_t i = begin; i < end; ++i) {
+                std::string reason;
+                // The parent is in the shared snapshot, so linkage across chunk boundaries is checked here too;
+                // so is the retarget window, which reaches back before the chunk
+                if (!checkBlockStandalone(*blocks[i], *blocks[i-1], reason) || !checkBlockBits(blocks, i, targetSeconds, window, activationHeight, reason)) {
+                    std::lock_guard<std::mutex> lock(reasonMutex);
+                    if ((int)i < firstInvalid.load()) {
+                        firstInvalid = (int)i;
+                        firstReason = reason;
+                    }
+                    break;
+                }
+                txsChecked += blocks[i]->transactions.size();
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& th : pool) th.join();
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.txsChecked = txsChecked;
+    if (firstInvalid.load() != std::numeric_limits<int>::max()) {
+        report.valid = false;
+        report.firstInvalidHeight = firstInvalid;
+        report.reason = firstReason;
+        report.blocksChecked = firstInvalid;
+        return report;
+    }
+    report.blocksChecked = blocks.size();
+    if (blocks.empty()) return report;
+    // Everything checked out: advance the watermark so routine checks start from here
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        verifiedHeight = (int)blocks.size() - 1;
+        verifiedHash = blocks.back()->hash;
+    }
+    saveVerifiedWatermark();
+    return report;
+}
+
+int Blockchain::getVerifiedHeight() const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return verifiedHeight;
+}
+
+// Consensus mode and DPoS schedule parameters survive restarts (set-consensus used to be lost)
+bool Blockchain::saveConsensusSettings() {
+    if (!db) return false;
+    std::string sql;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        sql = "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('consensus_mode', '" + std::to_string((int)consensusMode) + "');"
+              "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('dpos_slot_seconds', '" + std::to_string(dposSlotSeconds) + "');"
+              "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('dpos_max_producers', '" + std::to_string(dposMaxProducers) + "');"
+              "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('dpos_rounds_per_epoch', '" + std::to_string(dposRoundsPerEpoch) + "');"
+              "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('target_block_time', '" + std::to_string(targetBlockTime) + "');"
+              "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('retarget_window', '" + std::to_string(retargetWindow) + "');"
+              "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('lwma_activation_height', '" + std::to_string(lwmaActivationHeight) + "');"
+              "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('finalized_height', '" + std::to_string(finality.getFinalizedHeight()) + "');"
+              "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('finalized_hash', '" + finality.getFinalizedHash() + "');";
+    }
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        logError(std::string("Failed to save consensus settings: ") + errMsg);
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool Blockchain::saveVerifiedWatermark() {
+    if (!db) return false;
+    char* errMsg = nullptr;
+    std::string sql;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        sql = "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('verified_height', '" + std::to_string(verifiedHeight) + "');"
+              "INSERT OR REPLACE INTO chain_meta (key, value) VALUES ('verified_hash', '" + verifiedHash + "');";
+    }
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        logError(std::string("Failed to save verified watermark: ") + errMsg);
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+std::vector<Block> Blockchain::getChain() const {
+    // Deep copy kept for callers that need mutable blocks; prefer blockAt/blocksInRange
+    StateSnapshotPtr state = snapshot();
+    std::vector<Block> copy;
+    copy.reserve(state->chain.size());
+    for (const auto& block : state->chain) copy.push_back(*block);
+    return copy;
+}
+
+BlockPtr Blockchain::blockAt(int height) const {
+    StateSnapshotPtr state = snapshot();
+    if (height < 0 || height >= (int)state->chain.size()) return nullptr;
+    return state->chain[height];
+}
+
+// Returns blocks in [from, to], clamped to the current chain; only pointers are copied
+std::vector<BlockPtr> Blockchain::blocksInRange(int from, int to) const {
+    StateSnapshotPtr state = snapshot();
+    const auto& blocks = state->chain;
+    if (from < 0) from = 0;
+    if (to >= (int)blocks.size()) to = (int)blocks.size() - 1;
+    if (from > to) return {};
+    return std::vector<BlockPtr>(blocks.begin() + from, blocks.begin() + to + 1);
+}
+
+BlockPtr Blockchain::tip() const {
+    StateSnapshotPtr state = snapshot();
+    return state->chain.empty() ? nullptr : state->chain.back();
+}
+
+int Blockchain::getHeight() const {
+    return (int)snapshot()->chain.size() - 1;
+}
+
+double Blockchain::getChainWork() const {
+    BlockPtr last = tip();
+    return last ? last->chainWork : 0;
+}
+
+std::map<std::string, double> Blockchain::getBalances() const {
+    return *snapshot()->balances;
+}
+
+bool Blockchain::saveToDb() {
+    if (!db) return false;
+    char* errMsg = nullptr;
+    StateSnapshotPtr state = snapshot();
+    sqlite3_exec(db, "DELETE FROM blocks;", nullptr, nullptr, &errMsg);
+    for (const auto& blockPtr : state->chain) {
+        const Block& block = *blockPtr;
+        nlohmann::json jblock;
+        jblock["index"] = block.index;
+        jblock["prevHash"] = block.prevHash;
+        jblock["hash"] = block.hash;
+        jblock["merkleRoot"] = block.merkleRoot;
+        jblock["timestamp"] = block.timestamp;
+        jblock["miner"] = block.miner;
+        jblock["nonce"] = block.nonce;
+        jblock["difficulty"] = block.difficulty;
+        if (block.bits) jblock["bits"] = block.bits;
+        // Transactions
+        for (const auto& tx : block.transactions) {
+            nlohmann::json jtx;
+            jtx["sender"] = tx.sender;
+            jtx["receiver"] = tx.receiver;
+            jtx["amount"] = tx.amount;
+            jtx["signature"] = tx.signature;
+            jtx["publicKeyPem"] = tx.publicKeyPem;
+            jtx["fee"] = tx.fee;
+            jtx["nonce"] = tx.nonce;
+            jblock["transactions"].push_back(jtx);
+        }
+        // Contents
+        for (const auto& c : block.contents) {
+            nlohmann::json jc;
+            jc["type"] = c.type;
+            jc["filename"] = c.filename;
+            jc["uploader"] = c.uploader;
+            jc["hash"] = c.hash;
+            jc["timestamp"] = c.timestamp;
+            jc["publicKeyPem"] = c.publicKeyPem;
+            jblock["contents"].push_back(jc);
+        }
+        std::string sql = "INSERT INTO blocks (id, data) VALUES (" + std::to_string(block.index) + ", '" + jblock.dump() + "');";
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "DB insert error: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+            return false;
+        }
+    }
+    // Persist txids of blocks connected (or replaced by a reorg) since the last save
+    int dirtyFrom;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        dirtyFrom = txIndexDirtyFrom;
+    }
+    std::string delSql = "DELETE FROM confirmed_txids WHERE height >= " + std::to_string(dirtyFrom) + ";";
+    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+    sqlite3_exec(db, delSql.c_str(), nullptr, nullptr, nullptr);
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO confirmed_txids (txid, height) VALUES (?, ?);", -1, &stmt, nullptr) == SQLITE_OK) {
+        for (size_t h = std::max(dirtyFrom, 0); h < state->chain.size(); ++h) {
+            for (const auto& tx : state->chain[h]->transactions) {
+                std::string txId = calculateTxId(tx);
+                sqlite3_bind_text(stmt, 1, txId.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_int(stmt, 2, (int)h);
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        // Blocks connected meanwhile stay dirty and keep their in-memory entries
+        if (txIndexDirtyFrom == dirtyFrom) {
+            txIndexDirtyFrom = (int)state->chain.size();
+            std::lock_guard<std::mutex> replayLock(replayMutex);
+            unsavedConfirmedTxIds.clear();
+        }
+    }
+    saveConsensusSettings();
+    saveThreadPlacement();
+    saveStakeSnapshots();
+    saveStakeEvents();
+    savePendingContents();
+    saveMempool();
+    exportMetrics();
+    return saveVerifiedWatermark();
+}
+
+bool Blockchain::loadFromDb() {
+    if (!db) return false;
+    std::lock_guard<std::mutex> lock(chainMutex);
+    chain.clear();
+    balances.edit().clear();
+    accountNonces.edit().clear();
+    // Stake state is rebuilt from the event log, interleaved with the blocks it followed
+    stakes.edit().clear();
+    delegatedStakes.edit().clear();
+    delegations.clear();
+    accRewardPerShare.clear();
+    delegatorPayouts.clear();
+    stakeIndex.clear();
+    delegateCommission = defaultDelegateCommission;
+    stakeEvents.clear();
+    std::vector<StakeEvent> logged = loadStakeEvents();
+    size_t nextEvent = 0;
+    const char* sql = "SELECT data FROM blocks ORDER BY id ASC;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "DB select error: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* data = sqlite3_column_text(stmt, 0);
+        if (data) {
+            nlohmann::json jblock = nlohmann::json::parse(reinterpret_cast<const char*>(data));
+            Block block;
+            block.index = jblock["index"];
+            block.prevHash = jblock["prevHash"];
+            block.hash = jblock["hash"];
+            block.merkleRoot = jblock.value("merkleRoot", "");
+            block.timestamp = jblock["timestamp"];
+            block.miner = jblock["miner"];
+            block.nonce = jblock["nonce"];
+            block.difficulty = jblock["difficulty"];
+            block.bits = jblock.value("bits", (uint32_t)0);
+            // Transactions
+            for (const auto& jtx : jblock["transactions"]) {
+                Transaction tx;
+                tx.sender = jtx["sender"];
+                tx.receiver = jtx["receiver"];
+                tx.amount = jtx["amount"];
+                tx.signature = jtx["signature"];
+                tx.publicKeyPem = jtx["publicKeyPem"];
+                tx.fee = jtx.value("fee", 0.0);
+                tx.nonce = jtx.value("nonce", (uint64_t)0);
+                block.transactions.push_back(tx);
+            }
+            // Contents
+            for (const auto& jc : jblock["contents"]) {
                 Content c;
                 c.type = jc["type"];
                 c.filename = jc["filename"];
@@ -534,10 +1994,86 @@ bool Blockchain::loadFromDb() {
                 c.publicKeyPem = jc["publicKeyPem"];
                 block.contents.push_back(c);
             }
-            chain.push_back(block);
+            appendBlock(std::move(block));
+            // Balances are derived state: replay every non-genesis block
+            if (chain.back()->index > 0) applyBlockState(*chain.back(), 1);
+            for (; nextEvent < logged.size() && logged[nextEvent].height <= chain.back()->index; ++nextEvent) {
+                recordStakeEvent(logged[nextEvent]);
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (chain.empty()) createGenesisBlock(); // fresh database
+    for (; nextEvent < logged.size(); ++nextEvent) recordStakeEvent(logged[nextEvent]);
+    stakeEventsDirtyFrom = stakeEvents.size();
+    // Everything just loaded is already in confirmed_txids
+    txIndexDirtyFrom = (int)chain.size();
+    {
+        std::lock_guard<std::mutex> replayLock(replayMutex);
+        unsavedConfirmedTxIds.clear();
+        loadReplayFilter();
+    }
+    publishSnapshot();
+    loadPendingContents();
+    loadMempool();
+    // Restore the verified watermark; isValidChain() re-checks that it still matches
+    verifiedHeight = 0;
+    verifiedHash.clear();
+    int finalizedHeight = 0;
+    std::string finalizedHash;
+    const char* metaSql = "SELECT key, value FROM chain_meta WHERE key IN ('verified_height', 'verified_hash', 'content_batch_size', "
+                          "'content_batch_window', 'consensus_mode', 'dpos_slot_seconds', 'dpos_max_producers', 'dpos_rounds_per_epoch', "
+                          "'finalized_height', 'finalized_hash', 'target_block_time', 'retarget_window', 'lwma_activation_height', 'mining_cpus', 'reserved_cpus');";
+    std::string miningCpus, reservedCpus;
+    int activationHeight = 0;
+    if (sqlite3_prepare_v2(db, metaSql, -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::string key = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            const unsigned char* value = sqlite3_column_text(stmt, 1);
+            if (!value) continue;
+            if (key == "verified_height") verifiedHeight = std::atoi(reinterpret_cast<const char*>(value));
+            else if (key == "verified_hash") verifiedHash = reinterpret_cast<const char*>(value);
+            else if (key == "content_batch_size") contentBatchSize = std::max(1, std::atoi(reinterpret_cast<const char*>(value)));
+            else if (key == "content_batch_window") contentBatchWindow = std::atoi(reinterpret_cast<const char*>(value));
+            else if (key == "consensus_mode") consensusMode = static_cast<ConsensusMode>(std::atoi(reinterpret_cast<const char*>(value)));
+            else if (key == "dpos_slot_seconds") dposSlotSeconds = std::max(1, std::atoi(reinterpret_cast<const char*>(value)));
+            else if (key == "dpos_max_producers") dposMaxProducers = std::max(1, std::atoi(reinterpret_cast<const char*>(value)));
+            else if (key == "dpos_rounds_per_epoch") dposRoundsPerEpoch = std::max(1, std::atoi(reinterpret_cast<const char*>(value)));
+            else if (key == "finalized_height") finalizedHeight = std::atoi(reinterpret_cast<const char*>(value));
+            else if (key == "finalized_hash") finalizedHash = reinterpret_cast<const char*>(value);
+            else if (key == "target_block_time") targetBlockTime = std::max(1, std::atoi(reinterpret_cast<const char*>(value)));
+            else if (key == "retarget_window") retargetWindow = std::max(2, std::atoi(reinterpret_cast<const char*>(value)));
+            else if (key == "lwma_activation_height") activationHeight = std::atoi(reinterpret_cast<const char*>(value));
+            else if (key == "mining_cpus") miningCpus = reinterpret_cast<const char*>(value);
+            else if (key == "reserved_cpus") reservedCpus = reinterpret_cast<const char*>(value);
+        }
+        sqlite3_finalize(stmt);
+    }
+    // A database from before LWMA records no activation height: it is the first block that
+    // carries a target, or the next one to be mined if none does yet
+    if (activationHeight < 1) {
+        activationHeight = (int)chain.size();
+        for (size_t h = 1; h < chain.size(); ++h) {
+            if (chain[h]->bits != 0) {
+                activationHeight = (int)h;
+                break;
+            }
+        }
+    }
+    lwmaActivationHeight = activationHeight;
+    // A placement naming CPUs that are gone (other host, tighter cgroup) is logged and left unpinned
+    if (!miningCpus.empty() || !reservedCpus.empty()) setThreadPlacement(miningCpus, reservedCpus);
+    // Finality only ever moves forward; a stored height beyond our chain is not ours
+    if (finalizedHeight > 0 && finalizedHeight < (int)chain.size() && chain[finalizedHeight]->hash == finalizedHash) {
+        finality.restoreFinalized(finalizedHeight, finalizedHash);
+        finalityEpoch = UINT64_MAX;
+        finalityBoundary.clear();
+        for (size_t h = finalizedHeight + 1; h < chain.size(); ++h) {
+            if (chain[h]->difficulty != 0) continue;
+            refreshFinalityVoters(epochOfSlot(slotAt(chain[h]->timestamp)), *chain[h - 1]);
+            finality.onBlock(chain[h]->hash, chain[h]->prevHash, chain[h]->index);
         }
     }
-    sqlite3_finalize(stmt);
     return true;
 }
 
@@ -576,125 +2112,578 @@ ConsensusMode Blockchain::getConsensusMode() const {
 }
 
 bool Blockchain::stake(const std::string& address, double amount) {
-    if (balances[address] < amount || amount <= 0) return false;
-    balances[address] -= amount;
-    stakes[address] += amount;
+    std::lock_guard<std::mutex> lock(chainMutex);
+    std::lock_guard<std::mutex> poolLock(mempoolMutex);
+    // Pending transactions keep their funding
+    if (getBalanceLocked(address) - mempool.pendingDebit(address) < amount || amount <= 0) return false;
+    recordStakeEvent({(int)chain.size() - 1, "stake", address, "", amount});
+    publishSnapshot();
     return true;
 }
 
 std::map<std::string, double> Blockchain::getStakes() const {
-    return stakes;
+    return *snapshot()->stakes;
 }
 
 bool Blockchain::delegateStake(const std::string& from, const std::string& to, double amount) {
-    if (balances[from] < amount || amount <= 0) return false;
-    balances[from] -= amount;
-    delegations[from][to] += amount;
-    delegatedStakes[to] += amount;
+    std::lock_guard<std::mutex> lock(chainMutex);
+    std::lock_guard<std::mutex> poolLock(mempoolMutex);
+    if (getBalanceLocked(from) - mempool.pendingDebit(from) < amount || amount <= 0) return false;
+    recordStakeEvent({(int)chain.size() - 1, "delegate", from, to, amount});
+    publishSnapshot();
     return true;
 }
 
+// Caller holds chainMutex
+void Blockchain::recordStakeEvent(const StakeEvent& event) {
+    stakeEvents.push_back(event);
+    applyStakeEvent(event);
+}
+
+// Caller holds chainMutex. Live operations and loadFromDb's replay both go through here.
+void Blockchain::applyStakeEvent(const StakeEvent& event) {
+    if (event.kind == "stake") {
+        balances.edit()[event.account] -= event.amount;
+        stakes.edit()[event.account] += event.amount;
+        stakeIndex.add(event.account, event.amount);
+    } else if (event.kind == "delegate") {
+        balances.edit()[event.account] -= event.amount;
+        // New stake starts at the current accumulator, so it earns nothing already paid in
+        auto acc = accRewardPerShare.find(event.delegate);
+        Delegation& delegation = delegations[event.account][event.delegate];
+        delegation.amount += event.amount;
+        delegation.rewardDebt += event.amount * (acc == accRewardPerShare.end() ? 0 : acc->second);
+        delegatedStakes.edit()[event.delegate] += event.amount;
+    } else if (event.kind == "claim") {
+        balances.edit()[event.account] += event.amount;
+        delegations[event.account][event.delegate].rewardDebt += event.amount;
+    } else if (event.kind == "commission") {
+        delegateCommission = event.amount;
+    }
+}
+
+// Caller holds chainMutex. Commission in force when the block at height was produced.
+double Blockchain::commissionAt(int height) const {
+    if (stakeEvents.empty() || stakeEvents.back().height < height) return delegateCommission;
+    for (auto event = stakeEvents.rbegin(); event != stakeEvents.rend(); ++event) {
+        if (event->kind == "commission" && event->height < height) return event->amount;
+    }
+    return defaultDelegateCommission;
+}
+
+// Caller holds chainMutex
+std::vector<int> Blockchain::rebaseStakeEvents(int forkParent, int height) {
+    std::vector<int> previous;
+    for (size_t i = stakeEvents.size(); i-- > 0 && stakeEvents[i].height > forkParent;) {
+        previous.push_back(stakeEvents[i].height);
+        stakeEvents[i].height = height;
+        stakeEventsDirtyFrom = std::min(stakeEventsDirtyFrom, i);
+    }
+    return previous;
+}
+
+// Caller holds chainMutex
+void Blockchain::restoreStakeEvents(const std::vector<int>& heights) {
+    for (size_t k = 0; k < heights.size(); ++k) stakeEvents[stakeEvents.size() - 1 - k].height = heights[k];
+}
+
+// Caller holds chainMutex. The log is in height order, so the live index answers for the
+// tip and anything after the last event; older parents replay the log prefix.
+std::string Blockchain::stakerAt(int parentHeight, const std::string& seed) const {
+    if (stakeEvents.empty() || stakeEvents.back().height <= parentHeight) return stakeIndex.selectSeeded(seed);
+    StakeIndex past;
+    for (const auto& event : stakeEvents) {
+        if (event.height > parentHeight) break;
+        if (event.kind == "stake") past.add(event.account, event.amount);
+    }
+    return past.selectSeeded(seed);
+}
+
+// Caller holds chainMutex. O(delegates of this delegator), independent of chain length.
+double Blockchain::pendingDelegatorRewards(const std::string& delegator) const {
+    auto it = delegations.find(delegator);
+    if (it == delegations.end()) return 0;
+    double pending = 0;
+    for (const auto& [delegate, delegation] : it->second) {
+        auto acc = accRewardPerShare.find(delegate);
+        double accrued = delegation.amount * (acc == accRewardPerShare.end() ? 0 : acc->second);
+        if (accrued > delegation.rewardDebt) pending += accrued - delegation.rewardDebt;
+    }
+    return pending;
+}
+
+double Blockchain::getBalance(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return getBalanceLocked(address);
+}
+
+double Blockchain::getPendingDelegatorRewards(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return pendingDelegatorRewards(address);
+}
+
+double Blockchain::claimDelegatorRewards(const std::string& delegator) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    auto it = delegations.find(delegator);
+    if (it == delegations.end()) return 0;
+    // Reward debts are per delegation, so each delegate's share is its own claim
+    std::vector<StakeEvent> claims;
+    for (const auto& [delegate, delegation] : it->second) {
+        auto acc = accRewardPerShare.find(delegate);
+        double owed = delegation.amount * (acc == accRewardPerShare.end() ? 0 : acc->second) - delegation.rewardDebt;
+        if (owed > 0) claims.push_back({(int)chain.size() - 1, "claim", delegator, delegate, owed});
+    }
+    double paid = 0;
+    for (const auto& claim : claims) {
+        recordStakeEvent(claim);
+        paid += claim.amount;
+    }
+    if (paid > 0) publishSnapshot();
+    return paid;
+}
+
+void Blockchain::setDelegateCommission(double commission) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    recordStakeEvent({(int)chain.size() - 1, "commission", "", "", std::min(std::max(commission, 0.0), 1.0)});
+}
+
 std::map<std::string, double> Blockchain::getDelegatedStakes() const {
-    return delegatedStakes;
+    return *snapshot()->delegatedStakes;
 }
 
 bool Blockchain::mineBlockPoS() {
+    // No nonce search here, so the whole (short) production step runs under the writer lock
+    std::lock_guard<std::mutex> chainLock(chainMutex);
+    std::lock_guard<std::mutex> poolLock(mempoolMutex);
     if (mempool.empty() && pendingContents.empty()) return false;
-    double totalStake = 0;
-    for (const auto& s : stakes) totalStake += s.second;
-    if (totalStake == 0) return false;
-    double r = ((double)rand() / RAND_MAX) * totalStake;
-    double acc = 0;
-    std::string selectedMiner;
-    for (const auto& s : stakes) {
-        acc += s.second;
-        if (acc >= r) {
-            selectedMiner = s.first;
-            break;
-        }
-    }
+    // Seeded by the parent hash so every node with the same stakes picks the same producer
+    std::string selectedMiner = stakerAt(chain.back()->index, chain.back()->hash);
     if (selectedMiner.empty()) return false;
-    Block newBlock;
-    newBlock.index = chain.size();
-    newBlock.prevHash = chain.back().hash;
+    BlockTemplatePtr tpl = buildBlockTemplate();
+    Block newBlock = tpl->block;
     newBlock.timestamp = std::time(nullptr);
-    newBlock.transactions = mempool;
-    newBlock.contents = pendingContents;
     newBlock.miner = selectedMiner;
-    newBlock.difficulty = 1;
+    newBlock.difficulty = 0; // no proof-of-work: validProof must not demand leading zeros
+    newBlock.bits = 0;
     newBlock.nonce = 0;
-    newBlock.merkleRoot = calculateMerkleRoot(newBlock.transactions);
-    newBlock.hash = calculateHash(newBlock);
-    if (!validateBlock(newBlock, chain.back())) {
+    newBlock.hash = hashBlockWithBody(newBlock, tpl->bodyData);
+    if (!validateBlock(newBlock, *chain.back())) {
         logError("Invalid PoS block mined, not adding to chain.");
         return false;
     }
-    chain.push_back(newBlock);
-    double reward = getBlockReward(newBlock.index);
-    double totalFees = 0;
-    for (const auto& tx : mempool) {
-        balances[tx.sender] -= (tx.amount + txFee);
-        balances[tx.receiver] += tx.amount;
-        totalFees += txFee;
-    }
-    balances[selectedMiner] += reward + totalFees;
-    mempool.clear();
-    pendingContents.clear();
+    appendBlock(newBlock);
+    applyBlockState(newBlock, 1);
+    removeIncludedFromPending(newBlock);
+    publishSnapshot();
     return true;
 }
 
-bool Blockchain::mineBlockDPoS() {
+bool Blockchain::mineBlockDPoS(const std::string& localDelegate) {
+    std::lock_guard<std::mutex> chainLock(chainMutex);
+    std::lock_guard<std::mutex> poolLock(mempoolMutex);
     if (mempool.empty() && pendingContents.empty()) return false;
-    // Select delegate weighted by delegated stake
-    double totalDelegated = 0;
-    for (const auto& d : delegatedStakes) totalDelegated += d.second;
-    if (totalDelegated == 0) return false;
-    double r = ((double)rand() / RAND_MAX) * totalDelegated;
-    double acc = 0;
-    std::string selectedDelegate;
-    for (const auto& d : delegatedStakes) {
-        acc += d.second;
-        if (acc >= r) {
-            selectedDelegate = d.first;
-            break;
-        }
-    }
+    // The slot owner comes from the precomputed epoch schedule; one block per slot
+    std::time_t now = std::time(nullptr);
+    uint64_t slot = slotAt(now);
+    if (chain.back()->index > 0 && slotAt(chain.back()->timestamp) >= slot) return false;
+    std::string selectedDelegate = producerForSlot(slot, *chain.back());
     if (selectedDelegate.empty()) return false;
-    Block newBlock;
-    newBlock.index = chain.size();
-    newBlock.prevHash = chain.back().hash;
-    newBlock.timestamp = std::time(nullptr);
-    newBlock.transactions = mempool;
-    newBlock.contents = pendingContents;
+    if (!localDelegate.empty() && localDelegate != selectedDelegate) return false;
+    BlockTemplatePtr tpl = buildBlockTemplate();
+    Block newBlock = tpl->block;
+    newBlock.timestamp = now;
     newBlock.miner = selectedDelegate;
-    newBlock.difficulty = 1;
+    newBlock.difficulty = 0; // no proof-of-work: validProof must not demand leading zeros
+    newBlock.bits = 0;
     newBlock.nonce = 0;
-    newBlock.merkleRoot = calculateMerkleRoot(newBlock.transactions);
-    newBlock.hash = calculateHash(newBlock);
-    if (!validateBlockBFT(newBlock)) {
-        logError("DPoS block did not pass BFT validation.");
+    newBlock.hash = hashBlockWithBody(newBlock, tpl->bodyData);
+    if (!validateBlock(newBlock, *chain.back())) {
+        logError("Invalid DPoS block produced (schedule or finality), not adding to chain.");
         return false;
     }
-    chain.push_back(newBlock);
+    appendBlock(newBlock);
     // Reward delegate with halved block reward and total transaction fees
-    double reward = getBlockReward(newBlock.index);
-    double totalFees = 0;
-    for (const auto& tx : mempool) {
-        balances[tx.sender] -= (tx.amount + txFee);
-        balances[tx.receiver] += tx.amount;
-        totalFees += txFee;
+    applyBlockState(newBlock, 1);
+    removeIncludedFromPending(newBlock);
+    publishSnapshot();
+    return true;
+}
+
+void Blockchain::setDPoSParams(int slotSeconds, size_t maxProducers, size_t roundsPerEpoch) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    dposSlotSeconds = std::max(slotSeconds, 1);
+    dposMaxProducers = std::max<size_t>(maxProducers, 1);
+    dposRoundsPerEpoch = std::max<size_t>(roundsPerEpoch, 1);
+    epochSchedules.clear();
+    // Epoch numbers change meaning with the slot layout, so earlier snapshots no longer apply
+    stakeSnapshots.clear();
+    unsavedSnapshots.clear();
+    if (db) sqlite3_exec(db, "DELETE FROM stake_snapshots;", nullptr, nullptr, nullptr);
+}
+
+uint64_t Blockchain::slotAt(std::time_t timestamp) const {
+    return timestamp > 0 ? (uint64_t)timestamp / dposSlotSeconds : 0;
+}
+
+uint64_t Blockchain::epochOfSlot(uint64_t slot) const {
+    return slot / slotsPerEpoch();
+}
+
+std::string Blockchain::getScheduledProducer(uint64_t slot) const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return producerForSlot(slot, *chain.back());
+}
+
+ProducerSchedule Blockchain::getProducerSchedule(uint64_t epoch) const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return scheduleForEpoch(epoch, *chain.back());
+}
+
+// O(1) once the epoch's schedule exists. Caller holds chainMutex.
+std::string Blockchain::producerForSlot(uint64_t slot, const Block& from, const std::vector<Block>* branch) const {
+    const ProducerSchedule& schedule = scheduleForEpoch(epochOfSlot(slot), from, branch);
+    return schedule.slots.empty() ? "" : schedule.slots[slot - schedule.firstSlot];
+}
+
+// Lays the epoch's stake snapshot out over its slots, shuffling the round order
+// with a seed derived from the genesis hash and epoch number, so all nodes derive
+// the same layout. Everything comes from the chain and the stake log, never the
+// local clock, so stored blocks re-check the same way on every node and restart.
+// Caller holds chainMutex.
+const ProducerSchedule& Blockchain::scheduleForEpoch(uint64_t epoch, const Block& from, const std::vector<Block>* branch) const {
+    const Block& boundary = epochBoundary(epoch, from, branch);
+    auto cached = epochSchedules.find(epoch);
+    if (cached != epochSchedules.end() && cached->second.boundaryHash == boundary.hash) return cached->second;
+    ProducerSchedule schedule;
+    schedule.epoch = epoch;
+    schedule.firstSlot = epoch * slotsPerEpoch();
+    schedule.boundaryHeight = boundary.index;
+    schedule.boundaryHash = boundary.hash;
+    StakeSnapshot snapshot = stakeSnapshotFor(epoch, boundary);
+    for (const auto& [delegate, amount] : snapshot.validators) {
+        schedule.producers.push_back(delegate);
+        schedule.producerStakes.push_back(amount);
     }
-    balances[selectedDelegate] += reward + totalFees;
-    mempool.clear();
-    pendingContents.clear();
+    schedule.totalStake = snapshot.totalStake;
+    size_t k = schedule.producers.size();
+    if (k > 0) {
+        std::vector<std::string> order = schedule.producers;
+        std::string seed = (chain.empty() ? "" : chain[0]->hash) + ":" + std::to_string(epoch);
+        for (size_t i = order.size() - 1; i > 0; --i) {
+            size_t j = (size_t)(StakeIndex::seedToUnit(seed + ":" + std::to_string(i)) * (i + 1));
+            std::swap(order[i], order[std::min(j, i)]);
+        }
+        schedule.slots.reserve(slotsPerEpoch());
+        for (size_t i = 0; i < slotsPerEpoch(); ++i) schedule.slots.push_back(order[i % order.size()]);
+    }
+    // Stake logged while the boundary is our tip still counts, so that set is a preview
+    if (!boundaryFixed(epoch, boundary)) {
+        previewSchedule = std::move(schedule);
+        return previewSchedule;
+    }
+    // Keep the previous epoch for blocks that straddle the boundary
+    while (!epochSchedules.empty() && epochSchedules.begin()->first + 1 < epoch) {
+        epochSchedules.erase(epochSchedules.begin());
+    }
+    return epochSchedules[epoch] = std::move(schedule);
+}
+
+// Slots never decrease along a chain, so the blocks before an epoch form a prefix:
+// candidate blocks are walked back to our chain, which is then binary searched.
+// Caller holds chainMutex.
+const Block& Blockchain::epochBoundary(uint64_t epoch, const Block& from, const std::vector<Block>* branch) const {
+    uint64_t firstSlot = epoch * slotsPerEpoch();
+    const Block* block = &from;
+    while (block->index >= (int)chain.size() || chain[block->index]->hash != block->hash) {
+        if (block->index == 0 || slotAt(block->timestamp) < firstSlot) return *block;
+        int parent = block->index - 1;
+        if (branch && !branch->empty() && parent >= branch->front().index) {
+            block = &(*branch)[parent - branch->front().index];
+        } else if (parent < (int)chain.size()) {
+            block = chain[parent].get();
+        } else {
+            return *chain[0];
+        }
+    }
+    if (slotAt(block->timestamp) < firstSlot) return *block;
+    // The cached schedule's boundary, if it still precedes an in-epoch block below from
+    auto cached = epochSchedules.find(epoch);
+    if (cached != epochSchedules.end()) {
+        int h = cached->second.boundaryHeight;
+        if (h < block->index && chain[h]->hash == cached->second.boundaryHash && slotAt(chain[h + 1]->timestamp) >= firstSlot) {
+            return *chain[h];
+        }
+    }
+    int lo = 0, hi = block->index; // first height whose slot is in the epoch or later
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (slotAt(chain[mid]->timestamp) < firstSlot) lo = mid + 1;
+        else hi = mid;
+    }
+    return *chain[lo > 0 ? lo - 1 : 0];
+}
+
+// Caller holds chainMutex. Stake events are logged at the tip's height, so once a
+// block sits on the boundary nothing can be added at or below it any more.
+bool Blockchain::boundaryFixed(uint64_t epoch, const Block& boundary) const {
+    size_t next = (size_t)boundary.index + 1;
+    return next < chain.size() && chain[boundary.index]->hash == boundary.hash &&
+           slotAt(chain[next]->timestamp) >= epoch * slotsPerEpoch();
+}
+
+// Caller holds chainMutex
+StakeSnapshot Blockchain::stakeSnapshotFor(uint64_t epoch, const Block& boundary) const {
+    auto matches = [&](const StakeSnapshot& snapshot) {
+        return snapshot.boundaryHeight == boundary.index && snapshot.boundaryHash == boundary.hash;
+    };
+    // Bounded cache: saved snapshots beyond the most recent 64 are reloaded on demand
+    auto remember = [&](const StakeSnapshot& snapshot) {
+        while (stakeSnapshots.size() >= 64 && !stakeSnapshots.count(epoch)) {
+            auto oldest = std::find_if(stakeSnapshots.begin(), stakeSnapshots.end(),
+                                       [this](const auto& entry) { return !unsavedSnapshots.count(entry.first); });
+            if (oldest == stakeSnapshots.end()) break;
+            stakeSnapshots.erase(oldest);
+        }
+        stakeSnapshots[epoch] = snapshot;
+    };
+    auto known = stakeSnapshots.find(epoch);
+    if (known != stakeSnapshots.end() && matches(known->second)) return known->second;
+    bool fixed = boundaryFixed(epoch, boundary);
+    StakeSnapshot snapshot;
+    if (fixed && known == stakeSnapshots.end() && loadStakeSnapshot(epoch, &snapshot) && matches(snapshot)) {
+        remember(snapshot);
+        return snapshot;
+    }
+    snapshot = StakeSnapshot();
+    snapshot.epoch = epoch;
+    snapshot.boundaryHeight = boundary.index;
+    snapshot.boundaryHash = boundary.hash;
+    // Delegated stake right after the boundary block: the live totals unless the log
+    // has entries above it, in which case its prefix is replayed
+    std::map<std::string, double> replayed;
+    const std::map<std::string, double>* delegated = &delegatedStakes.get();
+    if (!stakeEvents.empty() && stakeEvents.back().height > boundary.index) {
+        for (const auto& event : stakeEvents) {
+            if (event.height > boundary.index) break;
+            if (event.kind == "delegate") replayed[event.delegate] += event.amount;
+        }
+        delegated = &replayed;
+    }
+    // Top delegates by delegated stake, ties by address
+    std::vector<std::pair<double, std::string>> ranked;
+    for (const auto& [delegate, amount] : *delegated) {
+        if (amount > 0) ranked.emplace_back(amount, delegate);
+    }
+    size_t k = std::min(dposMaxProducers, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + k, ranked.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    for (size_t i = 0; i < k; ++i) {
+        snapshot.validators.emplace_back(ranked[i].second, ranked[i].first);
+        snapshot.totalStake += ranked[i].first;
+    }
+    if (fixed) {
+        remember(snapshot);
+        unsavedSnapshots.insert(epoch);
+    }
+    return snapshot;
+}
+
+bool Blockchain::loadStakeSnapshot(uint64_t epoch, StakeSnapshot* out) const {
+    if (!db) return false;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT total, data FROM stake_snapshots WHERE epoch = ?;", -1, &stmt, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)epoch);
+    bool found = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        try {
+            nlohmann::json data = nlohmann::json::parse(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+            // Rows without a boundary block predate chain-derived snapshots; they are re-derived
+            if (data.is_object()) {
+                out->epoch = epoch;
+                out->totalStake = sqlite3_column_double(stmt, 0);
+                out->boundaryHeight = data["boundaryHeight"];
+                out->boundaryHash = data["boundaryHash"];
+                out->validators.clear();
+                for (const auto& entry : data["validators"]) {
+                    out->validators.emplace_back(entry[0].get<std::string>(), entry[1].get<double>());
+                }
+                found = true;
+            }
+        } catch (...) {
+            std::cerr << "Corrupt stake snapshot for epoch " << epoch << std::endl;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Snapshots of fixed boundaries only change through a reorg below them, so only new
+// (or re-derived) ones are written
+bool Blockchain::saveStakeSnapshots() {
+    if (!db) return false;
+    std::vector<StakeSnapshot> pending;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        for (uint64_t epoch : unsavedSnapshots) pending.push_back(stakeSnapshots.at(epoch));
+        unsavedSnapshots.clear();
+    }
+    if (pending.empty()) return true;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO stake_snapshots (epoch, total, data) VALUES (?, ?, ?);", -1, &stmt, nullptr) != SQLITE_OK) {
+        logError(std::string("Failed to save stake snapshots: ") + sqlite3_errmsg(db));
+        return false;
+    }
+    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+    for (const auto& snapshot : pending) {
+        nlohmann::json validators = nlohmann::json::array();
+        for (const auto& [delegate, amount] : snapshot.validators) validators.push_back({delegate, amount});
+        nlohmann::json data = {{"boundaryHeight", snapshot.boundaryHeight}, {"boundaryHash", snapshot.boundaryHash}, {"validators", validators}};
+        std::string text = data.dump();
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)snapshot.epoch);
+        sqlite3_bind_double(stmt, 2, snapshot.totalStake);
+        sqlite3_bind_text(stmt, 3, text.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+std::vector<StakeEvent> Blockchain::loadStakeEvents() const {
+    std::vector<StakeEvent> events;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT height, kind, account, delegate, amount FROM stake_events ORDER BY seq ASC;", -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "DB select error: " << sqlite3_errmsg(db) << std::endl;
+        return events;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        StakeEvent event;
+        event.height = sqlite3_column_int(stmt, 0);
+        event.kind = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        event.account = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        event.delegate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        event.amount = sqlite3_column_double(stmt, 4);
+        events.push_back(event);
+    }
+    sqlite3_finalize(stmt);
+    return events;
+}
+
+// Rewrites the log from the first entry added or rebased since the last save
+bool Blockchain::saveStakeEvents() {
+    if (!db) return false;
+    std::vector<StakeEvent> pending;
+    size_t dirtyFrom;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        dirtyFrom = stakeEventsDirtyFrom;
+        pending.assign(stakeEvents.begin() + dirtyFrom, stakeEvents.end());
+        stakeEventsDirtyFrom = stakeEvents.size();
+    }
+    if (pending.empty()) return true;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO stake_events (seq, height, kind, account, delegate, amount) VALUES (?, ?, ?, ?, ?, ?);",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        logError(std::string("Failed to save stake events: ") + sqlite3_errmsg(db));
+        return false;
+    }
+    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const StakeEvent& event = pending[i];
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)(dirtyFrom + i));
+        sqlite3_bind_int(stmt, 2, event.height);
+        sqlite3_bind_text(stmt, 3, event.kind.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 4, event.account.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 5, event.delegate.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 6, event.amount);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool Blockchain::getStakeSnapshot(uint64_t epoch, StakeSnapshot* out) const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    const Block& boundary = epochBoundary(epoch, *chain.back(), nullptr);
+    if (!boundaryFixed(epoch, boundary)) return false;
+    *out = stakeSnapshotFor(epoch, boundary);
     return true;
 }
 
+bool Blockchain::verifyBlockProducer(int height, std::string* expected) const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    if (height <= 0 || height >= (int)chain.size()) return false;
+    const Block& block = *chain[height];
+    if (block.difficulty != 0) return true; // PoW blocks have no scheduled producer
+    std::string owner = consensusMode == ConsensusMode::PoS ? stakerAt(height - 1, chain[height - 1]->hash)
+                                                            : producerForSlot(slotAt(block.timestamp), *chain[height - 1]);
+    if (expected) *expected = owner;
+    return block.miner == owner;
+}
+
+// A finalized block can never be replaced, and the block after it must build on it.
+// Deeper descendants are covered by the prevHash chain back to that block.
 bool Blockchain::validateBlockBFT(const Block& block) const {
-    // BFT stub: always true for now, can be extended to require >2/3 delegate signatures
+    int finalizedHeight = finality.getFinalizedHeight();
+    if (finalizedHeight == 0) return true;
+    if (block.index <= finalizedHeight) return false;
+    if (block.index == finalizedHeight + 1 && block.prevHash != finality.getFinalizedHash()) return false;
     return true;
 }
 
+// Voting weight is each producer's delegated stake at the epoch boundary, the
+// same snapshot that drives the slot schedule. Caller holds chainMutex.
+void Blockchain::refreshFinalityVoters(uint64_t epoch, const Block& from) {
+    const ProducerSchedule& schedule = scheduleForEpoch(epoch, from);
+    if (epoch == finalityEpoch && schedule.boundaryHash == finalityBoundary) return;
+    std::map<std::string, double> voters;
+    for (size_t i = 0; i < schedule.producers.size(); ++i) voters[schedule.producers[i]] = schedule.producerStakes[i];
+    finality.setVoters(voters);
+    finalityEpoch = epoch;
+    finalityBoundary = schedule.boundaryHash;
+}
+
+size_t Blockchain::submitFinalityVotes(const std::vector<FinalityVote>& votes) {
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        if (consensusMode != ConsensusMode::DPoS) return 0;
+        refreshFinalityVoters(epochOfSlot(slotAt(chain.back()->timestamp)), *chain.back());
+    }
+    // Signature checks run without chainMutex so block application is never held up
+    int before = finality.getFinalizedHeight();
+    size_t counted = finality.addVotes(votes);
+    int after = finality.getFinalizedHeight();
+    if (after > before) {
+        logConsensusEvent("Finalized", "Height " + std::to_string(after) + " " + finality.getFinalizedHash());
+        emitMetric("finalized_height", after);
+    }
+    return counted;
+}
+
+void Blockchain::broadcastFinalityVotes(const std::vector<FinalityVote>& votes) {
+    nlohmann::json jmsg;
+    jmsg["type"] = "votes";
+    jmsg["votes"] = nlohmann::json::array();
+    for (const auto& vote : votes) {
+        jmsg["votes"].push_back({{"voter", vote.voter}, {"blockHash", vote.blockHash}, {"height", vote.height},
+                                 {"signature", vote.signature}, {"publicKeyPem", vote.publicKeyPem}});
+    }
+    std::lock_guard<std::mutex> lock(peersMutex);
+    for (const auto& peer : peers) sendEncrypted(peer, jmsg.dump());
+}
+
+int Blockchain::getFinalizedHeight() const {
+    return finality.getFinalizedHeight();
+}
+
+std::string Blockchain::getFinalizedHash() const {
+    return finality.getFinalizedHash();
+}
+
 // --- Peer Discovery & Automatic Peer Management ---
 void Blockchain::broadcastPeerList() {
     std::lock_guard<std::mutex> lock(peersMutex);
@@ -749,7 +2738,189 @@ std::set<std::string> Blockchain::getPeers() const {
     return peers;
 }
 
+// --- Gossip: relay to every peer except the one it came from ---
+void Blockchain::gossipTransaction(const Transaction& tx, const std::string& originPeer) {
+    std::string msg = txMessage(tx);
+    for (const auto& peer : getPeers()) {
+        if (peer != originPeer) sendEncrypted(peer, msg);
+    }
+}
+
+void Blockchain::gossipBlock(const Block& block) {
+    gossipBlock(block, "");
+}
+
+void Blockchain::gossipBlock(const Block& block, const std::string& originPeer) {
+    std::string msg = blockMessage(block);
+    for (const auto& peer : getPeers()) {
+        if (peer != originPeer) sendEncrypted(peer, msg);
+    }
+}
+
+void Blockchain::broadcastTransactionToPeer(const Transaction& tx, const std::string& host, int port) {
+    sendEncrypted(host + ":" + std::to_string(port), txMessage(tx));
+}
+
+void Blockchain::broadcastBlockToPeer(const Block& block, const std::string& host, int port) {
+    sendEncrypted(host + ":" + std::to_string(port), blockMessage(block));
+}
+
+// Introduces us with our height; the peer adds us back and fetches what it lacks
+void Blockchain::connectToPeerTCP(const std::string& host, int port) {
+    nlohmann::json jmsg;
+    jmsg["type"] = "hello";
+    jmsg["height"] = getHeight();
+    if (!localAddress.empty()) jmsg["from"] = localAddress;
+    sendEncrypted(host + ":" + std::to_string(port), jmsg.dump());
+}
+
+void Blockchain::addKnownPeer(const std::string& host, int port) {
+    {
+        std::lock_guard<std::mutex> lock(peersMutex);
+        knownPeers.insert({host, port});
+    }
+    if (!db) return;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO known_peers (host, port) VALUES (?, ?);", -1, &stmt, nullptr) != SQLITE_OK) {
+        logError(std::string("Failed to save known peer: ") + sqlite3_errmsg(db));
+        return;
+    }
+    sqlite3_bind_text(stmt, 1, host.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, port);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+}
+
+// Peers added by earlier runs (known_peers) plus this run's
+std::set<std::pair<std::string, int>> Blockchain::getKnownPeers() const {
+    std::set<std::pair<std::string, int>> result;
+    {
+        std::lock_guard<std::mutex> lock(peersMutex);
+        result = knownPeers;
+    }
+    sqlite3_stmt* stmt;
+    if (db && sqlite3_prepare_v2(db, "SELECT host, port FROM known_peers;", -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* host = sqlite3_column_text(stmt, 0);
+            if (host) result.insert({reinterpret_cast<const char*>(host), sqlite3_column_int(stmt, 1)});
+        }
+        sqlite3_finalize(stmt);
+    }
+    return result;
+}
+
+void Blockchain::connectToKnownPeers() {
+    for (const auto& [host, port] : getKnownPeers()) addPeer(host + ":" + std::to_string(port));
+}
+
+// --- P2P server ---
+bool Blockchain::startP2PServer(int port) {
+    if (p2pServerRunning) return false;
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        logError("P2P server: socket failed");
+        return false;
+    }
+    int yes = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 16) < 0) {
+        logError("P2P server: cannot listen on port " + std::to_string(port));
+        close(listenFd);
+        return false;
+    }
+    std::string certFile = "node_cert.pem", keyFile = "node_key.pem";
+    ensure_cert_key(certFile, keyFile);
+    try {
+        init_openssl_ctx(certFile, keyFile);
+    } catch (const std::exception& e) {
+        logError(std::string("P2P server: ") + e.what());
+        close(listenFd);
+        return false;
+    }
+    p2pServerRunning = true;
+    p2pHandlerThread = std::thread(&Blockchain::p2pHandlerLoop, this);
+    p2pServerThread = std::thread(&Blockchain::p2pServerLoop, this, listenFd);
+    std::cout << "[P2P] Listening on port " << port << std::endl;
+    return true;
+}
+
+void Blockchain::stopP2PServer() {
+    {
+        std::lock_guard<std::mutex> lock(p2pInboxMutex);
+        p2pServerRunning = false;
+    }
+    p2pInboxReady.notify_all();
+    if (p2pServerThread.joinable()) p2pServerThread.join();
+    if (p2pHandlerThread.joinable()) p2pHandlerThread.join();
+    std::lock_guard<std::mutex> lock(p2pInboxMutex);
+    p2pInbox.clear();
+}
+
+void Blockchain::p2pServerLoop(int listenFd) {
+    while (p2pServerRunning) {
+        pollfd pfd{listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        sockaddr_in from{};
+        socklen_t fromLen = sizeof(from);
+        int sock = accept(listenFd, (sockaddr*)&from, &fromLen);
+        if (sock < 0) continue;
+        // Bans and rate limits apply per host; the source port is ephemeral
+        char host[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, &from.sin_addr, host, sizeof(host));
+        if (isPeerBlocked(host)) {
+            close(sock);
+            continue;
+        }
+        timeval timeout{5, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        SSL* ssl = SSL_new(global_ssl_ctx);
+        SSL_set_fd(ssl, sock);
+        std::string msg;
+        bool complete = false;
+        if (SSL_accept(ssl) > 0) {
+            char buf[4096];
+            int n;
+            while ((n = SSL_read(ssl, buf, sizeof(buf))) > 0 && msg.size() <= kMaxPeerMessageBytes) msg.append(buf, n);
+            // The sender shuts the session down once its single message is written
+            complete = n <= 0 && SSL_get_error(ssl, n) == SSL_ERROR_ZERO_RETURN && msg.size() <= kMaxPeerMessageBytes;
+        }
+        SSL_free(ssl);
+        close(sock);
+        if (complete && !msg.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(p2pInboxMutex);
+                if (p2pInbox.size() >= maxP2PInbox) continue; // overloaded: shed the message
+                p2pInbox.emplace_back(std::move(msg), host);
+            }
+            p2pInboxReady.notify_one();
+        } else if (msg.size() > kMaxPeerMessageBytes) {
+            reportPeerMisbehavior(host);
+        }
+    }
+    close(listenFd);
+}
+
+void Blockchain::p2pHandlerLoop() {
+    for (;;) {
+        std::pair<std::string, std::string> next;
+        {
+            std::unique_lock<std::mutex> lock(p2pInboxMutex);
+            p2pInboxReady.wait(lock, [this] { return !p2pServerRunning || !p2pInbox.empty(); });
+            if (!p2pServerRunning) return;
+            next = std::move(p2pInbox.front());
+            p2pInbox.pop_front();
+        }
+        handleP2PMessage(next.first, next.second);
+    }
+}
+
 void Blockchain::handleP2PMessage(const std::string& msg, const std::string& peerAddress) {
+    if (isPeerBlocked(peerAddress)) return;
     // DDoS protection: check rate limit for this peer
     if (!checkPeerRateLimit(peerAddress)) {
         logError("Peer rate limit exceeded: " + peerAddress);
@@ -766,6 +2937,8 @@ void Blockchain::handleP2PMessage(const std::string& msg, const std::string& pee
             t.amount = j["amount"];
             t.signature = j["signature"];
             t.publicKeyPem = j["publicKeyPem"];
+            t.fee = j.value("fee", 0.0);
+            t.nonce = j.value("nonce", (uint64_t)0);
             if (addTransaction(t)) {
                 std::cout << "[P2P] Transaction added from peer." << std::endl;
                 // Relay transaction to other peers
@@ -783,6 +2956,7 @@ void Blockchain::handleP2PMessage(const std::string& msg, const std::string& pee
             block.miner = j["miner"];
             block.nonce = j["nonce"];
             block.difficulty = j["difficulty"];
+            block.bits = j.value("bits", (uint32_t)0);
             for (const auto& jtx : j["transactions"]) {
                 Transaction tx;
                 tx.sender = jtx["sender"];
@@ -790,6 +2964,8 @@ void Blockchain::handleP2PMessage(const std::string& msg, const std::string& pee
                 tx.amount = jtx["amount"];
                 tx.signature = jtx["signature"];
                 tx.publicKeyPem = jtx["publicKeyPem"];
+                tx.fee = jtx.value("fee", 0.0);
+                tx.nonce = jtx.value("nonce", (uint64_t)0);
                 block.transactions.push_back(tx);
             }
             for (const auto& jc : j["contents"]) {
@@ -802,14 +2978,53 @@ void Blockchain::handleP2PMessage(const std::string& msg, const std::string& pee
                 c.publicKeyPem = jc["publicKeyPem"];
                 block.contents.push_back(c);
             }
-            if (validateBlock(block, chain.back())) {
-                chain.push_back(block);
-                std::cout << "[P2P] Block added from peer." << std::endl;
-                // Relay block to other peers
-                gossipBlock(block, peerAddress);
+            std::vector<Block> connected;
+            bool orphaned = false;
+            {
+                std::lock_guard<std::mutex> chainLock(chainMutex);
+                std::time_t now = std::time(nullptr);
+                orphanBlocks.expire(now);
+                if (block.prevHash == chain.back()->hash) {
+                    connectBlockWithOrphans(block, &connected);
+                } else if (block.index > chain.back()->index) {
+                    // Parent not here yet (out-of-order gossip or sync): park it instead of dropping
+                    // it, but only once the checks that need no parent pass, so junk cannot fill the pool
+                    std::string reason;
+                    if (checkOrphanHeader(block, reason)) {
+                        orphaned = orphanBlocks.add(block, peerAddress, now);
+                    } else {
+                        logConsensusEvent("Orphan rejected", block.hash + ": " + reason);
+                    }
+                }
+            }
+            if (!connected.empty()) {
+                std::cout << "[P2P] " << connected.size() << " block(s) added from peer." << std::endl;
+                // Relay blocks to other peers
+                for (const auto& b : connected) gossipBlock(b, peerAddress);
+            } else if (orphaned) {
+                std::cout << "[P2P] Orphan block stored, requesting missing ancestors." << std::endl;
+                requestMissingBlocks(getHeight() + 1, peerAddress);
             } else {
                 std::cout << "[P2P] Invalid block from peer." << std::endl;
             }
+        } else if (j["type"] == "votes") {
+            // Votes arrive in batches so the whole batch is filtered and verified together
+            std::vector<FinalityVote> votes;
+            for (const auto& jv : j["votes"]) {
+                FinalityVote vote;
+                vote.voter = jv["voter"];
+                vote.blockHash = jv["blockHash"];
+                vote.height = jv["height"];
+                vote.signature = jv["signature"];
+                vote.publicKeyPem = jv["publicKeyPem"];
+                votes.push_back(vote);
+            }
+            size_t counted = submitFinalityVotes(votes);
+            if (counted > 0) {
+                std::cout << "[P2P] " << counted << " finality vote(s) counted." << std::endl;
+            } else if (!votes.empty()) {
+                std::cout << "[P2P] No new finality votes from peer." << std::endl;
+            }
         } else if (j["type"] == "peers") {
             // Merge received peers
             for (const auto& peer : j["peers"]) {
@@ -820,83 +3035,179 @@ void Blockchain::handleP2PMessage(const std::string& msg, const std::string& pee
             broadcastPeerList();
         } else if (j["type"] == "getblocks") {
             int fromIdx = j["fromIndex"];
-            handleGetBlocksRequest(fromIdx, peerAddress);
+            handleGetBlocksRequest(fromIdx, j.value("from", peerAddress));
+        } else if (j["type"] == "hello") {
+            // Connections are one message each, so replies go to the listening address it names
+            std::string from = j.value("from", "");
+            if (!from.empty()) {
+                addPeer(from);
+                onPeerConnected(from, j["height"]);
+            }
         }
     } catch (...) {
         std::cout << "[P2P] Failed to parse message." << std::endl;
     }
 }
 
+// Breadth-first over the orphan pool: every block that connects releases its children.
+// Siblings competing for the same parent connect first-come; the rest are dropped.
+void Blockchain::connectBlockWithOrphans(const Block& block, std::vector<Block>* connected) {
+    std::lock_guard<std::mutex> poolLock(mempoolMutex);
+    std::deque<Block> work{block};
+    while (!work.empty()) {
+        Block next = std::move(work.front());
+        work.pop_front();
+        if (next.prevHash != chain.back()->hash || !timestampAcceptable(next, std::time(nullptr)) ||
+            !validateBlock(next, *chain.back())) {
+            continue;
+        }
+        std::string reason;
+        if (!validateBlockTransactions(next, reason)) {
+            logConsensusEvent("Block rejected", next.hash + ": " + reason);
+            continue; // its orphaned children stay pooled until they expire
+        }
+        for (auto& child : orphanBlocks.takeChildren(next.hash)) work.push_back(std::move(child));
+        appendBlock(next);
+        applyBlockState(*chain.back(), 1);
+        removeIncludedFromPending(next);
+        connected->push_back(std::move(next));
+    }
+    if (!connected->empty()) publishSnapshot();
+}
+
+void Blockchain::setOrphanLimits(size_t maxCount, size_t maxBytes, int ttlSeconds) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    orphanBlocks.setLimits(maxCount, maxBytes, ttlSeconds);
+}
+
+size_t Blockchain::getOrphanCount() const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return orphanBlocks.size();
+}
+
 // --- Automatic Chain Sync: Fetch Missing Blocks from Peers ---
 void Blockchain::requestMissingBlocks(int fromIndex, const std::string& peerAddress) {
     nlohmann::json jmsg;
     jmsg["type"] = "getblocks";
     jmsg["fromIndex"] = fromIndex;
+    if (!localAddress.empty()) jmsg["from"] = localAddress; // where to send the blocks
     sendEncrypted(peerAddress, jmsg.dump());
 }
 
 // Respond to getblocks request
 void Blockchain::handleGetBlocksRequest(int fromIndex, const std::string& peerAddress) {
-    std::lock_guard<std::mutex> lock(chainMutex);
-    for (size_t i = fromIndex; i < chain.size(); ++i) {
-        gossipBlock(chain[i], peerAddress); // Send each missing block to requester
+    // Serve from a snapshot so slow peers never hold up block application
+    for (const auto& block : blocksInRange(fromIndex, getHeight())) {
+        sendEncrypted(peerAddress, blockMessage(*block)); // Send each missing block to requester
     }
 }
 
 // On peer connect, compare chain heights and request missing blocks
 void Blockchain::onPeerConnected(const std::string& peerAddress, int peerHeight) {
-    int ourHeight = chain.size() - 1;
+    int ourHeight = getHeight();
     if (peerHeight > ourHeight) {
         requestMissingBlocks(ourHeight + 1, peerAddress);
     }
 }
 
-// --- Fork Resolution: Longest Chain/BFT ---
+// --- Fork Resolution: Most Cumulative Work ---
+// candidateChain may be a full chain from genesis or a segment whose first block
+// extends one of our blocks; only blocks after the fork point are validated.
 bool Blockchain::resolveFork(const std::vector<Block>& candidateChain) {
     std::lock_guard<std::mutex> lock(chainMutex);
-    // 1. Validate candidate chain
-    if (candidateChain.empty() || candidateChain[0].index != 0) return false;
-    for (size_t i = 1; i < candidateChain.size(); ++i) {
-        if (candidateChain[i].prevHash != candidateChain[i-1].hash) return false;
-        if (candidateChain[i].hash != calculateHash(candidateChain[i])) return false;
-        if (!validProof(candidateChain[i])) return false;
-        if (candidateChain[i].timestamp < candidateChain[i-1].timestamp) return false;
+    if (candidateChain.empty() || chain.empty()) return false;
+    size_t firstIdx = candidateChain[0].index;
+    if (firstIdx == 0) {
+        if (candidateChain[0].hash != chain[0]->hash) return false; // different genesis
+    } else if (firstIdx > chain.size() || chain[firstIdx - 1]->hash != candidateChain[0].prevHash) {
+        return false; // parent unknown
     }
-    // 2. Compare chain length (or total work for PoW)
-    if (candidateChain.size() <= chain.size()) return false;
-    // 3. Replace chain and update state
-    chain = candidateChain;
-    // TODO: Rebuild balances, mempool, etc. as needed
-    logConsensusEvent("Fork resolved", "Chain replaced with longer chain");
-    return true;
-}
-
-// --- OpenSSL Context and Certificate Management ---
-namespace {
-SSL_CTX* global_ssl_ctx = nullptr;
-bool openssl_initialized = false;
-
-void init_openssl_ctx(const std::string& certFile, const std::string& keyFile) {
-    if (openssl_initialized) return;
-    SSL_load_error_strings();
-    OpenSSL_add_ssl_algorithms();
-    global_ssl_ctx = SSL_CTX_new(TLS_method());
-    if (!global_ssl_ctx) throw std::runtime_error("Failed to create SSL_CTX");
-    if (SSL_CTX_use_certificate_file(global_ssl_ctx, certFile.c_str(), SSL_FILETYPE_PEM) <= 0 ||
-        SSL_CTX_use_PrivateKey_file(global_ssl_ctx, keyFile.c_str(), SSL_FILETYPE_PEM) <= 0) {
-        throw std::runtime_error("Failed to load cert/key for TLS");
+    // 1. Skip the prefix we already have
+    size_t skip = 0;
+    while (skip < candidateChain.size() && firstIdx + skip < chain.size() &&
+           chain[firstIdx + skip]->hash == candidateChain[skip].hash) {
+        ++skip;
     }
-    openssl_initialized = true;
-}
-
-// For demo: generate self-signed cert if not found (not secure for mainnet!)
-void ensure_cert_key(const std::string& certFile, const std::string& keyFile) {
-    std::ifstream cert(certFile), key(keyFile);
-    if (cert && key) return;
-    cert.close(); key.close();
-    std::string cmd = "openssl req -x509 -newkey rsa:2048 -keyout " + keyFile + " -out " + certFile + " -days 365 -nodes -subj '/CN=AhmiyatNode'";
-    std::system(cmd.c_str());
-}
+    if (skip == candidateChain.size()) return false;
+    size_t forkHeight = firstIdx + skip;
+    if ((int)forkHeight <= finality.getFinalizedHeight()) {
+        logConsensusEvent("Fork rejected", "Reorg at height " + std::to_string(forkHeight) + " would revert finalized blocks");
+        return false;
+    }
+    // 2. Compare total work; tips carry cached chainwork so this needs no hashing
+    double candidateWork = chain[forkHeight - 1]->chainWork;
+    for (size_t i = skip; i < candidateChain.size(); ++i) candidateWork += blockWork(candidateChain[i]);
+    if (candidateWork <= chain.back()->chainWork) return false;
+    // 3. Validate only the new segment; targets are re-derived along the candidate branch.
+    // Stake events logged above the fork point belong to the branch being replaced: they
+    // move past the candidate's tip, so its producers are checked against the stake they
+    // saw and its reward pools leave them out.
+    int candidateTip = candidateChain.back().index;
+    std::vector<int> eventHeights = rebaseStakeEvents((int)forkHeight - 1, candidateTip);
+    const Block* prev = chain[forkHeight - 1].get();
+    std::vector<const Block*> history = retargetHistory(forkHeight - 1);
+    std::time_t now = std::time(nullptr);
+    bool valid = true;
+    for (size_t i = skip; valid && i < candidateChain.size(); ++i) {
+        const Block& block = candidateChain[i];
+        valid = block.index == prev->index + 1 && timestampAcceptable(block, now) && validateBlock(block, *prev, &candidateChain);
+        if (valid && block.difficulty != 0) {
+            // validateBlock only lets legacy blocks through below the activation height
+            if (block.bits != 0) valid = block.bits == lwmaNextBits(history, targetBlockTime, retargetWindow);
+            history.push_back(&block);
+            if (history.size() > retargetWindow + 1) history.erase(history.begin());
+        }
+        prev = &block;
+    }
+    restoreStakeEvents(eventHeights);
+    if (!valid) return false;
+    // 4. Replay the candidate's transactions on the fork-point state. Our blocks are
+    // reverted under the event heights they were applied with.
+    for (size_t h = chain.size() - 1; h >= forkHeight; --h) applyBlockState(*chain[h], -1);
+    eventHeights = rebaseStakeEvents((int)forkHeight - 1, candidateTip);
+    size_t applied = skip;
+    std::string reason;
+    while (applied < candidateChain.size() && validateBlockTransactions(candidateChain[applied], reason)) {
+        applyBlockState(candidateChain[applied++], 1);
+    }
+    if (applied < candidateChain.size()) {
+        for (size_t i = applied; i-- > skip;) applyBlockState(candidateChain[i], -1);
+        restoreStakeEvents(eventHeights);
+        for (size_t h = forkHeight; h < chain.size(); ++h) applyBlockState(*chain[h], 1);
+        logConsensusEvent("Fork rejected", "Block " + std::to_string(candidateChain[applied].index) + ": " + reason);
+        return false;
+    }
+    // 5. Swap in the candidate's blocks; their state is already applied
+    std::vector<Transaction> disconnected;
+    for (size_t h = forkHeight; h < chain.size(); ++h) {
+        disconnected.insert(disconnected.end(), chain[h]->transactions.begin(), chain[h]->transactions.end());
+    }
+    chain.resize(forkHeight);
+    for (size_t i = skip; i < candidateChain.size(); ++i) appendBlock(candidateChain[i]);
+    {
+        std::lock_guard<std::mutex> poolLock(mempoolMutex);
+        // Give disconnected transactions back to the pool in nonce order; the new
+        // branch's own transactions are then removed and every sender re-checked
+        std::sort(disconnected.begin(), disconnected.end(), [](const Transaction& a, const Transaction& b) {
+            return a.sender != b.sender ? a.sender < b.sender : a.nonce < b.nonce;
+        });
+        std::set<std::string> senders;
+        for (const auto& tx : disconnected) {
+            if (tx.nonce == 0) continue; // legacy transactions cannot be re-admitted
+            uint64_t confirmedNonce = accountNonces.get().count(tx.sender) ? accountNonces.get().at(tx.sender) : 0;
+            if (tx.nonce == mempool.nextNonce(tx.sender, confirmedNonce)) mempool.insert(tx, calculateTxId(tx));
+            senders.insert(tx.sender);
+        }
+        for (size_t i = skip; i < candidateChain.size(); ++i) removeIncludedFromPending(candidateChain[i]);
+        for (const auto& sender : senders) reconcileMempoolSender(sender);
+        publishSnapshot();
+    }
+    if (verifiedHeight >= (int)forkHeight) {
+        verifiedHeight = (int)forkHeight - 1;
+        verifiedHash = chain[verifiedHeight]->hash;
+    }
+    logConsensusEvent("Fork resolved", "Reorg at height " + std::to_string(forkHeight) + " to chain with more work");
+    return true;
 }
 
 // --- Peer Public Key Registry (in-memory for demo) ---
@@ -996,9 +3307,42 @@ void Blockchain::enableWALMode() {
 void Blockchain::exportMetrics() {
     // Example: print metrics to file (can be served via HTTP for Prometheus scrape)
     std::ofstream metrics("blockchain_metrics.prom");
-    metrics << "block_height " << (chain.size() - 1) << std::endl;
-    metrics << "peer_count " << peers.size() << std::endl;
-    metrics << "mempool_size " << mempool.size() << std::endl;
+    metrics << "block_height " << getHeight() << std::endl;
+    metrics << "state_version " << snapshot()->version << std::endl;
+    metrics << "state_publish_seconds_total " << publishNanos / 1e9 << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        metrics << "state_map_clones_total " << balances.cloneCount() + stakes.cloneCount() +
+                   delegatedStakes.cloneCount() + accountNonces.cloneCount() << std::endl;
+        metrics << "state_chain_copies_total " << chain.copyCount() << std::endl;
+    }
+    metrics << "peer_count " << getPeers().size() << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(mempoolMutex);
+        metrics << "mempool_size " << mempool.size() << std::endl;
+        metrics << "mempool_bytes " << mempool.bytes() << std::endl;
+        metrics << "mempool_evictions_total " << mempool.evictionCount() << std::endl;
+        metrics << "mempool_expired_total " << mempool.expiredCount() << std::endl;
+        metrics << "mempool_replacements_total " << mempool.replacementCount() << std::endl;
+        metrics << "pending_contents " << pendingContents.size() << std::endl;
+        metrics << "pending_content_bytes " << pendingContentBytes << std::endl;
+        metrics << "pending_content_expired_total " << pendingContentExpirations << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        metrics << "orphan_blocks " << orphanBlocks.size() << std::endl;
+        metrics << "orphan_bytes " << orphanBlocks.bytes() << std::endl;
+        metrics << "orphan_added_total " << orphanBlocks.addedCount() << std::endl;
+        metrics << "orphan_connected_total " << orphanBlocks.connectedCount() << std::endl;
+        metrics << "orphan_evicted_total " << orphanBlocks.evictionCount() << std::endl;
+        metrics << "orphan_expired_total " << orphanBlocks.expiredCount() << std::endl;
+        metrics << "orphan_peer_rejected_total " << orphanBlocks.peerRejectionCount() << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(replayMutex);
+        metrics << "replay_filter_bytes " << seenTxFilter.memoryUsage() << std::endl;
+        metrics << "unsaved_confirmed_txids " << unsavedConfirmedTxIds.size() << std::endl;
+    }
     // Add more metrics as needed
     metrics.close();
 }
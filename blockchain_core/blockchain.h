@@ -18,10 +18,21 @@
 #include "ecdsa_utils.h"
 #include "sqlite3.h" // Add SQLite include
 #include "base58.h"
+#include "bloom_filter.h"
+#include "stake_index.h"
+#include "finality.h"
+#include "uint256.h"
+#include "cpu_affinity.h"
 #include <set>
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <deque>
+#include <algorithm>
+#include <iterator>
+#include <condition_variable>
 
 struct Transaction {
     std::string sender; // address (hash of public key)
@@ -29,6 +40,8 @@ struct Transaction {
     double amount;
     std::string signature;
     std::string publicKeyPem; // sender's public key in PEM
+    double fee = 0; // paid to the block producer; 0 on legacy transactions (global fee applies)
+    uint64_t nonce = 0; // per-sender sequence starting at 1; 0 on legacy transactions
 };
 
 struct Content {
@@ -50,9 +63,129 @@ struct Block {
     std::time_t timestamp;
     std::string miner;
     int nonce;
-    int difficulty;
+    int difficulty;    // leading hex zeros; 0 marks a stake-produced block
+    uint32_t bits = 0; // compact 256-bit PoW target; 0 on legacy and stake blocks, hashed only when set
+    double chainWork = 0; // cumulative work up to and including this block (cached, not hashed)
 };
 
+// Blocks are immutable once appended; readers share them by reference count
+using BlockPtr = std::shared_ptr<const Block>;
+
+// Contents of the next block chosen from the pending pools, plus the pieces that
+// stay valid while a producer only varies the timestamp or nonce.
+struct BlockTemplate {
+    Block block;          // index, prevHash, difficulty, transactions, contents, merkleRoot
+    std::string bodyData; // serialized transactions + contents, as hashed by calculateHash
+    size_t txBytes = 0;
+    size_t contentBytes = 0;
+    // Cache key: the template is rebuilt only when one of these changes
+    uint64_t mempoolRevision = 0;
+    uint64_t contentsRevision = 0;
+};
+using BlockTemplatePtr = std::shared_ptr<const BlockTemplate>;
+
+// Writer-side state map shared with published snapshots. The first edit after a
+// publish clones it (O(entries)); a map no edit touched is published for free.
+template <typename Map>
+class CowMap {
+public:
+    CowMap() : data(std::make_shared<Map>()) {}
+    const Map& get() const { return *data; }
+    Map& edit() {
+        if (data.use_count() > 1) {
+            data = std::make_shared<Map>(*data);
+            ++clones;
+        }
+        return *data;
+    }
+    std::shared_ptr<const Map> share() const { return data; }
+    uint64_t cloneCount() const { return clones; }
+private:
+    std::shared_ptr<Map> data;
+    uint64_t clones = 0;
+};
+
+// Block pointer slots shared by the writer's BlockList and the views it hands out
+struct BlockStore {
+    explicit BlockStore(size_t capacity) : slots(new BlockPtr[capacity]), capacity(capacity) {}
+    std::unique_ptr<BlockPtr[]> slots;
+    size_t capacity;
+    size_t shared = 0; // slots [0, shared) may be visible to views; writer-only
+};
+
+// Read-only prefix of a BlockList: the shared store plus a length. Copying is O(1).
+class ChainView {
+public:
+    ChainView() = default;
+    ChainView(std::shared_ptr<const BlockStore> store, size_t length) : store(std::move(store)), length(length) {}
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const BlockPtr& operator[](size_t i) const { return store->slots[i]; }
+    const BlockPtr& back() const { return store->slots[length - 1]; }
+    const BlockPtr* begin() const { return store ? store->slots.get() : nullptr; }
+    const BlockPtr* end() const { return begin() + length; }
+    std::reverse_iterator<const BlockPtr*> rbegin() const { return std::reverse_iterator<const BlockPtr*>(end()); }
+    std::reverse_iterator<const BlockPtr*> rend() const { return std::reverse_iterator<const BlockPtr*>(begin()); }
+private:
+    std::shared_ptr<const BlockStore> store;
+    size_t length = 0;
+};
+
+// Writer-side chain. Appends write past every shared length in place, so share()
+// is O(1) however long the chain is; only outgrowing the capacity (amortized) or
+// appending below a shared length after a reorg truncation copies the pointers.
+class BlockList {
+public:
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const BlockPtr& operator[](size_t i) const { return store->slots[i]; }
+    const BlockPtr& back() const { return store->slots[length - 1]; }
+    void push_back(BlockPtr block) {
+        if (!store || length == store->capacity || length < store->shared) reallocate(std::max<size_t>(64, 2 * length));
+        store->slots[length++] = std::move(block);
+    }
+    // Truncates to n blocks; slots still visible to a view are left for it to read
+    void resize(size_t n) {
+        for (size_t i = std::max(n, store ? store->shared : 0); i < length; ++i) store->slots[i].reset();
+        length = std::min(n, length);
+    }
+    void clear() {
+        store.reset();
+        length = 0;
+    }
+    ChainView share() {
+        if (!store) return ChainView();
+        store->shared = std::max(store->shared, length);
+        return ChainView(store, length);
+    }
+    // Unshared view for use under the writer lock; do not keep it past the next edit
+    ChainView view() const { return ChainView(store, length); }
+    uint64_t copyCount() const { return copies; }
+private:
+    void reallocate(size_t capacity) {
+        auto next = std::make_shared<BlockStore>(capacity);
+        for (size_t i = 0; i < length; ++i) next->slots[i] = store->slots[i];
+        store = std::move(next);
+        ++copies;
+    }
+    std::shared_ptr<BlockStore> store;
+    size_t length = 0;
+    uint64_t copies = 0;
+};
+
+// Immutable, versioned view of consensus state. Writers build a new version
+// copy-on-write and swap it in atomically; readers never take the writer lock.
+struct ChainStateSnapshot {
+    uint64_t version = 0;
+    ChainView chain; // shares the writer's block store; publishing copies no pointers
+    // Shared with the writer until its next edit to each map
+    std::shared_ptr<const std::map<std::string, double>> balances;
+    std::shared_ptr<const std::map<std::string, double>> stakes;
+    std::shared_ptr<const std::map<std::string, double>> delegatedStakes;
+    std::shared_ptr<const std::map<std::string, uint64_t>> accountNonces; // highest confirmed nonce per sender
+};
+using StateSnapshotPtr = std::shared_ptr<const ChainStateSnapshot>;
+
 class Wallet {
 public:
     std::string address;
@@ -69,36 +202,399 @@ public:
     static std::string getLocalPublicKeyPem();
 };
 
-enum class ConsensusMode { PoW, PoS };
+enum class MempoolEvictionPolicy { LowestFeeRate, Oldest };
+enum class MempoolOrder { FeeRate, Newest };
+
+// Fee rates in [minFeeRate, maxFeeRate)
+struct FeeHistogramBucket {
+    double minFeeRate = 0;
+    double maxFeeRate = 0;
+    size_t count = 0;
+    size_t bytes = 0; // serialized
+};
+
+// Pending transactions indexed by txid, fee rate, arrival order and sender.
+// Insert/remove are O(log n); block templates walk the fee index best-first
+// and eviction drops the lowest fee rate (or oldest entry) without sorting the pool.
+// Memory is bounded by entry count, accounted bytes and a time-to-live.
+class Mempool {
+public:
+    struct Entry {
+        Transaction tx;
+        std::string txId;
+        size_t size;        // serialized bytes
+        size_t memoryUsage; // heap footprint of the entry across all indexes
+        double feeRate;     // fee per byte
+        std::time_t addedAt;
+        uint64_t sequence;  // arrival order, breaks fee-rate ties
+    };
+    // Fails on duplicates, a taken (sender, nonce) slot, or when full and tx cannot
+    // displace anything under the policy. Entries evicted to make room are appended to evicted.
+    bool insert(const Transaction& tx, const std::string& txId, std::vector<Transaction>* evicted = nullptr);
+    // insert() for an entry reloaded from disk, keeping its original age for the TTL
+    bool restore(const Transaction& tx, const std::string& txId, std::time_t addedAt);
+    bool remove(const std::string& txId);
+    // Swaps the entry holding (tx.sender, tx.nonce) for tx, keeping the sender's later
+    // nonces. Nothing changes if tx cannot be admitted.
+    bool replace(const Transaction& tx, const std::string& txId, Transaction* replaced = nullptr,
+                 std::vector<Transaction>* evicted = nullptr);
+    // Also drops the sender's later nonces, which could never be mined without this entry
+    size_t removeWithDescendants(const std::string& txId, std::vector<Transaction>* removed = nullptr);
+    bool contains(const std::string& txId) const;
+    const Entry* find(const std::string& txId) const;
+    const Entry* findBySenderNonce(const std::string& sender, uint64_t nonce) const;
+    std::vector<const Entry*> bestFirst(size_t maxCount) const;
+    // Best fee rate first, but never ahead of a lower nonce from the same sender.
+    // Entries that would overflow maxBytes are skipped (along with their later nonces).
+    std::vector<const Entry*> selectForBlock(size_t maxCount, size_t maxBytes = SIZE_MAX) const;
+    std::vector<const Entry*> bySender(const std::string& sender) const; // nonce order
+    // One page of the fee or arrival index; walks offset + limit entries, copies nothing
+    std::vector<const Entry*> page(MempoolOrder order, size_t offset, size_t limit) const;
+    // Log-scale fee-rate buckets from the lowest rate up, each bucketRatio x wider; the last is open-ended
+    std::vector<FeeHistogramBucket> feeHistogram(double bucketRatio, size_t maxBuckets) const;
+    double minFeeRate() const { return byFeeRate.empty() ? 0 : byFeeRate.rbegin()->feeRate; }
+    double maxFeeRate() const { return byFeeRate.empty() ? 0 : byFeeRate.begin()->feeRate; }
+    // O(1) per-sender admission state
+    double pendingDebit(const std::string& sender) const;
+    uint64_t nextNonce(const std::string& sender, uint64_t confirmedNonce) const;
+    bool evictLowest(std::vector<Transaction>* evicted = nullptr);
+    bool evictOldest(std::vector<Transaction>* evicted = nullptr);
+    // Drops entries older than the TTL; returns how many were removed
+    size_t expire(std::time_t now, std::vector<Transaction>* expired = nullptr);
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    size_t bytes() const { return totalMemory; }
+    size_t txBytes() const { return totalSize; }
+    uint64_t evictionCount() const { return evictions; }
+    uint64_t expiredCount() const { return expirations; }
+    uint64_t replacementCount() const { return replacements; }
+    uint64_t getRevision() const { return revision; } // bumped on every insert/remove
+    void clear();
+    void setLimits(size_t count, size_t bytes, int ttlSeconds);
+    void setEvictionPolicy(MempoolEvictionPolicy policy) { evictionPolicy = policy; }
+    size_t getMaxCount() const { return maxCount; }
+    size_t getMaxBytes() const { return maxBytes; }
+    int getTtl() const { return ttl; }
+    static size_t txSize(const Transaction& tx);
+private:
+    struct FeeKey {
+        double feeRate;
+        uint64_t sequence;
+        std::string txId;
+        bool operator<(const FeeKey& o) const {
+            if (feeRate != o.feeRate) return feeRate > o.feeRate; // highest fee rate first
+            return sequence < o.sequence;
+        }
+    };
+    static size_t entryMemoryUsage(const Entry& entry);
+    Entry makeEntry(const Transaction& tx, const std::string& txId);
+    bool planEviction(const Entry& incoming, const std::string& replacing, std::vector<std::string>& victims) const;
+    void evictAll(const std::vector<std::string>& victims, std::vector<Transaction>* evicted);
+    void link(Entry entry);
+    void eraseEntry(const Entry& entry);
+    std::unordered_map<std::string, Entry> entries; // txid -> entry
+    std::set<FeeKey> byFeeRate;
+    std::map<uint64_t, std::string> byArrival; // sequence -> txid
+    std::unordered_map<std::string, std::map<uint64_t, std::string>> senderIndex; // sender -> nonce -> txid
+    std::unordered_map<std::string, double> pendingDebits; // sender -> sum of amount + fee
+    size_t maxCount = 5000;
+    size_t maxBytes = 32 * 1024 * 1024;
+    int ttl = 24 * 60 * 60;
+    MempoolEvictionPolicy evictionPolicy = MempoolEvictionPolicy::LowestFeeRate;
+    size_t totalMemory = 0;
+    size_t totalSize = 0;
+    uint64_t evictions = 0;
+    uint64_t expirations = 0;
+    uint64_t replacements = 0;
+    uint64_t nextSequence = 0;
+    uint64_t revision = 0;
+};
+
+// Blocks received before their parent, indexed by hash and by prevHash so a
+// newly connected block finds its waiting children in O(1). Bounded by count,
+// accounted bytes and a time-to-live; the oldest orphan is evicted first. Each
+// peer holds at most a fixed share, so one sender cannot flush everyone else's.
+class OrphanBlockPool {
+public:
+    struct Entry {
+        Block block;
+        std::string peer; // sender, asked again for the missing ancestors
+        size_t size;      // accounted bytes
+        std::time_t receivedAt;
+        uint64_t sequence;
+    };
+    // Fails on duplicates, on blocks larger than the whole pool and once the peer holds its share
+    bool add(const Block& block, const std::string& peer, std::time_t now);
+    // Removes and returns the orphans whose parent is prevHash, in arrival order
+    std::vector<Block> takeChildren(const std::string& prevHash);
+    bool contains(const std::string& hash) const { return byHash.count(hash) > 0; }
+    size_t expire(std::time_t now);
+    size_t size() const { return byHash.size(); }
+    size_t bytes() const { return totalBytes; }
+    uint64_t addedCount() const { return added; }
+    uint64_t connectedCount() const { return connected; }
+    uint64_t evictionCount() const { return evictions; }
+    uint64_t expiredCount() const { return expirations; }
+    void setLimits(size_t count, size_t bytes, int ttlSeconds);
+    void setPeerLimit(size_t count) { maxPerPeer = count; }
+    uint64_t peerRejectionCount() const { return peerRejections; }
+    static size_t blockSize(const Block& block);
+private:
+    void erase(const std::string& hash);
+    std::unordered_map<std::string, size_t> perPeer; // peer -> orphans it sent that are still pooled
+    std::unordered_map<std::string, Entry> byHash;
+    std::unordered_multimap<std::string, std::string> byPrevHash; // prevHash -> hash
+    std::map<uint64_t, std::string> byArrival;                     // sequence -> hash
+    size_t maxCount = 100;
+    size_t maxBytes = 16 * 1024 * 1024;
+    int ttl = 20 * 60;
+    size_t maxPerPeer = 25;
+    size_t totalBytes = 0;
+    uint64_t added = 0;
+    uint64_t peerRejections = 0;
+    uint64_t connected = 0;
+    uint64_t evictions = 0;
+    uint64_t expirations = 0;
+    uint64_t nextSequence = 0;
+};
+
+enum class ConsensusMode { PoW, PoS, DPoS };
+
+// One delegator's stake with a delegate. Claimable reward is
+// amount * accRewardPerShare(delegate) - rewardDebt.
+struct Delegation {
+    double amount = 0;
+    double rewardDebt = 0;
+};
+
+// Ledger operation outside blocks, logged (stake_events) with the chain height it
+// follows so a reload replays it between the same blocks
+struct StakeEvent {
+    int height = 0;
+    std::string kind; // "stake", "delegate", "claim" or "commission"
+    std::string account; // staker, delegator or claimant
+    std::string delegate;
+    double amount = 0; // coins, or the new commission rate
+};
+
+// DPoS producer schedule for one epoch: the top delegates by delegated stake at
+// the epoch boundary, laid out over the epoch's slots so slot -> producer is O(1)
+struct ProducerSchedule {
+    uint64_t epoch = 0;
+    uint64_t firstSlot = 0;
+    int boundaryHeight = 0;
+    std::string boundaryHash; // block whose stake it was built from
+    std::vector<std::string> producers; // top-K, highest stake first
+    std::vector<std::string> slots;     // producer for firstSlot + i
+    std::vector<double> producerStakes; // delegated stake of producers[i], the epoch's voting weight
+    double totalStake = 0;
+};
+
+// Validator set of one DPoS epoch: the top delegates by delegated stake as of the
+// epoch's boundary block, the last block before its first slot. Fixed once a block
+// of the epoch builds on that boundary, then persisted in stake_snapshots.
+struct StakeSnapshot {
+    uint64_t epoch = 0;
+    int boundaryHeight = 0;
+    std::string boundaryHash;
+    double totalStake = 0; // voting weight of the whole set
+    std::vector<std::pair<std::string, double>> validators; // top delegates, highest stake first
+};
+
+// Result of a multi-threaded full-chain audit
+struct ChainVerifyReport {
+    bool valid = true;
+    int firstInvalidHeight = -1;
+    std::string reason;
+    size_t blocksChecked = 0;
+    size_t txsChecked = 0;
+    unsigned threads = 1;
+    double seconds = 0;
+};
+
+// Summary of both pending pools
+struct MempoolStats {
+    size_t count = 0;
+    size_t bytes = 0;   // accounted memory
+    size_t txBytes = 0; // serialized transactions
+    double minFeeRate = 0;
+    double maxFeeRate = 0;
+    std::vector<FeeHistogramBucket> feeHistogram;
+    size_t pendingContents = 0;
+    size_t pendingContentBytes = 0;
+};
+
+// Where an uploaded content entry is: waiting in the pending batch or sealed in a block
+struct ContentStatus {
+    bool found = false;
+    bool confirmed = false;
+    int height = -1;         // block containing it, once confirmed
+    int confirmations = 0;
+    size_t pendingPosition = 0; // position in the pending batch otherwise
+    size_t pendingCount = 0;
+};
+
+// Counters of the background block producer
+struct BlockProducerStats {
+    bool running = false;
+    uint64_t blocks = 0;           // blocks this producer sealed
+    uint64_t templateRefreshes = 0; // PoW searches restarted on a newer template
+    uint64_t staleBlocks = 0;       // PoW solutions that lost the race to a peer block
+    std::time_t lastBlockAt = 0;
+};
+
+// Cumulative time addTransaction spent per stage since the last reset
+struct AdmissionTimings {
+    uint64_t calls = 0;
+    uint64_t txIdNs = 0;
+    uint64_t addressNs = 0;
+    uint64_t verifyNs = 0;
+    uint64_t admitNs = 0; // snapshot read, pool checks and insert
+};
 
 class Blockchain {
 public:
-    Blockchain();
+    explicit Blockchain(const std::string& dbPath = "ahmiyat.db");
     ~Blockchain();
     bool addTransaction(const Transaction& tx);
     bool addContent(const Content& content, const std::string& miner);
     bool mineBlock(const std::string& miner);
     bool mineBlockPoS();
+    // --- Block producer loop ---
+    // Background thread producing blocks without being prompted: in PoS/DPoS it
+    // seals whatever is pending at every slot boundary (DPoS: only producer's own
+    // slots); in PoW it mines continuously as producer, restarting the nonce search
+    // whenever the tip or the pending pools change.
+    bool startBlockProducer(const std::string& producer);
+    void stopBlockProducer();
+    BlockProducerStats getBlockProducerStats() const;
+    // --- Thread placement ---
+    // CPU lists ("0-3,8", empty = unset) for mining workers and for the network and
+    // validation threads; kept in chain_meta since they describe this node's host
+    bool setThreadPlacement(const std::string& miningCpus, const std::string& reservedCpus);
+    ThreadPlacement getThreadPlacement() const;
     void setConsensusMode(ConsensusMode mode);
     ConsensusMode getConsensusMode() const;
+    // --- DPoS slot schedule ---
+    // Time is divided into slots of slotSeconds; every epoch of maxProducers * rounds
+    // slots is served round-robin by the top maxProducers delegates
+    void setDPoSParams(int slotSeconds, size_t maxProducers, size_t roundsPerEpoch);
+    uint64_t slotAt(std::time_t timestamp) const;
+    uint64_t epochOfSlot(uint64_t slot) const;
+    std::string getScheduledProducer(uint64_t slot) const;
+    ProducerSchedule getProducerSchedule(uint64_t epoch) const;
+    // Fixed snapshots only, derived from our chain if not stored; false while the
+    // epoch's boundary block is still our tip (or not reached yet)
+    bool getStakeSnapshot(uint64_t epoch, StakeSnapshot* out) const;
+    // Checks a stored stake block's producer (PoS: stake as of its parent, DPoS: its epoch's
+    // snapshot); expected gets the eligible producer
+    bool verifyBlockProducer(int height, std::string* expected = nullptr) const;
     bool stake(const std::string& address, double amount);
     std::map<std::string, double> getStakes() const;
     std::vector<Block> getChain() const;
+    // Consistent point-in-time view for queries; stays valid while new blocks are published
+    StateSnapshotPtr snapshot() const;
+    // Zero-copy read access: returned blocks stay valid while the chain grows
+    BlockPtr blockAt(int height) const;
+    std::vector<BlockPtr> blocksInRange(int from, int to) const;
+    BlockPtr tip() const;
+    int getHeight() const;
+    double getChainWork() const;
+    static double blockWork(const Block& block);
+    // --- Difficulty retargeting ---
+    // Every PoW block's target comes from a linearly weighted moving average of the
+    // last `window` solve times, recent blocks weighing most. The parameters are pinned
+    // once a stored block carries a target derived from them; false after that.
+    bool setRetargetParams(int targetSeconds, size_t window);
+    int getTargetBlockTime() const;
+    size_t getRetargetWindow() const;
+    // Compact target the next PoW block on the current tip must carry
+    uint32_t getNextBits() const;
+    // history: PoW blocks oldest first, ending with the new block's parent
+    static uint32_t lwmaNextBits(const std::vector<const Block*>& history, int targetSeconds, size_t window);
+    static Uint256 blockTarget(const Block& block);
+    static Uint256 powLimit();
     std::map<std::string, double> getBalances() const;
-    bool isValidChain() const;
+    // Checks the blocks above the verified watermark and advances it (persisted) on success
+    bool isValidChain();
+    // Full audit from genesis (full=true) or incremental check above the verified watermark
+    bool verifyChain(bool full);
+    int getVerifiedHeight() const;
+    // Full audit spread over a worker pool on the reserved cores, if any
+    // (threads = 0 uses all of them, or all cores without a reservation)
+    ChainVerifyReport verifyChainParallel(unsigned threads = 0);
     bool saveToDb();
     bool loadFromDb();
     std::vector<Transaction> getMempool() const;
+    AdmissionTimings getAdmissionTimings() const;
+    void resetAdmissionTimings();
+    // Seeds a balance outside consensus; for local benchmarks and simulations only
+    void creditBalance(const std::string& address, double amount);
+    // --- Mempool queries (copy only the requested entries) ---
+    MempoolStats getMempoolStats() const;
+    std::vector<Mempool::Entry> queryMempool(MempoolOrder order, size_t offset, size_t limit) const;
+    bool findMempoolTx(const std::string& txId, Mempool::Entry* out) const;
+    std::vector<Mempool::Entry> getMempoolBySender(const std::string& sender) const;
+    std::vector<Content> getPendingContents(size_t offset, size_t limit) const;
+    // --- Pending-pool memory bounds ---
+    void setMempoolLimits(size_t maxCount, size_t maxBytes, int ttlSeconds);
+    void setMempoolEvictionPolicy(MempoolEvictionPolicy policy);
+    void setPendingContentLimits(size_t maxCount, size_t maxBytes, int ttlSeconds);
+    // Replace-by-fee: a replacement must pay at least ratio x the old fee and at least txFee more
+    void setReplacementFeeRatio(double ratio);
+    void setOrphanLimits(size_t maxCount, size_t maxBytes, int ttlSeconds);
+    size_t getOrphanCount() const;
+    // --- Block template limits ---
+    void setBlockLimits(size_t maxBytes, size_t maxTxs, size_t maxContents);
+    BlockTemplatePtr getBlockTemplate();
+    // True once the tip or either pending pool has moved past the template
+    bool templateStale(const BlockTemplate& tpl) const;
+    // Block hash = SHA256(prefix + decimal nonce + suffix), so external miners can
+    // vary the nonce without re-serializing the header or body
+    static std::string headerPrefix(const Block& block);
+    static std::string headerSuffix(const Block& block, const std::string& bodyData);
+    // Full hash of a block, body serialization included (the validation path)
+    std::string calculateHash(const Block& block) const;
+    // Connects a PoW block solved outside this process (e.g. by a work-server miner)
+    bool submitBlock(const Block& block);
+    // --- Content batching ---
+    // Uploads queue in pendingContents and are sealed together once batchSize entries
+    // are waiting or the oldest has waited windowSeconds (0 disables the window).
+    void setContentBatching(size_t batchSize, int windowSeconds);
+    size_t getContentBatchSize() const;
+    int getContentBatchWindow() const;
+    bool contentBatchDue() const;
+    // Mines one block if the batch is due (or force is set); false when nothing was sealed
+    bool sealContentBatch(const std::string& miner, bool force = false);
+    ContentStatus getContentStatus(const std::string& hash) const;
     bool delegateStake(const std::string& from, const std::string& to, double amount);
-    bool mineBlockDPoS();
+    // Produces the current slot's block; with localDelegate set, only if that delegate owns the slot
+    bool mineBlockDPoS(const std::string& localDelegate = "");
+    // Rejects DPoS blocks that would rewrite or bypass the finalized block
     bool validateBlockBFT(const Block& block) const;
+    // --- BFT finality (DPoS) ---
+    // Counts delegate votes (signed with FinalityGadget::signVote) against the
+    // current epoch's producers; returns the number accepted
+    size_t submitFinalityVotes(const std::vector<FinalityVote>& votes);
+    void broadcastFinalityVotes(const std::vector<FinalityVote>& votes);
+    int getFinalizedHeight() const;
+    std::string getFinalizedHash() const;
     void setTxFee(double fee);
     double getTxFee() const;
     void setHalvingInterval(int interval);
     int getHalvingInterval() const;
     double getBlockReward(int blockIndex) const;
     std::map<std::string, double> getDelegatedStakes() const;
+    double getBalance(const std::string& address) const;
+    double getPendingDelegatorRewards(const std::string& address) const;
+    // Moves the delegator's accrued rewards into its balance; returns the amount paid
+    double claimDelegatorRewards(const std::string& delegator);
+    void setDelegateCommission(double commission);
+    // Nonce the sender's next transaction must carry (confirmed + pending)
+    uint64_t getNextNonce(const std::string& address) const;
     std::string calculateMerkleRoot(const std::vector<Transaction>& transactions) const;
+    // Data covered by a transaction signature
+    static std::string txSigningData(const Transaction& tx);
     // --- Peer-to-Peer Networking Stubs ---
 public:
     void connectToPeer(const std::string& peerAddress);
@@ -131,7 +627,7 @@ public:
     // --- Monitoring/Observability Hook ---
     void emitMetric(const std::string& metric, double value);
     // P2P networking (basic TCP server/client)
-    void startP2PServer(int port);
+    bool startP2PServer(int port); // false if already running or the port cannot be bound
     void stopP2PServer();
     void connectToPeerTCP(const std::string& host, int port);
     void broadcastTransactionToPeer(const Transaction& tx, const std::string& host, int port);
@@ -145,33 +641,178 @@ public:
     void handleGetBlocksRequest(int fromIndex, const std::string& peerAddress);
     void onPeerConnected(const std::string& peerAddress, int peerHeight);
 private:
-    void handleP2PMessage(const std::string& msg, const std::string& peerAddress);
-    std::vector<Block> chain;
-    std::vector<Transaction> mempool;
+    BlockList chain;
+    Mempool mempool;
+    OrphanBlockPool orphanBlocks; // guarded by chainMutex
+    // Connects block and, recursively, the orphans waiting on it. Caller holds chainMutex.
+    void connectBlockWithOrphans(const Block& block, std::vector<Block>* connected);
+    // Clock-dependent checks for a block received now; never applied to stored blocks
+    bool timestampAcceptable(const Block& block, std::time_t now) const;
+    // Parent-independent checks run before a block is parked as an orphan. Caller holds chainMutex.
+    bool checkOrphanHeader(const Block& block, std::string& reason) const;
+    static constexpr unsigned orphanTargetSlackBits = 4; // orphan targets may be up to 16x easier than our next one
+    // Signatures, nonces and funding of a block extending the current state. Caller holds chainMutex.
+    bool validateBlockTransactions(const Block& block, std::string& reason) const;
     std::vector<Content> pendingContents;
-    std::map<std::string, double> balances;
+    std::vector<std::time_t> pendingContentArrivals; // local admission time of each pendingContents entry
+    CowMap<std::map<std::string, double>> balances;
+    CowMap<std::map<std::string, uint64_t>> accountNonces;
     int difficulty = 3;
     int targetBlockTime = 30; // seconds
-    int adjustmentInterval = 5; // adjust every 5 blocks
+    size_t retargetWindow = 45; // LWMA window, in PoW blocks
+    // PoW blocks below this height predate LWMA and may carry no bits; they are held to the
+    // leading-zero rule alone. Persisted in chain_meta, derived from the chain on upgrade.
+    int lwmaActivationHeight = 1;
+    // Up to retargetWindow + 1 PoW blocks ending at height parentHeight, oldest first. Caller holds chainMutex.
+    std::vector<const Block*> retargetHistory(int parentHeight) const;
+    static std::vector<const Block*> retargetHistory(const ChainView& blocks, int parentHeight, size_t window);
     ConsensusMode consensusMode = ConsensusMode::PoW;
-    std::map<std::string, double> stakes;
-    std::map<std::string, double> delegatedStakes; // delegate address -> total delegated
-    std::map<std::string, std::map<std::string, double>> delegations; // delegator -> (delegate -> amount)
+    CowMap<std::map<std::string, double>> stakes;
+    CowMap<std::map<std::string, double>> delegatedStakes; // delegate address -> total delegated
+    std::map<std::string, std::map<std::string, Delegation>> delegations; // delegator -> (delegate -> stake)
+    // --- Lazy delegator rewards ---
+    // Stake-produced blocks add the delegators' share to the producer's accumulator
+    // (O(1) per block); delegators are paid when they claim.
+    static constexpr double defaultDelegateCommission = 0.10;
+    double delegateCommission = defaultDelegateCommission; // producer's cut before the delegators' share
+    std::unordered_map<std::string, double> accRewardPerShare; // delegate -> cumulative reward per delegated coin
+    struct DelegatorPayout {
+        double perShare;
+        double total;
+    };
+    std::unordered_map<std::string, DelegatorPayout> delegatorPayouts; // block hash -> payout, for exact reverts
+    double pendingDelegatorRewards(const std::string& delegator) const;
+    // --- Stake ledger log (guarded by chainMutex) ---
+    // Stakes, delegations, claims and commission changes in height order. Blocks split
+    // rewards using only the events logged before them, so replay reproduces the split.
+    std::vector<StakeEvent> stakeEvents;
+    size_t stakeEventsDirtyFrom = 0; // first entry not yet written to stake_events
+    void recordStakeEvent(const StakeEvent& event);
+    void applyStakeEvent(const StakeEvent& event);
+    double commissionAt(int height) const;
+    // Moves events logged above forkParent to height (reorgs); returns their old heights, newest first
+    std::vector<int> rebaseStakeEvents(int forkParent, int height);
+    void restoreStakeEvents(const std::vector<int>& heights);
+    std::vector<StakeEvent> loadStakeEvents() const;
+    bool saveStakeEvents();
+    // O(log n) weighted producer selection, kept in step with stakes/delegatedStakes
+    StakeIndex stakeIndex;
+    // Seeded PoS draw over the stakes logged up to parentHeight. Caller holds chainMutex.
+    std::string stakerAt(int parentHeight, const std::string& seed) const;
+    // --- DPoS schedule (guarded by chainMutex) ---
+    int dposSlotSeconds = 10;
+    size_t dposMaxProducers = 21;
+    size_t dposRoundsPerEpoch = 6;
+    mutable std::map<uint64_t, ProducerSchedule> epochSchedules; // recent epochs with a fixed boundary
+    mutable ProducerSchedule previewSchedule; // last epoch asked for whose boundary is still open, never cached
+    // Schedules are relative to a chain: from is the newest block considered (a block's
+    // parent when validating it) and branch the resolveFork candidate it may belong to
+    const ProducerSchedule& scheduleForEpoch(uint64_t epoch, const Block& from, const std::vector<Block>* branch = nullptr) const;
+    // Last block at or below from whose slot precedes the epoch; genesis if there is none
+    const Block& epochBoundary(uint64_t epoch, const Block& from, const std::vector<Block>* branch) const;
+    // A boundary on our chain with the epoch's (or a later) block built on it
+    bool boundaryFixed(uint64_t epoch, const Block& boundary) const;
+    // --- Epoch stake snapshots (guarded by chainMutex) ---
+    mutable std::map<uint64_t, StakeSnapshot> stakeSnapshots; // recent and unsaved snapshots
+    mutable std::set<uint64_t> unsavedSnapshots;
+    // Memory, the stake_snapshots table, then the stake log up to the boundary's height.
+    // Only snapshots of fixed boundaries are cached and saved.
+    StakeSnapshot stakeSnapshotFor(uint64_t epoch, const Block& boundary) const;
+    bool loadStakeSnapshot(uint64_t epoch, StakeSnapshot* out) const;
+    bool saveStakeSnapshots();
+    bool saveConsensusSettings();
+    ThreadPlacement threadPlacement;
+    mutable std::mutex placementMutex; // leaf lock
+    bool saveThreadPlacement();
+    std::string producerForSlot(uint64_t slot, const Block& from, const std::vector<Block>* branch = nullptr) const;
+    uint64_t slotsPerEpoch() const { return dposMaxProducers * dposRoundsPerEpoch; }
+    FinalityGadget finality; // internally locked; take after chainMutex
+    uint64_t finalityEpoch = UINT64_MAX; // epoch whose producers are the current voters
+    std::string finalityBoundary;        // and the boundary block their stake came from
+    // Points the gadget at the epoch's producers as seen from block from. Caller holds chainMutex.
+    void refreshFinalityVoters(uint64_t epoch, const Block& from);
     std::set<std::string> peers;
+    std::set<std::pair<std::string, int>> knownPeers; // guarded by peersMutex; persisted in known_peers
+    mutable std::mutex peersMutex;
+    // Bans, reputation and per-peer message windows. Leaf lock: isPeerBlocked runs under peersMutex.
+    mutable std::mutex peerPolicyMutex;
     std::set<std::string> blockedPeers;
     std::map<std::string, int> peerReputation;
-    std::set<std::pair<std::string, int>> knownPeers;
-    mutable std::mutex peersMutex;
-    // For thread safety in chain sync
+    std::map<std::string, std::pair<std::time_t, int>> peerMessageWindows; // peer -> (second, messages)
+    int maxPeerMessagesPerSecond = 500; // sync replies arrive one block per message
+    // Serializes writers of chain/balances/stakes; readers use the published snapshot
     mutable std::mutex chainMutex;
+    // Guards mempool and pendingContents (lock after chainMutex when both are needed)
+    mutable std::mutex mempoolMutex;
+    StateSnapshotPtr stateSnapshot; // access only via std::atomic_load/atomic_store
+    uint64_t stateVersion = 0;
+    std::atomic<uint64_t> publishNanos{0}; // time spent publishing snapshots
+    void publishSnapshot();
+    double getBalanceLocked(const std::string& address) const;
+    void removeIncludedFromPending(const Block& block);
+    void reconcileMempoolSender(const std::string& sender);
+    double minReplacementFeeRatio = 1.10;
+    std::atomic<uint64_t> admissionCalls{0};
+    std::atomic<uint64_t> txIdNanos{0};
+    std::atomic<uint64_t> addressNanos{0};
+    std::atomic<uint64_t> verifyNanos{0};
+    std::atomic<uint64_t> admitNanos{0};
     // --- Replay/Double-Spend Protection ---
     std::string calculateTxId(const Transaction& tx) const;
-    mutable std::set<std::string> seenTxIds;
-    std::string calculateHash(const Block& block) const;
+    // Fast negative answers for txids we have seen (admitted or confirmed); a hit is
+    // confirmed against the mempool and the confirmed-txid index. Fixed memory.
+    // Guarded by replayMutex, a leaf lock taken after chainMutex/mempoolMutex.
+    mutable std::mutex replayMutex;
+    RollingBloomFilter seenTxFilter{200000, 0.0001};
+    // Exact index of confirmed txids: recent (not yet saved) in memory, the rest in confirmed_txids
+    std::unordered_map<std::string, int> unsavedConfirmedTxIds; // txid -> height
+    int txIndexDirtyFrom = 0; // lowest height whose txids are not yet persisted
+    bool isTxConfirmed(const std::string& txId) const; // caller holds replayMutex
+    void loadReplayFilter();
+    // --- Pending content bounds (guarded by mempoolMutex) ---
+    size_t maxPendingContents = 1000;
+    size_t maxPendingContentBytes = 4 * 1024 * 1024;
+    int pendingContentTtl = 24 * 60 * 60;
+    size_t pendingContentBytes = 0;
+    uint64_t pendingContentExpirations = 0;
+    std::time_t lastPendingExpiry = 0;
+    static size_t contentMemoryUsage(const Content& c);
+    void expirePending(std::time_t now);
+    // Removes the pending uploads matching drop(content, arrivedAt), keeping the arrival times in step
+    template <typename Pred> size_t erasePendingContentsIf(Pred drop);
+    std::string serializeBlockBody(const Block& block) const;
+    std::string hashBlockWithBody(const Block& block, const std::string& bodyData) const;
+    // --- Block template builder (caller holds chainMutex and mempoolMutex) ---
+    size_t maxBlockBytes = 1024 * 1024;
+    size_t maxBlockTxs = 2000;
+    size_t maxBlockContents = 500;
+    uint64_t contentsRevision = 0; // bumped whenever pendingContents changes
+    // --- Content batching (guarded by mempoolMutex) ---
+    size_t contentBatchSize = 1; // 1 keeps the old one-block-per-upload behaviour
+    int contentBatchWindow = 0;
+    bool savePendingContents();
+    bool loadPendingContents();
+    // The mempool is persisted so separate CLI/server processes see the same pending set
+    bool saveMempool();
+    bool loadMempool();
+    BlockTemplatePtr cachedTemplate;
+    BlockTemplatePtr buildBlockTemplate();
+    static size_t contentSize(const Content& c);
     void createGenesisBlock();
+    void appendBlock(Block block);
+    void applyBlockState(const Block& block, int direction);
+    double effectiveFee(const Transaction& tx) const;
     bool validProof(const Block& block) const;
-    void adjustDifficulty();
-    bool validateBlock(const Block& newBlock, const Block& prevBlock) const;
+    // branch: resolveFork's candidate blocks, when prevBlock is one of them
+    bool validateBlock(const Block& newBlock, const Block& prevBlock, const std::vector<Block>* branch = nullptr) const;
+    bool validateChainFrom(const ChainView& blocks, size_t start) const;
+    bool checkBlockStandalone(const Block& block, const Block& prevBlock, std::string& reason) const;
+    static bool checkBlockBits(const ChainView& blocks, size_t height, int targetSeconds, size_t window, int activationHeight,
+                               std::string& reason);
+    // --- Verified-height watermark (persisted in chain_meta) ---
+    int verifiedHeight = 0; // guarded by chainMutex
+    std::string verifiedHash;
+    bool saveVerifiedWatermark();
     void logError(const std::string& message);
     sqlite3* db = nullptr; // SQLite database handle
     double txFee = 0.01; // default transaction fee
@@ -179,7 +820,30 @@ private:
     double initialReward = 1.0;
     std::atomic<bool> p2pServerRunning{false};
     std::thread p2pServerThread;
-    void p2pServerLoop(int port);
+    std::thread p2pHandlerThread;
+    // Accepts one TLS connection at a time; each carries one message from sendEncrypted.
+    // Messages are handled on p2pHandlerThread, so replies to a peer that is itself
+    // sending to us never wait on our accept loop.
+    void p2pServerLoop(int listenFd);
+    void p2pHandlerLoop();
+    std::mutex p2pInboxMutex;
+    std::condition_variable p2pInboxReady;
+    std::deque<std::pair<std::string, std::string>> p2pInbox; // (message, peer host)
+    size_t maxP2PInbox = 1024;
+    std::atomic<bool> producerRunning{false};
+    std::thread producerThread;
+    std::mutex producerWakeMutex;
+    std::condition_variable producerWake; // interrupts the slot wait on stop
+    std::atomic<uint64_t> producedBlocks{0};
+    std::atomic<uint64_t> templateRefreshes{0};
+    std::atomic<uint64_t> staleBlocks{0};
+    std::atomic<std::time_t> lastProducedAt{0};
+    void producerLoop(const std::string& producer);
+    // PoW search that moves to a fresh template when the current one goes stale;
+    // gives up when keepRunning turns false or nothing is left to mine
+    bool mineBlockUntil(const std::string& miner, const std::atomic<bool>* keepRunning);
+    // Validates and connects a solved block on the current tip; staleTip is set when the tip moved on
+    bool connectMinedBlock(const Block& block, bool* staleTip);
     void handlePeerListMessage(const std::string& msg);
     // --- DDoS Protection ---
     bool checkPeerRateLimit(const std::string& peerAddress);
@@ -0,0 +1,61 @@
+#include "bloom_filter.h"
+#include <cmath>
+#include <algorithm>
+
+RollingBloomFilter::RollingBloomFilter(size_t capacity, double falsePositiveRate) {
+    keysPerGeneration = std::max<size_t>(1, capacity / 2);
+    // Standard sizing: m = -n ln p / (ln 2)^2, k = (m / n) ln 2
+    double ln2 = std::log(2.0);
+    double bits = -(double)keysPerGeneration * std::log(falsePositiveRate) / (ln2 * ln2);
+    bitsPerGeneration = std::max<size_t>(64, (size_t)std::ceil(bits));
+    numHashes = std::max(1, (int)std::round(bits / keysPerGeneration * ln2));
+    size_t words = (bitsPerGeneration + 63) / 64;
+    generations[0].assign(words, 0);
+    generations[1].assign(words, 0);
+}
+
+// Double hashing (Kirsch-Mitzenmacher) over two FNV-1a variants
+void RollingBloomFilter::bitPositions(const std::string& key, std::vector<size_t>& out) const {
+    uint64_t h1 = 14695981039346656037ULL, h2 = 0x9E3779B97F4A7C15ULL;
+    for (unsigned char c : key) {
+        h1 = (h1 ^ c) * 1099511628211ULL;
+        h2 = (h2 ^ c) * 0x100000001B3ULL + 0x7F4A7C15ULL;
+    }
+    h2 |= 1;
+    out.resize(numHashes);
+    for (int i = 0; i < numHashes; ++i) out[i] = (h1 + i * h2) % bitsPerGeneration;
+}
+
+void RollingBloomFilter::insert(const std::string& key) {
+    if (keysInCurrent >= keysPerGeneration) {
+        current ^= 1;
+        std::fill(generations[current].begin(), generations[current].end(), 0);
+        keysInCurrent = 0;
+    }
+    std::vector<size_t> pos;
+    bitPositions(key, pos);
+    for (size_t p : pos) generations[current][p / 64] |= (1ULL << (p % 64));
+    ++keysInCurrent;
+}
+
+bool RollingBloomFilter::mayContain(const std::string& key) const {
+    std::vector<size_t> pos;
+    bitPositions(key, pos);
+    for (const auto& gen : generations) {
+        bool all = true;
+        for (size_t p : pos) {
+            if (!(gen[p / 64] & (1ULL << (p % 64)))) { all = false; break; }
+        }
+        if (all) return true;
+    }
+    return false;
+}
+
+void RollingBloomFilter::clear() {
+    for (auto& gen : generations) std::fill(gen.begin(), gen.end(), 0);
+    keysInCurrent = 0;
+}
+
+size_t RollingBloomFilter::memoryUsage() const {
+    return (generations[0].size() + generations[1].size()) * sizeof(uint64_t);
+}
@@ -0,0 +1,29 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Two-generation bloom filter with a fixed memory ceiling. Inserts go to the
+// current generation; once it holds capacity/2 keys the older generation is
+// wiped and the roles swap, so roughly the last `capacity` keys are remembered
+// and older ones age out. Answers "definitely not seen" or "maybe seen".
+class RollingBloomFilter {
+public:
+    RollingBloomFilter(size_t capacity, double falsePositiveRate);
+    void insert(const std::string& key);
+    bool mayContain(const std::string& key) const;
+    void clear();
+    size_t memoryUsage() const;
+private:
+    void bitPositions(const std::string& key, std::vector<size_t>& out) const;
+    std::vector<uint64_t> generations[2];
+    size_t bitsPerGeneration;
+    size_t keysPerGeneration;
+    size_t keysInCurrent = 0;
+    int numHashes;
+    int current = 0;
+};
+
+#endif // BLOOM_FILTER_H
@@ -0,0 +1,152 @@
+// Ahmiyat Blockchain - CPU pinning and NUMA placement of worker threads
+
+#include "cpu_affinity.h"
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+bool parseCpuList(const std::string& list, std::vector<int>& cpus) {
+    cpus.clear();
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        try {
+            size_t used = 0;
+            int first = std::stoi(range.substr(0, dash), &used);
+            if (used != (dash == std::string::npos ? range.size() : dash)) return false;
+            int last = first;
+            if (dash != std::string::npos) {
+                last = std::stoi(range.substr(dash + 1), &used);
+                if (used != range.size() - dash - 1) return false;
+            }
+            if (first < 0 || last < first || last >= CPU_SETSIZE) return false;
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        } catch (...) {
+            return false;
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return true;
+}
+
+std::string formatCpuList(const std::vector<int>& cpus) {
+    std::string out;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+        if (!out.empty()) out += ",";
+        out += std::to_string(cpus[i]);
+        if (j > i) out += "-" + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+int cpuNumaNode(int cpu) {
+    // Each CPU directory links to its node as "nodeN"
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return -1;
+    int node = -1;
+    while (dirent* entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+    if (cpus.empty()) return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool ThreadPlacement::configure(const std::string& miningList, const std::string& reservedList) {
+    std::vector<int> mining, reserved;
+    if (!parseCpuList(miningList, mining) || !parseCpuList(reservedList, reserved)) {
+        std::cerr << "Invalid CPU list: use the form 0-3,8" << std::endl;
+        return false;
+    }
+    std::vector<int> allowed = allowedCpus();
+    for (const auto* cpus : {&mining, &reserved}) {
+        for (int cpu : *cpus) {
+            if (!std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                std::cerr << "CPU " << cpu << " is not available to this process (allowed: " << formatCpuList(allowed) << ")" << std::endl;
+                return false;
+            }
+        }
+    }
+    for (int cpu : mining) {
+        if (std::binary_search(reserved.begin(), reserved.end(), cpu)) {
+            std::cerr << "CPU " << cpu << " cannot be both a mining and a reserved core" << std::endl;
+            return false;
+        }
+    }
+    // At least one CPU has to be left for mining
+    if (mining.empty() && !reserved.empty() && reserved.size() >= allowed.size()) {
+        std::cerr << "Reserving every CPU leaves none for mining" << std::endl;
+        return false;
+    }
+    miningCpus = mining;
+    reservedCpus = reserved;
+    return true;
+}
+
+std::vector<int> ThreadPlacement::miningSet() const {
+    if (!miningCpus.empty()) return miningCpus;
+    std::vector<int> cpus;
+    for (int cpu : allowedCpus()) {
+        if (!std::binary_search(reservedCpus.begin(), reservedCpus.end(), cpu)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+int ThreadPlacement::pinMiningWorker(unsigned index) const {
+    if (miningCpus.empty() && reservedCpus.empty()) return -1;
+    std::vector<int> cpus = miningSet();
+    if (cpus.empty()) return -1;
+    int cpu = cpus[index % cpus.size()];
+    return pinCurrentThread({cpu}) ? cpu : -1;
+}
+
+bool ThreadPlacement::pinReserved() const {
+    return pinCurrentThread(reservedCpus);
+}
+
+std::string ThreadPlacement::describe() const {
+    if (miningCpus.empty() && reservedCpus.empty()) return "scheduler default";
+    auto withNodes = [](const std::vector<int>& cpus) {
+        std::string out = formatCpuList(cpus);
+        std::vector<int> nodes;
+        for (int cpu : cpus) nodes.push_back(cpuNumaNode(cpu));
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        if (!nodes.empty() && nodes.front() >= 0) out += " (NUMA " + formatCpuList(nodes) + ")";
+        return out;
+    };
+    std::string reserved = reservedCpus.empty() ? "none" : withNodes(reservedCpus);
+    return "mining " + withNodes(miningSet()) + ", reserved " + reserved;
+}
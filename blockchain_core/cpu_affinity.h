@@ -0,0 +1,41 @@
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <string>
+#include <vector>
+
+// CPU lists use the kernel's cpulist syntax, e.g. "0-3,8"
+bool parseCpuList(const std::string& list, std::vector<int>& cpus);
+std::string formatCpuList(const std::vector<int>& cpus);
+// CPUs this process may run on (sched_getaffinity)
+std::vector<int> allowedCpus();
+// NUMA node of a CPU from sysfs, -1 when unknown
+int cpuNumaNode(int cpu);
+// Restricts the calling thread to `cpus`; an empty list leaves it alone
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+// Where mining and node-service threads run. Mining workers are pinned one per
+// CPU of the mining set; P2P, work-server and validation threads share the
+// reserved set, so a busy miner cannot delay block validation and vice versa.
+// Both empty (the default) leaves placement to the scheduler.
+class ThreadPlacement {
+public:
+    // Fails on unknown CPUs or when the two sets overlap
+    bool configure(const std::string& miningList, const std::string& reservedList);
+    const std::vector<int>& getMiningCpus() const { return miningCpus; }
+    const std::vector<int>& getReservedCpus() const { return reservedCpus; }
+    // The configured mining set, or every allowed CPU outside the reserved set
+    std::vector<int> miningSet() const;
+    // Pins the calling thread as mining worker `index` (round robin over the mining set).
+    // Call before allocating per-worker buffers: first-touch then places their
+    // pages on the worker's NUMA node. Returns the CPU used, -1 if not pinned.
+    int pinMiningWorker(unsigned index) const;
+    // Pins the calling thread to the reserved set (no-op when none is reserved)
+    bool pinReserved() const;
+    std::string describe() const;
+private:
+    std::vector<int> miningCpus;
+    std::vector<int> reservedCpus;
+};
+
+#endif // CPU_AFFINITY_H
@@ -0,0 +1,188 @@
+// Ahmiyat Blockchain - BFT finality gadget
+
+#include "finality.h"
+#include "blockchain.h"
+#include "ecdsa_utils.h"
+#include <algorithm>
+#include <thread>
+
+std::string FinalityGadget::voteSigningData(const std::string& blockHash, int height) {
+    return "vote|" + std::to_string(height) + "|" + blockHash;
+}
+
+FinalityVote FinalityGadget::signVote(const std::string& blockHash, int height, const std::string& privKeyPem, const std::string& pubKeyPem) {
+    FinalityVote vote;
+    vote.voter = Wallet::publicKeyToAddress(pubKeyPem);
+    vote.blockHash = blockHash;
+    vote.height = height;
+    vote.signature = ECDSAUtils::sign(voteSigningData(blockHash, height), privKeyPem);
+    vote.publicKeyPem = pubKeyPem;
+    return vote;
+}
+
+void FinalityGadget::setVoters(const std::map<std::string, double>& stakeByVoter) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stakeByVoter == voterStake) return;
+    voterStake = stakeByVoter;
+    totalStake = 0;
+    for (const auto& [voter, stake] : voterStake) totalStake += stake;
+    // Tallies were weighed against the old set; the new voters have to vote again
+    for (auto& [hash, block] : blocks) {
+        block.stake = 0;
+        block.voters.clear();
+        block.certified = false;
+    }
+    votedFor.clear();
+}
+
+void FinalityGadget::onBlock(const std::string& hash, const std::string& prevHash, int height) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (height <= finalizedHeight) return;
+    BlockVotes& block = blocks[hash];
+    block.height = height;
+    block.prevHash = prevHash;
+    // Votes may have arrived before the block itself
+    checkFinality(hash);
+}
+
+size_t FinalityGadget::addVotes(const std::vector<FinalityVote>& votes, unsigned threads) {
+    // 1. Cheap filtering under the lock so no signature is checked twice
+    std::vector<const FinalityVote*> candidates;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::pair<int, std::string>, const std::string*> inBatch; // first hash per (height, voter)
+        for (const auto& vote : votes) {
+            if (vote.height <= finalizedHeight || !voterStake.count(vote.voter)) continue;
+            auto key = std::make_pair(vote.height, vote.voter);
+            auto prior = votedFor.find(key);
+            if (prior != votedFor.end()) {
+                if (prior->second != vote.blockHash) ++equivocations;
+                continue;
+            }
+            auto first = inBatch.emplace(key, &vote.blockHash);
+            if (!first.second) {
+                if (*first.first->second != vote.blockHash) ++equivocations;
+                continue;
+            }
+            candidates.push_back(&vote);
+        }
+    }
+    if (candidates.empty()) return 0;
+    // 2. Verify the batch in parallel, lock-free
+    std::vector<char> valid(candidates.size(), 0);
+    auto verifyRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const FinalityVote& vote = *candidates[i];
+            valid[i] = Wallet::publicKeyToAddress(vote.publicKeyPem) == vote.voter &&
+                       ECDSAUtils::verify(voteSigningData(vote.blockHash, vote.height), vote.signature, vote.publicKeyPem);
+        }
+    };
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = (unsigned)std::min<size_t>(threads, (candidates.size() + 7) / 8); // at least 8 votes per worker
+    if (threads <= 1) {
+        verifyRange(0, candidates.size());
+    } else {
+        std::vector<std::thread> workers;
+        size_t chunk = (candidates.size() + threads - 1) / threads;
+        for (size_t begin = 0; begin < candidates.size(); begin += chunk) {
+            workers.emplace_back(verifyRange, begin, std::min(begin + chunk, candidates.size()));
+        }
+        for (auto& worker : workers) worker.join();
+    }
+    // 3. Tally; re-check for races with a concurrent batch
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t counted = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const FinalityVote& vote = *candidates[i];
+        if (!valid[i]) {
+            ++invalidSignatures;
+            continue;
+        }
+        ++verified;
+        if (vote.height <= finalizedHeight) continue;
+        auto inserted = votedFor.emplace(std::make_pair(vote.height, vote.voter), vote.blockHash);
+        if (!inserted.second) {
+            if (inserted.first->second != vote.blockHash) ++equivocations;
+            continue;
+        }
+        BlockVotes& block = blocks[vote.blockHash];
+        block.height = vote.height;
+        if (!block.voters.insert(vote.voter).second) continue;
+        block.stake += voterStake[vote.voter];
+        ++counted;
+        if (!block.certified && block.stake * 3 > totalStake * 2) {
+            block.certified = true;
+            checkFinality(vote.blockHash);
+        }
+    }
+    return counted;
+}
+
+// Two-chain rule: finalize hash's parent if both are certified, or hash itself
+// if a certified child is already known
+void FinalityGadget::checkFinality(const std::string& hash) {
+    auto it = blocks.find(hash);
+    if (it == blocks.end() || !it->second.certified) return;
+    const BlockVotes& block = it->second;
+    auto parent = blocks.find(block.prevHash);
+    if (parent != blocks.end() && parent->second.certified && parent->second.height + 1 == block.height) {
+        finalize(block.prevHash, parent->second.height);
+        return;
+    }
+    for (const auto& [childHash, child] : blocks) {
+        if (child.certified && child.prevHash == hash && child.height == block.height + 1) {
+            finalize(hash, block.height);
+            return;
+        }
+    }
+}
+
+void FinalityGadget::finalize(const std::string& hash, int height) {
+    if (height <= finalizedHeight) return;
+    finalizedHeight = height;
+    finalizedHash = hash;
+    // Nothing at or below the finalized height can change any more
+    for (auto it = blocks.begin(); it != blocks.end();) {
+        it = it->second.height < finalizedHeight ? blocks.erase(it) : std::next(it);
+    }
+    votedFor.erase(votedFor.begin(), votedFor.lower_bound(std::make_pair(finalizedHeight, std::string())));
+}
+
+bool FinalityGadget::isCertified(const std::string& hash) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = blocks.find(hash);
+    return it != blocks.end() && it->second.certified;
+}
+
+int FinalityGadget::getFinalizedHeight() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return finalizedHeight;
+}
+
+std::string FinalityGadget::getFinalizedHash() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return finalizedHash;
+}
+
+void FinalityGadget::restoreFinalized(int height, const std::string& hash) {
+    std::lock_guard<std::mutex> lock(mutex);
+    finalizedHeight = height;
+    finalizedHash = hash;
+    blocks.clear();
+    votedFor.clear();
+}
+
+uint64_t FinalityGadget::verifiedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return verified;
+}
+
+uint64_t FinalityGadget::invalidSignatureCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return invalidSignatures;
+}
+
+uint64_t FinalityGadget::equivocationCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return equivocations;
+}
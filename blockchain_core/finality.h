@@ -0,0 +1,69 @@
+#ifndef FINALITY_H
+#define FINALITY_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+// A delegate's signature over (height, blockHash)
+struct FinalityVote {
+    std::string voter; // delegate address, must match publicKeyPem
+    std::string blockHash;
+    int height = 0;
+    std::string signature;
+    std::string publicKeyPem;
+};
+
+// Two-chain BFT finality for DPoS. Each delegate signs one vote per height; a
+// block whose votes carry more than 2/3 of the voting stake is certified, and a
+// certified block with a certified direct child is final, along with all of its
+// ancestors. A vote for height h+1 doubles as the second round for h, so
+// finality trails the tip by one block rather than three voting rounds.
+// Thread-safe: signatures are verified outside the lock, tallies under it.
+class FinalityGadget {
+public:
+    static std::string voteSigningData(const std::string& blockHash, int height);
+    static FinalityVote signVote(const std::string& blockHash, int height, const std::string& privKeyPem, const std::string& pubKeyPem);
+    // Voting stake per delegate address for the current epoch; a different set
+    // discards the votes counted so far
+    void setVoters(const std::map<std::string, double>& stakeByVoter);
+    void onBlock(const std::string& hash, const std::string& prevHash, int height);
+    // Drops unknown voters, repeats and equivocations (a second hash at the same
+    // height), verifies the rest across `threads` workers (0 = all cores), then
+    // tallies. Returns the number of votes counted.
+    size_t addVotes(const std::vector<FinalityVote>& votes, unsigned threads = 0);
+    bool isCertified(const std::string& hash) const;
+    int getFinalizedHeight() const;
+    std::string getFinalizedHash() const;
+    void restoreFinalized(int height, const std::string& hash);
+    uint64_t verifiedCount() const;
+    uint64_t invalidSignatureCount() const;
+    uint64_t equivocationCount() const;
+private:
+    struct BlockVotes {
+        int height = 0;
+        std::string prevHash; // empty until onBlock is seen
+        double stake = 0;
+        std::set<std::string> voters;
+        bool certified = false;
+    };
+    // Caller holds mutex
+    void checkFinality(const std::string& hash);
+    void finalize(const std::string& hash, int height);
+    mutable std::mutex mutex;
+    std::map<std::string, double> voterStake;
+    double totalStake = 0;
+    std::unordered_map<std::string, BlockVotes> blocks;          // block hash -> tally
+    std::map<std::pair<int, std::string>, std::string> votedFor; // (height, voter) -> block hash
+    int finalizedHeight = 0;
+    std::string finalizedHash;
+    uint64_t verified = 0;
+    uint64_t invalidSignatures = 0;
+    uint64_t equivocations = 0;
+};
+
+#endif // FINALITY_H
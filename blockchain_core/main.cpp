@@ -2,9 +2,29 @@
 // Written from scratch in C++
 
 #include "blockchain.h"
+#include "bench.h"
+#include "work_server.h"
 #include <iostream>
 #include <cstring>
 #include <fstream>
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static nlohmann::json mempoolEntryJson(const Mempool::Entry& entry) {
+    nlohmann::json j;
+    j["txid"] = entry.txId;
+    j["sender"] = entry.tx.sender;
+    j["receiver"] = entry.tx.receiver;
+    j["amount"] = entry.tx.amount;
+    j["fee"] = entry.tx.fee;
+    j["nonce"] = entry.tx.nonce;
+    j["size"] = entry.size;
+    j["feeRate"] = entry.feeRate;
+    j["addedAt"] = entry.addedAt;
+    return j;
+}
 
 int main(int argc, char* argv[]) {
     Blockchain chain;
@@ -21,15 +41,26 @@ int main(int argc, char* argv[]) {
             out.close();
             return 0;
         } else if (strcmp(argv[1], "balance") == 0 && argc == 3) {
-            auto bals = chain.getBalances();
             std::string addr = argv[2];
-            std::cout << "Balance for " << addr << ": " << (bals.count(addr) ? bals[addr] : 0.0) << std::endl;
+            std::cout << "Balance for " << addr << ": " << chain.getBalance(addr) << std::endl;
+            double pending = chain.getPendingDelegatorRewards(addr);
+            if (pending > 0) std::cout << "Unclaimed delegator rewards: " << pending << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "claim-rewards") == 0 && argc == 3) {
+            std::string addr = argv[2];
+            double paid = chain.claimDelegatorRewards(addr);
+            if (paid > 0) chain.saveToDb();
+            std::cout << "Claimed " << paid << " in delegator rewards for " << addr << std::endl;
             return 0;
-        } else if (strcmp(argv[1], "send") == 0 && argc == 6) {
+        } else if (strcmp(argv[1], "send") == 0 && argc >= 6 && argc <= 8) {
             std::string from = argv[2];
             std::string to = argv[3];
             double amount = std::stod(argv[4]);
             std::string privFile = argv[5];
+            // Optional fee; defaults to the minimum relay fee
+            double fee = argc >= 7 ? std::stod(argv[6]) : chain.getTxFee();
+            // Optional nonce; reusing a pending nonce with a higher fee replaces that transaction
+            uint64_t nonce = argc == 8 ? std::stoull(argv[7]) : chain.getNextNonce(from);
             std::ifstream in(privFile.c_str());
             std::string privPem((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
             in.close();
@@ -43,9 +74,8 @@ int main(int argc, char* argv[]) {
             while (std::getline(std::cin, line)) pubPem += line + "\n";
             w.publicKeyPem = pubPem;
             w.address = Wallet::publicKeyToAddress(pubPem);
-            std::string data = from + to + std::to_string(amount);
-            std::string sig = Wallet::sign(data, privPem);
-            Transaction t = {from, to, amount, sig, pubPem};
+            Transaction t = {from, to, amount, "", pubPem, fee, nonce};
+            t.signature = Wallet::sign(Blockchain::txSigningData(t), privPem);
             if (chain.addTransaction(t)) {
                 chain.saveToDb();
                 std::cout << "Transaction added\n";
@@ -78,10 +108,52 @@ int main(int argc, char* argv[]) {
             std::string mode = argv[2];
             if (mode == "pow") chain.setConsensusMode(ConsensusMode::PoW);
             else if (mode == "pos") chain.setConsensusMode(ConsensusMode::PoS);
-            else if (mode == "dpos") chain.setConsensusMode(ConsensusMode::PoW); // For demo, treat as PoW
+            else if (mode == "dpos") chain.setConsensusMode(ConsensusMode::DPoS);
             chain.saveToDb();
             std::cout << "Consensus mode set\n";
             return 0;
+        } else if (strcmp(argv[1], "set-dpos") == 0 && argc == 5) {
+            // set-dpos <slotSeconds> <maxProducers> <roundsPerEpoch>
+            chain.setDPoSParams(std::stoi(argv[2]), std::stoul(argv[3]), std::stoul(argv[4]));
+            chain.saveToDb();
+            std::cout << "DPoS schedule parameters set\n";
+            return 0;
+        } else if (strcmp(argv[1], "dpos-schedule") == 0) {
+            // dpos-schedule [epoch]; defaults to the current epoch
+            uint64_t slot = chain.slotAt(std::time(nullptr));
+            uint64_t epoch = argc > 2 ? std::stoull(argv[2]) : chain.epochOfSlot(slot);
+            ProducerSchedule schedule = chain.getProducerSchedule(epoch);
+            if (schedule.slots.empty()) {
+                std::cout << "Epoch " << epoch << ": no producers (no delegated stake, or a past epoch without a snapshot)" << std::endl;
+                return 0;
+            }
+            std::cout << "Epoch " << schedule.epoch << " (slots " << schedule.firstSlot << "-"
+                      << schedule.firstSlot + schedule.slots.size() - 1 << "), current slot " << slot << std::endl;
+            for (const auto& producer : schedule.producers) std::cout << "  Producer: " << producer << std::endl;
+            if (!schedule.slots.empty() && chain.epochOfSlot(slot) == epoch) {
+                std::cout << "Current producer: " << schedule.slots[slot - schedule.firstSlot] << std::endl;
+            }
+            return 0;
+        } else if (strcmp(argv[1], "stake-snapshot") == 0 && argc == 3) {
+            // stake-snapshot <epoch>
+            uint64_t epoch = std::stoull(argv[2]);
+            StakeSnapshot snapshot;
+            if (!chain.getStakeSnapshot(epoch, &snapshot)) {
+                std::cout << "No stake snapshot for epoch " << epoch << std::endl;
+                return 1;
+            }
+            std::cout << "Epoch " << snapshot.epoch << ": " << snapshot.validators.size() << " validators, total stake "
+                      << snapshot.totalStake << std::endl;
+            for (const auto& [delegate, amount] : snapshot.validators) std::cout << "  " << delegate << ": " << amount << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "verify-producer") == 0 && argc == 3) {
+            // verify-producer <height>: checks a stake block against its epoch's snapshot
+            std::string expected;
+            bool ok = chain.verifyBlockProducer(std::stoi(argv[2]), &expected);
+            std::cout << (ok ? "Producer valid" : "Producer INVALID");
+            if (!expected.empty()) std::cout << " (slot owner " << expected << ")";
+            std::cout << std::endl;
+            return ok ? 0 : 1;
         } else if (strcmp(argv[1], "add-tx") == 0 && argc == 6) {
             Transaction t = {argv[2], argv[3], std::stod(argv[4]), argv[5]};
             chain.addTransaction(t);
@@ -90,17 +162,198 @@ int main(int argc, char* argv[]) {
             return 0;
         } else if (strcmp(argv[1], "add-content") == 0 && argc == 6) {
             Content c = {argv[2], argv[3], argv[4], argv[5], std::time(nullptr)};
-            chain.addContent(c, argv[4]);
-            chain.mineBlock(argv[4]);
+            if (!chain.addContent(c, argv[4])) {
+                std::cout << "Content rejected\n";
+                return 1;
+            }
+            // Receipt right away; the block is sealed once the batch is full or its window elapses
+            std::cout << "Receipt: " << c.hash << " queued at " << c.timestamp << std::endl;
+            if (chain.sealContentBatch(argv[4])) {
+                std::cout << "Content added and block mined\n";
+            } else {
+                ContentStatus status = chain.getContentStatus(c.hash);
+                std::cout << "Content pending (" << status.pendingCount << "/" << chain.getContentBatchSize() << " in batch)\n";
+            }
+            chain.saveToDb();
+            return 0;
+        } else if (strcmp(argv[1], "content-status") == 0 && argc == 3) {
+            ContentStatus status = chain.getContentStatus(argv[2]);
+            if (!status.found) {
+                std::cout << "Status: unknown\n";
+            } else if (status.confirmed) {
+                std::cout << "Status: confirmed at height " << status.height << " (" << status.confirmations << " confirmations)\n";
+            } else {
+                std::cout << "Status: pending (position " << status.pendingPosition + 1 << " of " << status.pendingCount << ")\n";
+            }
+            return 0;
+        } else if (strcmp(argv[1], "seal-contents") == 0 && argc >= 3) {
+            // seal-contents <miner> [--force]; run periodically to honour the batch window
+            bool force = argc > 3 && strcmp(argv[3], "--force") == 0;
+            if (chain.sealContentBatch(argv[2], force)) {
+                chain.saveToDb();
+                std::cout << "Content batch sealed\n";
+            } else {
+                std::cout << "No content batch due\n";
+            }
+            return 0;
+        } else if (strcmp(argv[1], "set-content-batch") == 0 && argc == 4) {
+            // set-content-batch <count> <windowSeconds>
+            chain.setContentBatching(std::stoul(argv[2]), std::stoi(argv[3]));
+            chain.saveToDb();
+            std::cout << "Content batching set\n";
+            return 0;
+        } else if (strcmp(argv[1], "mempool-info") == 0) {
+            MempoolStats stats = chain.getMempoolStats();
+            nlohmann::json j;
+            j["count"] = stats.count;
+            j["bytes"] = stats.bytes;
+            j["txBytes"] = stats.txBytes;
+            j["minFeeRate"] = stats.minFeeRate;
+            j["maxFeeRate"] = stats.maxFeeRate;
+            j["feeHistogram"] = nlohmann::json::array();
+            for (const auto& bucket : stats.feeHistogram) {
+                j["feeHistogram"].push_back({{"minFeeRate", bucket.minFeeRate}, {"maxFeeRate", bucket.maxFeeRate},
+                                             {"count", bucket.count}, {"bytes", bucket.bytes}});
+            }
+            j["pendingContents"] = stats.pendingContents;
+            j["pendingContentBytes"] = stats.pendingContentBytes;
+            std::cout << j.dump() << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "mempool-list") == 0) {
+            // mempool-list [fee|time] [offset] [limit]
+            MempoolOrder order = argc > 2 && strcmp(argv[2], "time") == 0 ? MempoolOrder::Newest : MempoolOrder::FeeRate;
+            size_t offset = argc > 3 ? std::stoul(argv[3]) : 0;
+            size_t limit = argc > 4 ? std::stoul(argv[4]) : 50;
+            nlohmann::json j;
+            j["total"] = chain.getMempoolStats().count;
+            j["offset"] = offset;
+            j["transactions"] = nlohmann::json::array();
+            for (const auto& entry : chain.queryMempool(order, offset, limit)) j["transactions"].push_back(mempoolEntryJson(entry));
+            std::cout << j.dump() << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "mempool-tx") == 0 && argc == 3) {
+            Mempool::Entry entry;
+            if (!chain.findMempoolTx(argv[2], &entry)) {
+                std::cout << "null" << std::endl;
+                return 1;
+            }
+            std::cout << mempoolEntryJson(entry).dump() << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "mempool-sender") == 0 && argc == 3) {
+            nlohmann::json j = nlohmann::json::array();
+            for (const auto& entry : chain.getMempoolBySender(argv[2])) j.push_back(mempoolEntryJson(entry));
+            std::cout << j.dump() << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "pending-contents") == 0) {
+            // pending-contents [offset] [limit]
+            size_t offset = argc > 2 ? std::stoul(argv[2]) : 0;
+            size_t limit = argc > 3 ? std::stoul(argv[3]) : 50;
+            nlohmann::json j = nlohmann::json::array();
+            for (const auto& c : chain.getPendingContents(offset, limit)) {
+                j.push_back({{"type", c.type}, {"filename", c.filename}, {"uploader", c.uploader},
+                             {"hash", c.hash}, {"timestamp", c.timestamp}});
+            }
+            std::cout << j.dump() << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "bench-mempool") == 0) {
+            // bench-mempool [wallets] [txsPerWallet] [threads]
+            MempoolBenchConfig config;
+            if (argc > 2) config.wallets = std::stoul(argv[2]);
+            if (argc > 3) config.txsPerWallet = std::stoul(argv[3]);
+            if (argc > 4) config.threads = std::stoi(argv[4]);
+            MempoolBenchReport r = runMempoolBench(config);
+            std::cout << "Setup (keys + signing): " << r.setupSeconds << "s" << std::endl;
+            std::cout << "Accepted " << r.accepted << "/" << r.submitted << " txs in " << r.seconds << "s on "
+                      << r.threads << " threads: " << r.acceptedPerSecond << " tx/s" << std::endl;
+            std::cout << "Latency p50 " << r.p50Micros << "us, p99 " << r.p99Micros << "us" << std::endl;
+            std::cout << "Per-call stages: verify " << r.verifyMicros << "us, address " << r.addressMicros
+                      << "us, txid " << r.txIdMicros << "us, admit " << r.admitMicros << "us" << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "bench-mine") == 0) {
+            // bench-mine [zeros] [seconds] [threads] [contents]
+            MineBenchConfig config;
+            if (argc > 2) config.zeros = std::stoi(argv[2]);
+            if (argc > 3) config.seconds = std::stod(argv[3]);
+            if (argc > 4) config.threads = std::stoi(argv[4]);
+            if (argc > 5) config.contents = std::stoul(argv[5]);
+            config.placement = chain.getThreadPlacement();
+            MineBenchReport r = runMineBench(config);
+            std::cout << "Target bits " << std::hex << r.bits << std::dec << " (" << r.expectedHashes << " expected hashes), body "
+                      << r.bodyBytes << " bytes, " << r.threads << " threads, " << config.seconds << "s per kernel" << std::endl;
+            std::cout << "Placement: " << config.placement.describe() << std::endl;
+            for (const auto& k : r.kernels) {
+                std::cout << k.kernel << ": " << k.hashesPerSecond << " H/s (" << k.speedup << "x), " << k.solutions
+                          << " solutions, time to solution mean " << k.ttsMean << "s p50 " << k.ttsP50 << "s p90 " << k.ttsP90
+                          << "s max " << k.ttsMax << "s, CPU " << k.cpuSeconds << "s (" << k.cpuUtilization * 100 << "%), validation p50 "
+                          << k.validateP50Micros << "us p99 " << k.validateP99Micros << "us" << std::endl;
+            }
+            if (!r.solutionsValid) std::cout << "Kernel solutions disagree with calculateHash!" << std::endl;
+            return r.solutionsValid ? 0 : 1;
+        } else if (strcmp(argv[1], "bft-sim") == 0) {
+            // bft-sim [nodes] [blocks] [dropRate] [byzantine]
+            BftSimConfig config;
+            if (argc > 2) config.nodes = std::stoul(argv[2]);
+            if (argc > 3) config.blocks = std::stoul(argv[3]);
+            if (argc > 4) config.dropRate = std::stod(argv[4]);
+            if (argc > 5) config.byzantine = std::stoul(argv[5]);
+            BftSimReport r = runBftSim(config);
+            std::cout << "Setup (keys + signing): " << r.setupSeconds << "s" << std::endl;
+            std::cout << "Finalized heights:";
+            for (int height : r.finalizedHeights) std::cout << " " << height;
+            std::cout << " of " << config.blocks << std::endl;
+            std::cout << "Consistent: " << (r.consistent ? "yes" : "NO") << ", average lag " << r.averageLag << " blocks" << std::endl;
+            std::cout << "Verified " << r.votesVerified << " votes in " << r.verifySeconds << "s (" << r.votesPerSecond
+                      << " votes/s), " << r.equivocations << " equivocations, " << r.invalidSignatures << " bad signatures" << std::endl;
+            return r.consistent ? 0 : 1;
+        } else if (strcmp(argv[1], "sim-difficulty") == 0) {
+            // sim-difficulty [blocks] [window] [targetSeconds]
+            DifficultySimConfig config;
+            if (argc > 2) config.blocks = std::stoul(argv[2]);
+            if (argc > 3) config.window = std::stoul(argv[3]);
+            if (argc > 4) config.targetSeconds = std::stoi(argv[4]);
+            DifficultySimReport r = runDifficultySim(config);
+            auto print = [&](const char* name, const BlockTimeStats& s) {
+                std::cout << name << ": mean " << s.mean << "s, stddev " << s.stddev << "s, max " << s.max
+                          << "s, " << s.slowFraction * 100 << "% slower than 4x target" << std::endl;
+            };
+            std::cout << config.blocks << " blocks, target " << config.targetSeconds << "s, LWMA window " << config.window << std::endl;
+            print("Interval rule (before)", r.legacy);
+            print("LWMA (after)", r.lwma);
+            return 0;
+        } else if (strcmp(argv[1], "set-retarget") == 0 && argc == 4) {
+            // set-retarget <targetSeconds> <window>
+            if (!chain.setRetargetParams(std::stoi(argv[2]), std::stoul(argv[3]))) {
+                std::cerr << "Retarget parameters are fixed once blocks have been mined with them" << std::endl;
+                return 1;
+            }
             chain.saveToDb();
-            std::cout << "Content added and block mined\n";
+            std::cout << "Retargeting: " << chain.getTargetBlockTime() << "s blocks, LWMA over "
+                      << chain.getRetargetWindow() << " blocks" << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "set-thread-placement") == 0 && argc == 4) {
+            // set-thread-placement <miningCpus|-> <reservedCpus|->, e.g. 2-7 0-1; "-" clears a set
+            std::string mining = strcmp(argv[2], "-") == 0 ? "" : argv[2];
+            std::string reserved = strcmp(argv[3], "-") == 0 ? "" : argv[3];
+            if (!chain.setThreadPlacement(mining, reserved)) return 1;
+            chain.saveToDb();
+            std::cout << "Thread placement: " << chain.getThreadPlacement().describe() << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "thread-placement") == 0) {
+            std::cout << "CPUs available: " << formatCpuList(allowedCpus()) << std::endl;
+            std::cout << "Thread placement: " << chain.getThreadPlacement().describe() << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "finality-status") == 0) {
+            std::cout << "Finalized height: " << chain.getFinalizedHeight() << " of " << chain.getHeight() << std::endl;
+            std::cout << "Finalized hash: " << chain.getFinalizedHash() << std::endl;
             return 0;
         } else if (strcmp(argv[1], "explorer") == 0) {
-            for (const auto& block : chain.getChain()) {
+            for (const auto& blockPtr : chain.blocksInRange(0, chain.getHeight())) {
+                const Block& block = *blockPtr;
                 std::cout << "Block " << block.index << ": " << block.hash << "\n";
                 std::cout << "  Miner: " << block.miner << "\n";
                 std::cout << "  Nonce: " << block.nonce << "\n";
                 std::cout << "  Difficulty: " << block.difficulty << "\n";
+                if (block.bits) std::cout << "  Target bits: 0x" << std::hex << block.bits << std::dec << "\n";
                 for (const auto& tx : block.transactions) {
                     std::cout << "    TX: " << tx.sender << " -> " << tx.receiver << " | " << tx.amount << " | sig: " << tx.signature << "\n";
                 }
@@ -109,6 +362,25 @@ int main(int argc, char* argv[]) {
                 }
             }
             return 0;
+        } else if (strcmp(argv[1], "verify-chain") == 0) {
+            bool full = argc > 2 && strcmp(argv[2], "--full") == 0;
+            if (full) {
+                // verify-chain --full [threads]
+                unsigned threads = argc > 3 ? std::stoi(argv[3]) : 0;
+                ChainVerifyReport report = chain.verifyChainParallel(threads);
+                std::cout << "Chain valid: " << (report.valid ? "YES" : "NO") << std::endl;
+                if (!report.valid) {
+                    std::cout << "First invalid height: " << report.firstInvalidHeight << " (" << report.reason << ")" << std::endl;
+                }
+                std::cout << "Checked " << report.blocksChecked << " blocks, " << report.txsChecked << " txs in "
+                          << report.seconds << "s using " << report.threads << " threads ("
+                          << (report.seconds > 0 ? report.blocksChecked / report.seconds : 0) << " blocks/s)" << std::endl;
+                return report.valid ? 0 : 1;
+            }
+            bool valid = chain.verifyChain(false);
+            std::cout << "Chain valid: " << (valid ? "YES" : "NO") << std::endl;
+            std::cout << "Verified height: " << chain.getVerifiedHeight() << std::endl;
+            return valid ? 0 : 1;
         } else if (strcmp(argv[1], "set-fee") == 0 && argc == 3) {
             double fee = std::stod(argv[2]);
             chain.setTxFee(fee);
@@ -127,9 +399,71 @@ int main(int argc, char* argv[]) {
         } else if (strcmp(argv[1], "get-halving") == 0) {
             std::cout << "Current halving interval: " << chain.getHalvingInterval() << std::endl;
             return 0;
+        } else if (strcmp(argv[1], "run-producer") == 0 && argc >= 3 && argc <= 4) {
+            // run-producer <address> [seconds]; runs until Enter when no duration is given
+            std::string producer = argv[2];
+            int seconds = argc == 4 ? std::stoi(argv[3]) : 0;
+            chain.startBlockProducer(producer);
+            std::atomic<bool> stop{false};
+            std::thread waiter;
+            if (seconds <= 0) {
+                std::cout << "Producing blocks as " << producer << ". Press Enter to stop..." << std::endl;
+                waiter = std::thread([&stop] { std::cin.get(); stop = true; });
+            }
+            // Persist from this thread after each new block so the producer never waits on the database
+            uint64_t saved = 0;
+            for (int elapsed = 0; !stop && (seconds <= 0 || elapsed < seconds * 10); ++elapsed) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                BlockProducerStats stats = chain.getBlockProducerStats();
+                if (stats.blocks != saved) {
+                    chain.saveToDb();
+                    saved = stats.blocks;
+                    std::cout << "Block " << chain.getHeight() << " produced (" << stats.blocks << " this run)" << std::endl;
+                }
+            }
+            chain.stopBlockProducer();
+            if (waiter.joinable()) waiter.join();
+            chain.saveToDb();
+            BlockProducerStats stats = chain.getBlockProducerStats();
+            std::cout << "Produced " << stats.blocks << " blocks, " << stats.templateRefreshes << " template refreshes, "
+                      << stats.staleBlocks << " stale solutions" << std::endl;
+            return 0;
+        } else if (strcmp(argv[1], "work-server") == 0 && argc >= 4 && argc <= 5) {
+            // work-server <port> <payoutAddress> [bindAddress]
+            WorkServer server(chain, argv[3]);
+            std::string bindAddress = argc == 5 ? argv[4] : "127.0.0.1";
+            if (!server.start(std::stoi(argv[2]), bindAddress)) return 1;
+            std::cout << "Serving work on " << bindAddress << ":" << argv[2] << ". Press Enter to stop..." << std::endl;
+            std::atomic<bool> stop{false};
+            std::thread waiter([&stop] { std::cin.get(); stop = true; });
+            uint64_t saved = 0;
+            for (int tick = 1; !stop; ++tick) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                WorkServerStats stats = server.getStats();
+                if (stats.blocksFound != saved) {
+                    chain.saveToDb();
+                    saved = stats.blocksFound;
+                }
+                if (tick % 100 == 0) {
+                    std::cout << stats.workers << " workers, ~" << stats.hashRate << " H/s, shares " << stats.sharesAccepted
+                              << " accepted / " << stats.sharesRejected << " rejected, blocks " << stats.blocksFound << std::endl;
+                }
+            }
+            waiter.join();
+            server.stop();
+            chain.saveToDb();
+            return 0;
+        } else if (strcmp(argv[1], "mine-worker") == 0 && argc >= 4 && argc <= 6) {
+            // mine-worker <host> <port> [threads] [name]
+            unsigned threads = argc >= 5 ? std::stoul(argv[4]) : 0;
+            std::string name = argc == 6 ? argv[5] : "worker";
+            runMiningWorker(argv[2], std::stoi(argv[3]), threads, name, chain.getThreadPlacement());
+            return 0;
         } else if (strcmp(argv[1], "p2p-server") == 0 && argc == 3) {
             int port = std::stoi(argv[2]);
-            chain.startP2PServer(port);
+            // Connection threads inherit this thread's affinity
+            chain.getThreadPlacement().pinReserved();
+            if (!chain.startP2PServer(port)) return 1;
             std::cout << "Press Enter to stop server..." << std::endl;
             std::cin.get();
             chain.stopP2PServer();
@@ -150,9 +484,9 @@ int main(int argc, char* argv[]) {
             int blockIdx = std::stoi(argv[2]);
             std::string host = argv[3];
             int port = std::stoi(argv[4]);
-            auto chainBlocks = chain.getChain();
-            if (blockIdx >= 0 && blockIdx < (int)chainBlocks.size()) {
-                chain.broadcastBlockToPeer(chainBlocks[blockIdx], host, port);
+            BlockPtr block = chain.blockAt(blockIdx);
+            if (block) {
+                chain.broadcastBlockToPeer(*block, host, port);
                 std::cout << "Block broadcasted to peer." << std::endl;
             } else {
                 std::cout << "Invalid block index." << std::endl;
@@ -189,6 +523,6 @@ int main(int argc, char* argv[]) {
     chain.saveToDb();
     Blockchain loaded;
     loaded.loadFromDb();
-    std::cout << "Loaded chain blocks: " << loaded.getChain().size() << std::endl;
+    std::cout << "Loaded chain blocks: " << loaded.getHeight() + 1 << std::endl;
     return 0;
 }
@@ -0,0 +1,340 @@
+// Ahmiyat Blockchain - Fee-rate indexed mempool
+
+#include "blockchain.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
+size_t Mempool::txSize(const Transaction& tx) {
+    return tx.sender.size() + tx.receiver.size() + tx.signature.size() + tx.publicKeyPem.size() +
+           sizeof(tx.amount) + sizeof(tx.fee) + sizeof(tx.nonce);
+}
+
+// Counts the entry itself, its string buffers, and the txid copies and node
+// overhead of every index it lives in (hash map, fee set, arrival map, sender set).
+size_t Mempool::entryMemoryUsage(const Entry& entry) {
+    const size_t nodeOverhead = 4 * sizeof(void*);
+    const Transaction& tx = entry.tx;
+    size_t usage = sizeof(Entry) + tx.sender.capacity() + tx.receiver.capacity() +
+                   tx.signature.capacity() + tx.publicKeyPem.capacity() + entry.txId.capacity();
+    usage += sizeof(std::string) + entry.txId.size() + nodeOverhead;                 // entries key
+    usage += sizeof(FeeKey) + entry.txId.size() + nodeOverhead;                      // byFeeRate
+    usage += sizeof(uint64_t) + sizeof(std::string) + entry.txId.size() + nodeOverhead; // byArrival
+    usage += sizeof(uint64_t) + sizeof(std::string) + entry.txId.size() + nodeOverhead; // senderIndex
+    return usage;
+}
+
+void Mempool::setLimits(size_t count, size_t bytes, int ttlSeconds) {
+    maxCount = count;
+    maxBytes = bytes;
+    ttl = ttlSeconds;
+}
+
+// Picks the entries to evict (each with its sender's later nonces) without touching
+// the pool, so a newcomer that still would not fit leaves everything in place.
+// The replacing entry, if any, is counted as already gone and never chosen.
+bool Mempool::planEviction(const Entry& incoming, const std::string& replacing, std::vector<std::string>& victims) const {
+    if (incoming.memoryUsage > maxBytes || maxCount == 0) return false;
+    std::unordered_set<std::string> doomed;
+    size_t count = entries.size();
+    size_t memory = totalMemory;
+    auto doom = [&](const Entry& root) {
+        const auto& nonces = senderIndex.at(root.tx.sender);
+        for (auto n = nonces.find(root.tx.nonce); n != nonces.end(); ++n) {
+            if (!doomed.insert(n->second).second) continue;
+            --count;
+            memory -= entries.at(n->second).memoryUsage;
+        }
+    };
+    if (!replacing.empty()) {
+        const Entry& old = entries.at(replacing);
+        doomed.insert(replacing);
+        --count;
+        memory -= old.memoryUsage;
+    }
+    auto lowest = byFeeRate.rbegin();
+    auto oldest = byArrival.begin();
+    while (count > 0 && (count >= maxCount || memory + incoming.memoryUsage > maxBytes)) {
+        // count > 0 means an undoomed entry remains, so neither walk runs off the end
+        if (evictionPolicy == MempoolEvictionPolicy::Oldest) {
+            while (doomed.count(oldest->second)) ++oldest;
+            victims.push_back(oldest->second);
+            doom(entries.at(oldest->second));
+        } else {
+            while (doomed.count(lowest->txId)) ++lowest;
+            // Only outbidding transactions may displace the cheapest entry, and never
+            // their own sender's (evicting an ancestor would orphan the newcomer)
+            const Entry& victim = entries.at(lowest->txId);
+            if (incoming.feeRate <= victim.feeRate || victim.tx.sender == incoming.tx.sender) return false;
+            victims.push_back(victim.txId);
+            doom(victim);
+        }
+    }
+    return true;
+}
+
+void Mempool::evictAll(const std::vector<std::string>& victims, std::vector<Transaction>* evicted) {
+    // A victim may already be gone as a later nonce of an earlier one
+    for (const auto& txId : victims) evictions += removeWithDescendants(txId, evicted);
+}
+
+Mempool::Entry Mempool::makeEntry(const Transaction& tx, const std::string& txId) {
+    Entry entry;
+    entry.tx = tx;
+    entry.txId = txId;
+    entry.size = txSize(tx);
+    entry.feeRate = entry.size > 0 ? tx.fee / entry.size : tx.fee;
+    entry.addedAt = std::time(nullptr);
+    entry.sequence = nextSequence++;
+    entry.memoryUsage = entryMemoryUsage(entry);
+    return entry;
+}
+
+void Mempool::link(Entry entry) {
+    const std::string txId = entry.txId;
+    byFeeRate.insert({entry.feeRate, entry.sequence, txId});
+    byArrival.emplace(entry.sequence, txId);
+    senderIndex[entry.tx.sender][entry.tx.nonce] = txId;
+    pendingDebits[entry.tx.sender] += entry.tx.amount + entry.tx.fee;
+    totalMemory += entry.memoryUsage;
+    totalSize += entry.size;
+    entries.emplace(txId, std::move(entry));
+    ++revision;
+}
+
+bool Mempool::insert(const Transaction& tx, const std::string& txId, std::vector<Transaction>* evicted) {
+    if (entries.count(txId)) return false;
+    auto sender = senderIndex.find(tx.sender);
+    if (sender != senderIndex.end() && sender->second.count(tx.nonce)) return false;
+    Entry entry = makeEntry(tx, txId);
+    std::vector<std::string> victims;
+    if (!planEviction(entry, "", victims)) return false;
+    evictAll(victims, evicted);
+    link(std::move(entry));
+    return true;
+}
+
+bool Mempool::restore(const Transaction& tx, const std::string& txId, std::time_t addedAt) {
+    if (!insert(tx, txId)) return false;
+    entries.at(txId).addedAt = addedAt;
+    return true;
+}
+
+void Mempool::eraseEntry(const Entry& entry) {
+    byFeeRate.erase({entry.feeRate, entry.sequence, entry.txId});
+    byArrival.erase(entry.sequence);
+    auto it = senderIndex.find(entry.tx.sender);
+    if (it != senderIndex.end()) {
+        it->second.erase(entry.tx.nonce);
+        if (it->second.empty()) {
+            senderIndex.erase(it);
+            pendingDebits.erase(entry.tx.sender); // avoid float residue once the sender is drained
+        } else {
+            pendingDebits[entry.tx.sender] -= entry.tx.amount + entry.tx.fee;
+        }
+    }
+    totalMemory -= entry.memoryUsage;
+    totalSize -= entry.size;
+    ++revision;
+}
+
+bool Mempool::remove(const std::string& txId) {
+    auto it = entries.find(txId);
+    if (it == entries.end()) return false;
+    eraseEntry(it->second);
+    entries.erase(it);
+    return true;
+}
+
+bool Mempool::replace(const Transaction& tx, const std::string& txId, Transaction* replaced,
+                      std::vector<Transaction>* evicted) {
+    const Entry* old = findBySenderNonce(tx.sender, tx.nonce);
+    if (!old || entries.count(txId)) return false;
+    Entry entry = makeEntry(tx, txId);
+    std::vector<std::string> victims;
+    if (!planEviction(entry, old->txId, victims)) return false;
+    if (replaced) *replaced = old->tx;
+    remove(old->txId);
+    evictAll(victims, evicted);
+    link(std::move(entry));
+    ++replacements;
+    return true;
+}
+
+size_t Mempool::removeWithDescendants(const std::string& txId, std::vector<Transaction>* removed) {
+    auto it = entries.find(txId);
+    if (it == entries.end()) return 0;
+    std::string sender = it->second.tx.sender;
+    uint64_t nonce = it->second.tx.nonce;
+    std::vector<std::string> doomed;
+    const auto& nonces = senderIndex.at(sender);
+    for (auto n = nonces.find(nonce); n != nonces.end(); ++n) doomed.push_back(n->second);
+    for (const auto& id : doomed) {
+        if (removed) removed->push_back(entries.at(id).tx);
+        remove(id);
+    }
+    return doomed.size();
+}
+
+double Mempool::pendingDebit(const std::string& sender) const {
+    auto it = pendingDebits.find(sender);
+    return it == pendingDebits.end() ? 0 : it->second;
+}
+
+uint64_t Mempool::nextNonce(const std::string& sender, uint64_t confirmedNonce) const {
+    auto it = senderIndex.find(sender);
+    if (it == senderIndex.end() || it->second.empty()) return confirmedNonce + 1;
+    return it->second.rbegin()->first + 1;
+}
+
+const Mempool::Entry* Mempool::findBySenderNonce(const std::string& sender, uint64_t nonce) const {
+    auto it = senderIndex.find(sender);
+    if (it == senderIndex.end()) return nullptr;
+    auto n = it->second.find(nonce);
+    return n == it->second.end() ? nullptr : &entries.at(n->second);
+}
+
+bool Mempool::contains(const std::string& txId) const {
+    return entries.count(txId) > 0;
+}
+
+const Mempool::Entry* Mempool::find(const std::string& txId) const {
+    auto it = entries.find(txId);
+    return it == entries.end() ? nullptr : &it->second;
+}
+
+std::vector<const Mempool::Entry*> Mempool::bestFirst(size_t maxCount) const {
+    std::vector<const Entry*> result;
+    result.reserve(std::min(maxCount, entries.size()));
+    for (const auto& key : byFeeRate) {
+        if (result.size() >= maxCount) break;
+        result.push_back(&entries.at(key.txId));
+    }
+    return result;
+}
+
+// Walks the fee index once. An entry whose lower-nonce sibling is still pending is
+// parked until that sibling is taken, so a sender's transactions stay in order.
+std::vector<const Mempool::Entry*> Mempool::selectForBlock(size_t maxCount, size_t maxBytes) const {
+    std::vector<const Entry*> result;
+    size_t usedBytes = 0;
+    std::unordered_map<std::string, uint64_t> nextTaken; // sender -> next nonce we may take
+    std::unordered_map<std::string, std::map<uint64_t, const Entry*>> parked;
+    auto ready = [&](const Entry& e) {
+        auto it = nextTaken.find(e.tx.sender);
+        uint64_t expected = it != nextTaken.end() ? it->second : senderIndex.at(e.tx.sender).begin()->first;
+        return e.tx.nonce == expected;
+    };
+    for (const auto& key : byFeeRate) {
+        if (result.size() >= maxCount) break;
+        const Entry& entry = entries.at(key.txId);
+        if (!ready(entry)) {
+            parked[entry.tx.sender][entry.tx.nonce] = &entry;
+            continue;
+        }
+        if (usedBytes + entry.size > maxBytes) continue; // smaller entries may still fit
+        result.push_back(&entry);
+        usedBytes += entry.size;
+        nextTaken[entry.tx.sender] = entry.tx.nonce + 1;
+        // Taking this entry may release parked successors from the same sender
+        auto p = parked.find(entry.tx.sender);
+        while (p != parked.end() && result.size() < maxCount) {
+            auto next = p->second.find(nextTaken[entry.tx.sender]);
+            if (next == p->second.end() || usedBytes + next->second->size > maxBytes) break;
+            result.push_back(next->second);
+            usedBytes += next->second->size;
+            nextTaken[entry.tx.sender] = next->first + 1;
+            p->second.erase(next);
+        }
+    }
+    return result;
+}
+
+std::vector<const Mempool::Entry*> Mempool::bySender(const std::string& sender) const {
+    std::vector<const Entry*> result;
+    auto it = senderIndex.find(sender);
+    if (it == senderIndex.end()) return result;
+    for (const auto& n : it->second) result.push_back(&entries.at(n.second));
+    return result;
+}
+
+std::vector<const Mempool::Entry*> Mempool::page(MempoolOrder order, size_t offset, size_t limit) const {
+    std::vector<const Entry*> result;
+    if (offset >= entries.size()) return result;
+    result.reserve(std::min(limit, entries.size() - offset));
+    auto collect = [&](auto begin, auto end, auto txIdOf) {
+        size_t skipped = 0;
+        for (auto it = begin; it != end && result.size() < limit; ++it) {
+            if (skipped++ < offset) continue;
+            result.push_back(&entries.at(txIdOf(*it)));
+        }
+    };
+    if (order == MempoolOrder::FeeRate) {
+        collect(byFeeRate.begin(), byFeeRate.end(), [](const FeeKey& k) -> const std::string& { return k.txId; });
+    } else {
+        collect(byArrival.rbegin(), byArrival.rend(), [](const auto& a) -> const std::string& { return a.second; });
+    }
+    return result;
+}
+
+std::vector<FeeHistogramBucket> Mempool::feeHistogram(double bucketRatio, size_t maxBuckets) const {
+    std::vector<FeeHistogramBucket> buckets;
+    if (byFeeRate.empty() || maxBuckets == 0) return buckets;
+    bucketRatio = std::max(bucketRatio, 1.01);
+    // Ascending fee rate; zero-fee entries (possible when txFee is 0) get a bucket of their own
+    for (auto it = byFeeRate.rbegin(); it != byFeeRate.rend(); ++it) {
+        const Entry& entry = entries.at(it->txId);
+        if (entry.feeRate <= 0) {
+            if (buckets.empty()) buckets.push_back({0, std::numeric_limits<double>::min(), 0, 0});
+        } else if (buckets.empty() || buckets.back().minFeeRate == 0) {
+            buckets.push_back({entry.feeRate, entry.feeRate * bucketRatio, 0, 0});
+        }
+        while (entry.feeRate >= buckets.back().maxFeeRate && buckets.size() < maxBuckets) {
+            double lower = buckets.back().maxFeeRate;
+            buckets.push_back({lower, lower * bucketRatio, 0, 0});
+        }
+        FeeHistogramBucket& bucket = buckets.back();
+        bucket.maxFeeRate = std::max(bucket.maxFeeRate, std::nextafter(entry.feeRate, std::numeric_limits<double>::max()));
+        bucket.count++;
+        bucket.bytes += entry.size;
+    }
+    return buckets;
+}
+
+bool Mempool::evictLowest(std::vector<Transaction>* evicted) {
+    if (byFeeRate.empty()) return false;
+    std::string txId = byFeeRate.rbegin()->txId;
+    evictions += removeWithDescendants(txId, evicted);
+    return true;
+}
+
+bool Mempool::evictOldest(std::vector<Transaction>* evicted) {
+    if (byArrival.empty()) return false;
+    std::string txId = byArrival.begin()->second;
+    evictions += removeWithDescendants(txId, evicted);
+    return true;
+}
+
+size_t Mempool::expire(std::time_t now, std::vector<Transaction>* expired) {
+    size_t removed = 0;
+    // Arrival order is insertion order, so stale entries are always at the front
+    while (!byArrival.empty()) {
+        std::string txId = byArrival.begin()->second;
+        if (now - entries.at(txId).addedAt < ttl) break;
+        removed += removeWithDescendants(txId, expired);
+    }
+    expirations += removed;
+    return removed;
+}
+
+void Mempool::clear() {
+    entries.clear();
+    byFeeRate.clear();
+    byArrival.clear();
+    senderIndex.clear();
+    pendingDebits.clear();
+    totalMemory = 0;
+    totalSize = 0;
+    ++revision;
+}
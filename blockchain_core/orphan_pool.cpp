@@ -0,0 +1,86 @@
+// Ahmiyat Blockchain - Orphan block pool
+
+#include "blockchain.h"
+
+size_t OrphanBlockPool::blockSize(const Block& block) {
+    size_t size = sizeof(Block) + block.prevHash.size() + block.hash.size() + block.merkleRoot.size() + block.miner.size();
+    for (const auto& tx : block.transactions) size += sizeof(Transaction) + Mempool::txSize(tx);
+    for (const auto& c : block.contents) {
+        size += sizeof(Content) + c.type.size() + c.filename.size() + c.uploader.size() + c.hash.size() + c.publicKeyPem.size();
+    }
+    return size;
+}
+
+void OrphanBlockPool::setLimits(size_t count, size_t bytes, int ttlSeconds) {
+    maxCount = count;
+    maxBytes = bytes;
+    ttl = ttlSeconds;
+}
+
+bool OrphanBlockPool::add(const Block& block, const std::string& peer, std::time_t now) {
+    if (byHash.count(block.hash)) return false;
+    size_t size = blockSize(block);
+    if (size > maxBytes || maxCount == 0) return false;
+    auto held = perPeer.find(peer);
+    if (held != perPeer.end() && held->second >= maxPerPeer) {
+        ++peerRejections;
+        return false;
+    }
+    while (!byArrival.empty() && (byHash.size() >= maxCount || totalBytes + size > maxBytes)) {
+        erase(byArrival.begin()->second);
+        ++evictions;
+    }
+    Entry entry{block, peer, size, now, nextSequence++};
+    byPrevHash.emplace(block.prevHash, block.hash);
+    byArrival.emplace(entry.sequence, block.hash);
+    totalBytes += size;
+    ++perPeer[peer];
+    byHash.emplace(block.hash, std::move(entry));
+    ++added;
+    return true;
+}
+
+std::vector<Block> OrphanBlockPool::takeChildren(const std::string& prevHash) {
+    std::map<uint64_t, std::string> children; // keep arrival order
+    auto range = byPrevHash.equal_range(prevHash);
+    for (auto it = range.first; it != range.second; ++it) {
+        children.emplace(byHash.at(it->second).sequence, it->second);
+    }
+    std::vector<Block> result;
+    for (const auto& [seq, hash] : children) {
+        result.push_back(byHash.at(hash).block);
+        erase(hash);
+        ++connected;
+    }
+    return result;
+}
+
+size_t OrphanBlockPool::expire(std::time_t now) {
+    size_t count = 0;
+    // Arrival order is also age order
+    while (!byArrival.empty()) {
+        std::string hash = byArrival.begin()->second;
+        if (now - byHash.at(hash).receivedAt < ttl) break;
+        erase(hash);
+        ++count;
+    }
+    expirations += count;
+    return count;
+}
+
+void OrphanBlockPool::erase(const std::string& hash) {
+    auto it = byHash.find(hash);
+    if (it == byHash.end()) return;
+    auto range = byPrevHash.equal_range(it->second.block.prevHash);
+    for (auto p = range.first; p != range.second; ++p) {
+        if (p->second == hash) {
+            byPrevHash.erase(p);
+            break;
+        }
+    }
+    byArrival.erase(it->second.sequence);
+    auto held = perPeer.find(it->second.peer);
+    if (held != perPeer.end() && --held->second == 0) perPeer.erase(held);
+    totalBytes -= it->second.size;
+    byHash.erase(it);
+}
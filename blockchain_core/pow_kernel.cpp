@@ -0,0 +1,55 @@
+// Ahmiyat Blockchain - Proof-of-work search kernels
+
+// SHA256_Init/Update/Final are the only public way to snapshot a SHA-256 state;
+// OpenSSL 3 deprecates them, so ask for the 1.1.1 API in this file.
+#define OPENSSL_API_COMPAT 0x10101000L
+
+#include "pow_kernel.h"
+#include <charconv>
+#include <cstring>
+
+const char* powKernelName(PowKernel kernel) {
+    return kernel == PowKernel::Midstate ? "midstate" : "one-shot";
+}
+
+PowSearcher::PowSearcher(const std::string& prefix, const std::string& suffix, const std::string& targetHex,
+                         PowKernel kernel)
+    : prefix(prefix), suffix(suffix), kernel(kernel) {
+    // Left-pad so shorter targets parse like Uint256::fromHex
+    std::string hex = targetHex.size() < 2 * SHA256_DIGEST_LENGTH
+        ? std::string(2 * SHA256_DIGEST_LENGTH - targetHex.size(), '0') + targetHex
+        : targetHex.substr(targetHex.size() - 2 * SHA256_DIGEST_LENGTH);
+    auto digit = [](char c) { return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10; };
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i) target[i] = (unsigned char)(digit(hex[2 * i]) << 4 | digit(hex[2 * i + 1]));
+    SHA256_Init(&midstate);
+    SHA256_Update(&midstate, prefix.data(), prefix.size());
+}
+
+bool PowSearcher::meetsTarget(int64_t nonce) const {
+    char digits[24];
+    char* end = std::to_chars(digits, digits + sizeof(digits), nonce).ptr;
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    if (kernel == PowKernel::Midstate) {
+        SHA256_CTX ctx = midstate;
+        SHA256_Update(&ctx, digits, end - digits);
+        SHA256_Update(&ctx, suffix.data(), suffix.size());
+        SHA256_Final(hash, &ctx);
+    } else {
+        std::string input = prefix + std::string(digits, end) + suffix;
+        SHA256((const unsigned char*)input.data(), input.size(), hash);
+    }
+    // Big-endian bytes order like the hex strings the chain compares
+    return std::memcmp(hash, target, SHA256_DIGEST_LENGTH) <= 0;
+}
+
+bool PowSearcher::search(int64_t begin, int64_t end, int64_t* nonce, uint64_t* hashes) const {
+    for (int64_t n = begin; n < end; ++n) {
+        if (meetsTarget(n)) {
+            *hashes += n - begin + 1;
+            *nonce = n;
+            return true;
+        }
+    }
+    if (end > begin) *hashes += end - begin;
+    return false;
+}
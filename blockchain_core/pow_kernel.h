@@ -0,0 +1,36 @@
+#ifndef POW_KERNEL_H
+#define POW_KERNEL_H
+
+#include <string>
+#include <cstdint>
+#include <openssl/sha.h>
+
+// Inner proof-of-work loops over the consensus preimage
+// SHA256(prefix + decimal nonce + suffix); see Blockchain::headerPrefix/headerSuffix.
+enum class PowKernel {
+    OneShot,  // builds the preimage and hashes it in one call per nonce
+    Midstate  // absorbs the prefix once, then copies that state per nonce
+};
+
+const char* powKernelName(PowKernel kernel);
+
+// Searches nonce ranges of one template against a 64-digit hex target. Digests
+// are compared as raw bytes, so no hex string is built per attempt. Read-only
+// after construction: one searcher can be shared by several threads.
+class PowSearcher {
+public:
+    PowSearcher(const std::string& prefix, const std::string& suffix, const std::string& targetHex,
+                PowKernel kernel = PowKernel::Midstate);
+    // Tries nonces in [begin, end) and stops at the first hash <= target, returning
+    // true with *nonce set. *hashes is increased by the attempts made.
+    bool search(int64_t begin, int64_t end, int64_t* nonce, uint64_t* hashes) const;
+private:
+    bool meetsTarget(int64_t nonce) const;
+    std::string prefix;
+    std::string suffix;
+    unsigned char target[SHA256_DIGEST_LENGTH] = {};
+    PowKernel kernel;
+    SHA256_CTX midstate;
+};
+
+#endif // POW_KERNEL_H
@@ -0,0 +1,74 @@
+#include "stake_index.h"
+#include <openssl/sha.h>
+#include <cmath>
+
+double StakeIndex::prefixSum(size_t count) const {
+    double sum = 0;
+    for (size_t i = count; i > 0; i -= i & (~i + 1)) sum += tree[i];
+    return sum;
+}
+
+void StakeIndex::add(const std::string& address, double delta) {
+    auto it = slots.find(address);
+    if (it == slots.end()) {
+        // Append slot n: its node covers (n - lowbit(n), n], all but itself already present
+        size_t n = addresses.size() + 1;
+        if (tree.empty()) tree.push_back(0);
+        tree.push_back(prefixSum(n - 1) - prefixSum(n - (n & (~n + 1))) + delta);
+        weights.push_back(delta);
+        addresses.push_back(address);
+        slots.emplace(address, n - 1);
+    } else {
+        weights[it->second] += delta;
+        for (size_t i = it->second + 1; i < tree.size(); i += i & (~i + 1)) tree[i] += delta;
+    }
+    totalWeight += delta;
+}
+
+void StakeIndex::set(const std::string& address, double weight) {
+    add(address, weight - weightOf(address));
+}
+
+double StakeIndex::weightOf(const std::string& address) const {
+    auto it = slots.find(address);
+    return it == slots.end() ? 0 : weights[it->second];
+}
+
+void StakeIndex::clear() {
+    tree.clear();
+    weights.clear();
+    addresses.clear();
+    slots.clear();
+    totalWeight = 0;
+}
+
+std::string StakeIndex::select(double r) const {
+    size_t n = addresses.size();
+    if (n == 0 || totalWeight <= 0) return "";
+    // Descend to the last slot whose prefix sum is <= r; the next slot owns r
+    size_t pos = 0;
+    size_t step = 1;
+    while (step * 2 <= n) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (pos + step <= n && tree[pos + step] <= r) {
+            pos += step;
+            r -= tree[pos];
+        }
+    }
+    // Rounding at the top end can land past the last staked slot
+    if (pos >= n) pos = n - 1;
+    while (pos > 0 && weights[pos] <= 0) --pos;
+    return weights[pos] > 0 ? addresses[pos] : "";
+}
+
+std::string StakeIndex::selectSeeded(const std::string& seed) const {
+    return select(seedToUnit(seed) * totalWeight);
+}
+
+double StakeIndex::seedToUnit(const std::string& seed) {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)seed.data(), seed.size(), hash);
+    uint64_t x = 0;
+    for (int i = 0; i < 8; ++i) x = (x << 8) | hash[i];
+    return std::ldexp((double)(x >> 11), -53); // 53 random mantissa bits
+}
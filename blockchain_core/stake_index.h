@@ -0,0 +1,36 @@
+#ifndef STAKE_INDEX_H
+#define STAKE_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Stake-weighted sampling over a Fenwick (binary indexed) tree: weight updates,
+// prefix sums and weighted picks are all O(log n). Addresses keep the slot they
+// were first given, so two nodes that applied the same stake changes in the same
+// order pick the same address for the same seed.
+class StakeIndex {
+public:
+    void set(const std::string& address, double weight);
+    void add(const std::string& address, double delta);
+    double weightOf(const std::string& address) const;
+    double total() const { return totalWeight; }
+    size_t size() const { return addresses.size(); }
+    void clear();
+    // Address owning point r of [0, total()); empty when nothing is staked
+    std::string select(double r) const;
+    // Deterministic pick: r is derived from SHA256(seed), e.g. the previous block hash
+    std::string selectSeeded(const std::string& seed) const;
+    // Uniform [0, 1) from the first 8 bytes of SHA256(seed)
+    static double seedToUnit(const std::string& seed);
+private:
+    double prefixSum(size_t count) const; // sum of the first count slots
+    std::vector<double> tree;    // 1-based Fenwick array, tree[0] unused
+    std::vector<double> weights; // slot -> weight
+    std::vector<std::string> addresses;
+    std::unordered_map<std::string, size_t> slots; // address -> slot (0-based)
+    double totalWeight = 0;
+};
+
+#endif // STAKE_INDEX_H
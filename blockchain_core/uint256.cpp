@@ -0,0 +1,151 @@
+// Ahmiyat Blockchain - 256-bit proof-of-work targets
+
+#include "uint256.h"
+#include <algorithm>
+#include <cmath>
+
+Uint256::Uint256(uint64_t value) {
+    limbs[0] = (uint32_t)value;
+    limbs[1] = (uint32_t)(value >> 32);
+}
+
+Uint256 Uint256::fromHex(const std::string& hex) {
+    Uint256 result;
+    size_t digits = std::min<size_t>(hex.size(), 64);
+    for (size_t i = 0; i < digits; ++i) {
+        char c = hex[hex.size() - 1 - i];
+        uint32_t nibble = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 0;
+        result.limbs[i / 8] |= nibble << (4 * (i % 8));
+    }
+    return result;
+}
+
+std::string Uint256::toHex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(64, '0');
+    for (size_t i = 0; i < 64; ++i) hex[63 - i] = digits[(limbs[i / 8] >> (4 * (i % 8))) & 0xf];
+    return hex;
+}
+
+Uint256 Uint256::fromCompact(uint32_t compact) {
+    unsigned size = compact >> 24;
+    uint32_t mantissa = compact & 0x007fffff;
+    Uint256 result(mantissa);
+    if (size <= 3) {
+        result >>= 8 * (3 - size);
+    } else if (size <= 32) {
+        result <<= 8 * (size - 3);
+    } else {
+        return Uint256(); // does not fit in 256 bits
+    }
+    return result;
+}
+
+uint32_t Uint256::toCompact() const {
+    unsigned size = (bitLength() + 7) / 8;
+    uint32_t mantissa;
+    if (size <= 3) {
+        mantissa = limbs[0] << (8 * (3 - size));
+    } else {
+        Uint256 shifted = *this;
+        shifted >>= 8 * (size - 3);
+        mantissa = shifted.limbs[0];
+    }
+    // Keep the top mantissa bit clear (it is the sign bit in the compact format)
+    if (mantissa & 0x00800000) {
+        mantissa >>= 8;
+        ++size;
+    }
+    return mantissa | (size << 24);
+}
+
+// 2^(256 - 4 * zeros) - 1: the low 256 - 4 * zeros bits set
+Uint256 Uint256::fromLeadingZeros(int zeros) {
+    Uint256 result;
+    unsigned bits = 256 - 4 * std::min(std::max(zeros, 0), 64);
+    for (unsigned i = 0; i < 8; ++i) {
+        if (bits >= 32 * (i + 1)) result.limbs[i] = 0xffffffff;
+        else if (bits > 32 * i) result.limbs[i] = (1u << (bits - 32 * i)) - 1;
+    }
+    return result;
+}
+
+double Uint256::work() const {
+    double target = 0;
+    for (int i = 7; i >= 0; --i) target = target * 4294967296.0 + limbs[i];
+    return std::ldexp(1.0, 256) / (target + 1);
+}
+
+unsigned Uint256::bitLength() const {
+    for (int i = 7; i >= 0; --i) {
+        if (limbs[i]) {
+            unsigned bits = 32 * i;
+            for (uint32_t v = limbs[i]; v; v >>= 1) ++bits;
+            return bits;
+        }
+    }
+    return 0;
+}
+
+bool Uint256::isZero() const {
+    return bitLength() == 0;
+}
+
+Uint256& Uint256::operator<<=(unsigned shift) {
+    if (shift >= 256) return *this = Uint256();
+    unsigned words = shift / 32, bits = shift % 32;
+    for (int i = 7; i >= 0; --i) {
+        uint32_t value = i >= (int)words ? limbs[i - words] << bits : 0;
+        if (bits && i > (int)words) value |= limbs[i - words - 1] >> (32 - bits);
+        limbs[i] = value;
+    }
+    return *this;
+}
+
+Uint256& Uint256::operator>>=(unsigned shift) {
+    if (shift >= 256) return *this = Uint256();
+    unsigned words = shift / 32, bits = shift % 32;
+    for (unsigned i = 0; i < 8; ++i) {
+        uint32_t value = i + words < 8 ? limbs[i + words] >> bits : 0;
+        if (bits && i + words + 1 < 8) value |= limbs[i + words + 1] << (32 - bits);
+        limbs[i] = value;
+    }
+    return *this;
+}
+
+Uint256& Uint256::operator+=(const Uint256& other) {
+    uint64_t carry = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        uint64_t sum = (uint64_t)limbs[i] + other.limbs[i] + carry;
+        limbs[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+    return *this;
+}
+
+Uint256& Uint256::operator*=(uint32_t factor) {
+    uint64_t carry = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        uint64_t product = (uint64_t)limbs[i] * factor + carry;
+        limbs[i] = (uint32_t)product;
+        carry = product >> 32;
+    }
+    return *this;
+}
+
+Uint256& Uint256::operator/=(uint32_t divisor) {
+    uint64_t remainder = 0;
+    for (int i = 7; i >= 0; --i) {
+        uint64_t current = (remainder << 32) | limbs[i];
+        limbs[i] = (uint32_t)(current / divisor);
+        remainder = current % divisor;
+    }
+    return *this;
+}
+
+int Uint256::compare(const Uint256& other) const {
+    for (int i = 7; i >= 0; --i) {
+        if (limbs[i] != other.limbs[i]) return limbs[i] < other.limbs[i] ? -1 : 1;
+    }
+    return 0;
+}
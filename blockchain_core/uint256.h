@@ -0,0 +1,40 @@
+#ifndef UINT256_H
+#define UINT256_H
+
+#include <string>
+#include <cstdint>
+
+// Unsigned 256-bit integer for proof-of-work targets. Only the operations
+// retargeting needs: compact (nBits-style) encoding, hex parsing, shifts and
+// multiplication/division by machine words.
+class Uint256 {
+public:
+    Uint256() = default;
+    explicit Uint256(uint64_t value);
+    // 64 hex digits, most significant first (a block hash); shorter strings are left-padded
+    static Uint256 fromHex(const std::string& hex);
+    std::string toHex() const;
+    // Compact form: exponent byte (length in bytes) + 23-bit mantissa; the sign bit is unused
+    static Uint256 fromCompact(uint32_t compact);
+    uint32_t toCompact() const;
+    // Largest target a hash with `zeros` leading hex zeros meets (the legacy difficulty rule)
+    static Uint256 fromLeadingZeros(int zeros);
+    // Expected hashes to find a block at this target: 2^256 / (target + 1)
+    double work() const;
+    unsigned bitLength() const;
+    bool isZero() const;
+    Uint256& operator<<=(unsigned shift);
+    Uint256& operator>>=(unsigned shift);
+    Uint256& operator+=(const Uint256& other);
+    Uint256& operator*=(uint32_t factor); // overflow wraps
+    Uint256& operator/=(uint32_t divisor);
+    int compare(const Uint256& other) const;
+    bool operator<(const Uint256& other) const { return compare(other) < 0; }
+    bool operator>(const Uint256& other) const { return compare(other) > 0; }
+    bool operator<=(const Uint256& other) const { return compare(other) <= 0; }
+    bool operator==(const Uint256& other) const { return compare(other) == 0; }
+private:
+    uint32_t limbs[8] = {}; // little-endian 32-bit limbs
+};
+
+#endif // UINT256_H
@@ -0,0 +1,485 @@
+// Ahmiyat Blockchain - Mining work server and worker client
+
+#include "work_server.h"
+#include "uint256.h"
+#include "pow_kernel.h"
+#include <nlohmann/json.hpp>
+#include <openssl/sha.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <iostream>
+
+namespace {
+
+const int64_t kNonceRange = 1 << 22; // nonces handed to a worker at a time
+const size_t kKeptJobs = 8;
+const size_t kMaxLineBytes = 16 * 1024;      // longest request line a worker may send
+const size_t kMaxOutboxBytes = 1024 * 1024; // unsent bytes before a worker counts as stalled
+
+std::string toHex(const std::string& raw) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(raw.size() * 2);
+    for (unsigned char c : raw) {
+        hex.push_back(digits[c >> 4]);
+        hex.push_back(digits[c & 0xf]);
+    }
+    return hex;
+}
+
+std::string fromHex(const std::string& hex) {
+    auto nibble = [](char c) { return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10; };
+    std::string raw;
+    raw.reserve(hex.size() / 2);
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) raw.push_back((char)((nibble(hex[i]) << 4) | nibble(hex[i + 1])));
+    return raw;
+}
+
+std::string sha256Hex(const std::string& data) {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), hash);
+    return toHex(std::string(reinterpret_cast<char*>(hash), SHA256_DIGEST_LENGTH));
+}
+
+// Splits complete lines off the front of buffer
+std::vector<std::string> takeLines(std::string& buffer) {
+    std::vector<std::string> lines;
+    size_t start = 0, end;
+    while ((end = buffer.find('\n', start)) != std::string::npos) {
+        lines.push_back(buffer.substr(start, end - start));
+        start = end + 1;
+    }
+    buffer.erase(0, start);
+    return lines;
+}
+
+bool writeAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+} // namespace
+
+WorkServer::WorkServer(Blockchain& chain, const std::string& payoutAddress)
+    : chain(chain), payoutAddress(payoutAddress) {}
+
+WorkServer::~WorkServer() {
+    stop();
+}
+
+void WorkServer::setShareShift(unsigned shift) {
+    shareShift = std::min(shift, 64u);
+}
+
+bool WorkServer::start(int port, const std::string& bindAddress) {
+    if (running) return false;
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) return false;
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, bindAddress.c_str(), &addr.sin_addr) != 1 ||
+        bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 16) < 0) {
+        std::cerr << "Work server: cannot listen on " << bindAddress << ":" << port << std::endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    startedAt = std::chrono::steady_clock::now();
+    running = true;
+    serverThread = std::thread(&WorkServer::serverLoop, this);
+    return true;
+}
+
+void WorkServer::stop() {
+    running = false;
+    if (serverThread.joinable()) serverThread.join();
+    for (auto& [fd, worker] : workers) close(fd);
+    workers.clear();
+    if (listenFd >= 0) close(listenFd);
+    listenFd = -1;
+}
+
+WorkServerStats WorkServer::getStats() const {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    WorkServerStats result = stats;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startedAt).count();
+    result.hashRate = elapsed > 0 ? acceptedWork / elapsed : 0;
+    return result;
+}
+
+// One thread multiplexes the listener and every worker; a 250 ms poll timeout
+// doubles as the template staleness check
+void WorkServer::serverLoop() {
+    // Share checks and submitted-block validation run here, next to the P2P threads
+    chain.getThreadPlacement().pinReserved();
+    while (running) {
+        std::vector<pollfd> fds{{listenFd, POLLIN, 0}};
+        for (const auto& [fd, worker] : workers) fds.push_back({fd, (short)(POLLIN | (worker.outbox.empty() ? 0 : POLLOUT)), 0});
+        if (poll(fds.data(), fds.size(), 250) < 0) continue;
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                // Non-blocking, so one worker that stops reading cannot stall the others
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+                workers[fd].fd = fd;
+            }
+        }
+        for (size_t i = 1; i < fds.size(); ++i) {
+            auto it = workers.find(fds[i].fd);
+            if (it == workers.end()) continue;
+            Worker& worker = it->second;
+            if (fds[i].revents & POLLOUT) flush(worker);
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)) || worker.closing) continue;
+            char buffer[4096];
+            ssize_t n = recv(worker.fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+            if (n <= 0) {
+                worker.closing = true;
+                continue;
+            }
+            worker.inbox.append(buffer, n);
+            for (const auto& line : takeLines(worker.inbox)) handleLine(worker, line);
+            // Whatever is left has no newline yet; without a cap it could grow forever
+            if (worker.inbox.size() > kMaxLineBytes) {
+                std::cout << "[WORK] Disconnecting " << (worker.name.empty() ? "worker" : worker.name) << ": line too long" << std::endl;
+                worker.closing = true;
+            }
+        }
+        if (!lastTemplate || chain.templateStale(*lastTemplate)) {
+            refreshJob();
+            for (auto& [fd, worker] : workers) {
+                if (worker.subscribed && !worker.closing) sendJob(worker, true);
+            }
+        }
+        for (auto it = workers.begin(); it != workers.end();) {
+            if (!it->second.closing) {
+                ++it;
+                continue;
+            }
+            close(it->first);
+            it = workers.erase(it);
+        }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.workers = workers.size();
+    }
+}
+
+void WorkServer::refreshJob() {
+    lastTemplate = chain.getBlockTemplate();
+    if (lastTemplate->block.transactions.empty() && lastTemplate->block.contents.empty()) {
+        currentJob = 0;
+        return;
+    }
+    Job job;
+    job.id = nextJobId++;
+    job.tpl = lastTemplate;
+    job.header = lastTemplate->block;
+    job.header.timestamp = std::time(nullptr);
+    job.header.miner = payoutAddress;
+    job.prefix = Blockchain::headerPrefix(job.header);
+    job.suffix = Blockchain::headerSuffix(job.header, lastTemplate->bodyData);
+    job.prefixHex = toHex(job.prefix);
+    job.suffixHex = toHex(job.suffix);
+    Uint256 target = Uint256::fromCompact(job.header.bits);
+    job.target = target.toHex();
+    Uint256 shareTarget = Uint256::fromLeadingZeros(0);
+    if (target.bitLength() + shareShift <= 256) {
+        shareTarget = target;
+        shareTarget <<= shareShift;
+    }
+    job.shareTarget = shareTarget.toHex();
+    job.shareWork = shareTarget.work();
+    currentJob = job.id;
+    jobs[job.id] = std::move(job);
+    while (jobs.size() > kKeptJobs) jobs.erase(jobs.begin());
+}
+
+// Hands the worker the next unused nonce range; a job whose nonce space is used up
+// is replaced with a fresh timestamp
+void WorkServer::sendJob(Worker& worker, bool clean) {
+    if (currentJob != 0 && jobs[currentJob].nextNonce > INT_MAX - kNonceRange) {
+        refreshJob();
+        clean = true;
+    }
+    if (currentJob == 0) {
+        sendLine(worker, nlohmann::json{{"method", "idle"}}.dump());
+        return;
+    }
+    Job& job = jobs[currentJob];
+    nlohmann::json message = {{"method", "job"}, {"jobId", job.id}, {"prefix", job.prefixHex}, {"suffix", job.suffixHex},
+                              {"target", job.target}, {"shareTarget", job.shareTarget}, {"nonceStart", job.nextNonce},
+                              {"nonceEnd", job.nextNonce + kNonceRange}, {"clean", clean}};
+    // Ranges of jobs that have been dropped can no longer be submitted against
+    for (auto it = worker.ranges.begin(); it != worker.ranges.end();) {
+        it = jobs.count(it->first) ? std::next(it) : worker.ranges.erase(it);
+    }
+    worker.ranges[job.id].emplace_back(job.nextNonce, job.nextNonce + kNonceRange);
+    job.nextNonce += kNonceRange;
+    if (sendLine(worker, message.dump())) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        ++stats.jobs;
+    }
+}
+
+void WorkServer::handleLine(Worker& worker, const std::string& line) {
+    nlohmann::json message;
+    try {
+        message = nlohmann::json::parse(line);
+    } catch (...) {
+        return;
+    }
+    std::string method = message.value("method", "");
+    if (method == "subscribe") {
+        worker.name = message.value("worker", "worker-" + std::to_string(worker.fd));
+        worker.subscribed = true;
+        sendJob(worker, true);
+    } else if (method == "exhausted") {
+        sendJob(worker, false);
+    } else if (method == "submit") {
+        uint64_t jobId = message.value("jobId", (uint64_t)0);
+        int64_t nonce = message.value("nonce", (int64_t)0);
+        auto job = jobs.find(jobId);
+        auto ranges = worker.ranges.find(jobId);
+        // Only nonces from this worker's own ranges, so shares cannot be replayed across workers
+        bool assigned = ranges != worker.ranges.end() &&
+                        std::any_of(ranges->second.begin(), ranges->second.end(),
+                                    [nonce](const auto& range) { return nonce >= range.first && nonce < range.second; });
+        std::string reason;
+        std::string hash;
+        if (job == jobs.end()) {
+            reason = "unknown or expired job";
+        } else if (!assigned) {
+            reason = "nonce outside assigned range";
+        } else if (!worker.credited.insert({jobId, nonce}).second) {
+            reason = "duplicate share";
+        } else {
+            hash = sha256Hex(job->second.prefix + std::to_string(nonce) + job->second.suffix);
+            if (hash > job->second.shareTarget) reason = "above share target";
+        }
+        if (worker.credited.size() > 100000) worker.credited.clear();
+        bool shareOk = reason.empty();
+        bool isBlock = false;
+        if (shareOk) {
+            {
+                std::lock_guard<std::mutex> lock(statsMutex);
+                ++stats.sharesAccepted;
+                acceptedWork += job->second.shareWork;
+            }
+            if (hash <= job->second.target) {
+                Block block = job->second.header;
+                block.nonce = (int)nonce;
+                block.hash = hash;
+                isBlock = chain.submitBlock(block);
+                if (isBlock) {
+                    {
+                        std::lock_guard<std::mutex> lock(statsMutex);
+                        ++stats.blocksFound;
+                    }
+                    std::cout << "[WORK] Block " << block.index << " found by " << worker.name << std::endl;
+                } else {
+                    reason = "block rejected (stale tip)";
+                }
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            ++stats.sharesRejected;
+        }
+        sendLine(worker, nlohmann::json{{"method", "result"}, {"accepted", shareOk},
+                                        {"block", isBlock}, {"reason", reason}}.dump());
+    }
+}
+
+bool WorkServer::sendLine(Worker& worker, const std::string& line) {
+    if (worker.closing) return false;
+    if (worker.outbox.size() + line.size() + 1 > kMaxOutboxBytes) {
+        std::cout << "[WORK] Disconnecting " << (worker.name.empty() ? "worker" : worker.name) << ": not reading its jobs" << std::endl;
+        worker.closing = true;
+        return false;
+    }
+    worker.outbox += line;
+    worker.outbox += '\n';
+    flush(worker);
+    return !worker.closing;
+}
+
+// Sends as much of the outbox as the socket takes; the rest waits for POLLOUT
+void WorkServer::flush(Worker& worker) {
+    while (!worker.outbox.empty()) {
+        ssize_t n = send(worker.fd, worker.outbox.data(), worker.outbox.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            worker.outbox.erase(0, n);
+        } else {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) worker.closing = true;
+            return;
+        }
+    }
+}
+
+// --- Worker client ---
+
+namespace {
+
+struct WorkerJob {
+    uint64_t id = 0;
+    std::string prefix;
+    std::string suffix;
+    std::string target;
+    std::string shareTarget;
+    int64_t nonceStart = 0;
+    int64_t nonceEnd = 0;
+};
+
+} // namespace
+
+int runMiningWorker(const std::string& host, int port, unsigned threads, const std::string& name, const ThreadPlacement& placement) {
+    if (threads == 0) threads = (unsigned)placement.miningSet().size();
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    addrinfo hints{}, *result = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0 || !result) {
+        std::cerr << "Cannot resolve " << host << std::endl;
+        return 0;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    bool connected = fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) == 0;
+    freeaddrinfo(result);
+    if (!connected) {
+        std::cerr << "Cannot connect to " << host << ":" << port << std::endl;
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    std::mutex sendMutex;
+    auto sendMessage = [&](const nlohmann::json& message) {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        writeAll(fd, message.dump() + "\n");
+    };
+
+    // The reader publishes jobs; hashers pick up a new generation and drop the old one
+    std::mutex jobMutex;
+    std::condition_variable jobChanged;
+    WorkerJob job;
+    std::atomic<uint64_t> generation{0};
+    std::atomic<unsigned> finished{0};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> hashes{0};
+    auto hasher = [&](unsigned index) {
+        // Pinned before the first job copy, so each thread's buffers are NUMA-local
+        placement.pinMiningWorker(index);
+        uint64_t seen = 0;
+        while (!stop) {
+            WorkerJob current;
+            {
+                std::unique_lock<std::mutex> lock(jobMutex);
+                jobChanged.wait(lock, [&] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+                current = job;
+            }
+            // Each thread takes an equal slice of the range
+            int64_t span = (current.nonceEnd - current.nonceStart + threads - 1) / threads;
+            int64_t begin = current.nonceStart + span * index;
+            int64_t end = std::min(current.nonceEnd, begin + span);
+            PowSearcher searcher(current.prefix, current.suffix, current.shareTarget);
+            for (int64_t nonce = begin; nonce < end;) {
+                int64_t chunkEnd = std::min(end, nonce + 0x1000), found = 0;
+                uint64_t count = 0;
+                if (searcher.search(nonce, chunkEnd, &found, &count)) {
+                    sendMessage({{"method", "submit"}, {"jobId", current.id}, {"nonce", found}});
+                    nonce = found + 1;
+                } else {
+                    nonce = chunkEnd;
+                }
+                hashes += count;
+                if (stop || generation != seen) break;
+            }
+            // The last thread through an untouched range asks for more
+            if (current.nonceEnd > current.nonceStart && generation == seen && ++finished == threads) sendMessage({{"method", "exhausted"}, {"jobId", current.id}});
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(hasher, t);
+    sendMessage({{"method", "subscribe"}, {"worker", name}});
+    std::cout << "Mining for " << host << ":" << port << " on " << threads << " threads as " << name
+              << ", placement: " << placement.describe() << std::endl;
+
+    int blocks = 0;
+    uint64_t accepted = 0, rejected = 0;
+    auto lastReport = std::chrono::steady_clock::now();
+    uint64_t lastHashes = 0;
+    std::string inbox;
+    char buffer[65536];
+    for (;;) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        inbox.append(buffer, n);
+        for (const auto& line : takeLines(inbox)) {
+            nlohmann::json message;
+            try {
+                message = nlohmann::json::parse(line);
+            } catch (...) {
+                continue;
+            }
+            std::string method = message.value("method", "");
+            if (method == "job") {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                job.id = message["jobId"];
+                job.prefix = fromHex(message["prefix"]);
+                job.suffix = fromHex(message["suffix"]);
+                job.target = message["target"];
+                job.shareTarget = message["shareTarget"];
+                job.nonceStart = message["nonceStart"];
+                job.nonceEnd = message["nonceEnd"];
+                finished = 0;
+                ++generation;
+                jobChanged.notify_all();
+            } else if (method == "idle") {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                job.nonceStart = job.nonceEnd = 0; // empty range: hashers wait for the next job
+                finished = 0;
+                ++generation;
+                jobChanged.notify_all();
+            } else if (method == "result") {
+                if (message.value("accepted", false)) ++accepted;
+                else ++rejected;
+                if (message.value("block", false)) {
+                    ++blocks;
+                    std::cout << "Block found!" << std::endl;
+                }
+            }
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastReport).count();
+        if (elapsed >= 10) {
+            std::cout << "Hashrate " << (hashes - lastHashes) / elapsed << " H/s, shares " << accepted << " accepted / "
+                      << rejected << " rejected, blocks " << blocks << std::endl;
+            lastHashes = hashes;
+            lastReport = std::chrono::steady_clock::now();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stop = true;
+        jobChanged.notify_all();
+    }
+    for (auto& t : pool) t.join();
+    close(fd);
+    std::cout << "Disconnected: " << accepted << " shares accepted, " << rejected << " rejected, " << blocks << " blocks" << std::endl;
+    return blocks;
+}
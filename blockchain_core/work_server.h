@@ -0,0 +1,105 @@
+#ifndef WORK_SERVER_H
+#define WORK_SERVER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "blockchain.h"
+
+struct WorkServerStats {
+    size_t workers = 0;
+    uint64_t jobs = 0;           // job messages sent, refreshes and new ranges included
+    uint64_t sharesAccepted = 0;
+    uint64_t sharesRejected = 0; // unknown job, duplicate or above the share target
+    uint64_t blocksFound = 0;
+    double hashRate = 0;         // estimated from accepted share work
+};
+
+// Stratum-style work distribution: newline-delimited JSON over TCP. Each worker
+// receives the current template as a hex header prefix and suffix, the block
+// target, an easier share target and its own nonce range; the block hash is
+// SHA256(prefix + decimal nonce + suffix). Shares measure each worker's hash
+// power, and a share that also meets the block target is connected as a block.
+// Jobs are re-pushed whenever the tip or the pending pools change. Sockets are
+// non-blocking; a worker sending an overlong line, or not reading its jobs, is
+// disconnected, and shares are only credited for nonces from its own ranges.
+//
+//   worker -> server  {"method":"subscribe","worker":name}
+//                     {"method":"submit","jobId":id,"nonce":n}
+//                     {"method":"exhausted","jobId":id}   (asks for a new range)
+//   server -> worker  {"method":"job","jobId":id,"prefix":hex,"suffix":hex,"target":hex,
+//                      "shareTarget":hex,"nonceStart":a,"nonceEnd":b,"clean":bool}
+//                     {"method":"idle"}                   (nothing pending to mine)
+//                     {"method":"result","accepted":bool,"block":bool,"reason":text}
+class WorkServer {
+public:
+    WorkServer(Blockchain& chain, const std::string& payoutAddress);
+    ~WorkServer();
+    // Binds to loopback by default; pass "0.0.0.0" to serve other hosts
+    bool start(int port, const std::string& bindAddress = "127.0.0.1");
+    void stop();
+    WorkServerStats getStats() const;
+    // Share target = block target << shift (default 8, i.e. 256x easier)
+    void setShareShift(unsigned shift);
+private:
+    struct Job {
+        uint64_t id = 0;
+        BlockTemplatePtr tpl;
+        Block header; // template block with timestamp and payout address filled in
+        std::string prefixHex;
+        std::string suffixHex;
+        std::string prefix; // raw, for checking submissions
+        std::string suffix;
+        std::string target;
+        std::string shareTarget;
+        double shareWork = 0; // expected hashes per share
+        int64_t nextNonce = 1;
+    };
+    struct Worker {
+        int fd = -1;
+        std::string name;
+        std::string inbox;  // bytes received after the last complete line
+        std::string outbox; // queued bytes the socket has not taken yet
+        bool subscribed = false;
+        bool closing = false; // dropped at the end of the current loop pass
+        std::map<uint64_t, std::vector<std::pair<int64_t, int64_t>>> ranges; // job -> [start, end) handed out
+        std::set<std::pair<uint64_t, int64_t>> credited; // (job, nonce) already counted
+    };
+    void serverLoop();
+    void refreshJob();
+    void sendJob(Worker& worker, bool clean);
+    void handleLine(Worker& worker, const std::string& line);
+    // Queues a line and sends what the socket takes now; never blocks the server thread
+    bool sendLine(Worker& worker, const std::string& line);
+    void flush(Worker& worker);
+    Blockchain& chain;
+    std::string payoutAddress;
+    unsigned shareShift = 8;
+    int listenFd = -1;
+    std::atomic<bool> running{false};
+    std::thread serverThread;
+    // Owned by the server thread
+    std::map<int, Worker> workers;
+    std::map<uint64_t, Job> jobs; // current job and a few predecessors, for late shares
+    uint64_t currentJob = 0;      // 0 while there is nothing to mine
+    uint64_t nextJobId = 1;
+    BlockTemplatePtr lastTemplate;
+    std::chrono::steady_clock::time_point startedAt;
+    mutable std::mutex statsMutex;
+    WorkServerStats stats;
+    double acceptedWork = 0;
+};
+
+// Connects to a work server and hashes its jobs on `threads` threads (0 = one per
+// mining CPU) until the connection closes, pinning each to the placement's mining
+// set. Returns the number of blocks found.
+int runMiningWorker(const std::string& host, int port, unsigned threads, const std::string& name,
+                    const ThreadPlacement& placement = ThreadPlacement());
+
+#endif // WORK_SERVER_H
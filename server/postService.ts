@@ -20,7 +20,22 @@ export class PostService {
     } catch (err) {
       throw new Error('Blockchain core error: ' + err);
     }
-    return { ...postData, coinsEarned: reward, blockchainResult };
+    // Uploads are batched: the receipt is immediate, confirmation comes with the sealed block
+    const blockchainStatus = /block mined/.test(blockchainResult) ? 'confirmed' : 'pending';
+    return { ...postData, coinsEarned: reward, blockchainResult, blockchainHash: hash, blockchainStatus };
+  }
+
+  static async getContentStatus(hash: string) {
+    const output = await callBlockchainCore(['content-status', hash]);
+    const confirmed = output.match(/confirmed at height (\d+) \((\d+) confirmations\)/);
+    if (confirmed) {
+      return { hash, status: 'confirmed', height: parseInt(confirmed[1]), confirmations: parseInt(confirmed[2]) };
+    }
+    const pending = output.match(/pending \(position (\d+) of (\d+)\)/);
+    if (pending) {
+      return { hash, status: 'pending', position: parseInt(pending[1]), batchSize: parseInt(pending[2]) };
+    }
+    return { hash, status: 'unknown' };
   }
 
   static async toggleLike(userId: string, postId: number) {
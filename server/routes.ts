@@ -186,11 +186,11 @@ export async function registerRoutes(app: Express): Promise<Server> {
   app.post('/api/blockchain/mine', async (req: any, res) => {
     try {
       const userId = req.user.claims.sub;
-      // Mining is handled automatically when content is added, but you can trigger a mine if needed
-      // For this, just call explorer to show latest state
+      // Uploads are batched; this seals whatever is pending right away
       const { callBlockchainCore } = await import('./blockchain');
       let explorerOutput = '';
       try {
+        await callBlockchainCore(['seal-contents', userId, '--force']);
         explorerOutput = await callBlockchainCore(['explorer']);
       } catch (err) {
         console.error('Blockchain explorer error:', err);
@@ -203,6 +203,58 @@ export async function registerRoutes(app: Express): Promise<Server> {
     }
   });
 
+  app.get('/api/blockchain/content/:hash/status', async (req: any, res) => {
+    try {
+      const status = await PostService.getContentStatus(req.params.hash);
+      res.json(status);
+    } catch (error) {
+      console.error("Error fetching content status:", error);
+      res.status(500).json({ message: "Failed to fetch content status" });
+    }
+  });
+
+  // Mempool and pending content queries; the core prints JSON for these commands
+  const queryCore = async (args: string[], res: any, failure: string) => {
+    try {
+      const { callBlockchainCore } = await import('./blockchain');
+      res.json(JSON.parse(await callBlockchainCore(args)));
+    } catch (error) {
+      console.error(failure + ":", error);
+      res.status(500).json({ message: failure });
+    }
+  };
+
+  app.get('/api/blockchain/mempool', async (req: any, res) => {
+    await queryCore(['mempool-info'], res, "Failed to fetch mempool summary");
+  });
+
+  app.get('/api/blockchain/mempool/transactions', async (req: any, res) => {
+    const order = req.query.order === 'time' ? 'time' : 'fee';
+    const offset = Math.max(0, parseInt(req.query.offset as string) || 0);
+    const limit = Math.min(500, Math.max(1, parseInt(req.query.limit as string) || 50));
+    await queryCore(['mempool-list', order, offset.toString(), limit.toString()], res, "Failed to fetch mempool transactions");
+  });
+
+  app.get('/api/blockchain/mempool/tx/:txid', async (req: any, res) => {
+    try {
+      const { callBlockchainCore } = await import('./blockchain');
+      res.json(JSON.parse(await callBlockchainCore(['mempool-tx', req.params.txid])));
+    } catch (error) {
+      // The core exits non-zero when the txid is not pending
+      res.status(404).json({ message: "Transaction not in mempool" });
+    }
+  });
+
+  app.get('/api/blockchain/mempool/sender/:address', async (req: any, res) => {
+    await queryCore(['mempool-sender', req.params.address], res, "Failed to fetch sender transactions");
+  });
+
+  app.get('/api/blockchain/pending-contents', async (req: any, res) => {
+    const offset = Math.max(0, parseInt(req.query.offset as string) || 0);
+    const limit = Math.min(500, Math.max(1, parseInt(req.query.limit as string) || 50));
+    await queryCore(['pending-contents', offset.toString(), limit.toString()], res, "Failed to fetch pending contents");
+  });
+
   app.get('/api/blockchain/info', async (req: any, res) => {
     try {
       const { callBlockchainCore } = await import('./blockchain');
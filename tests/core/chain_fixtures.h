@@ -0,0 +1,74 @@
+#ifndef CHAIN_FIXTURES_H
+#define CHAIN_FIXTURES_H
+
+#include "blockchain.h"
+#include "ecdsa_utils.h"
+#include <nlohmann/json.hpp>
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+// Helpers for tests driving a throwaway in-memory chain
+struct TestWallet {
+    std::string privPem;
+    std::string pubPem;
+    std::string address;
+};
+
+inline TestWallet makeWallet() {
+    TestWallet wallet;
+    ECDSAUtils::generateKeyPair(wallet.privPem, wallet.pubPem);
+    wallet.address = Wallet::publicKeyToAddress(wallet.pubPem);
+    return wallet;
+}
+
+inline Transaction signedTx(const TestWallet& from, const std::string& to, double amount, double fee, uint64_t nonce) {
+    Transaction tx = {from.address, to, amount, "", from.pubPem, fee, nonce};
+    tx.signature = ECDSAUtils::sign(Blockchain::txSigningData(tx), from.privPem);
+    return tx;
+}
+
+// Fresh on-disk database in the working directory, for tests that reopen a chain
+inline std::string freshDbPath(const std::string& tag) {
+    std::string path = "test_" + tag + ".db";
+    std::remove(path.c_str());
+    return path;
+}
+
+inline Content testContent(const std::string& tag, const std::string& uploader) {
+    return {"image", tag + ".png", uploader, "hash-" + tag, std::time(nullptr), ""};
+}
+
+// Queues one upload and mines it (plus anything else pending) as miner
+inline bool mineContentBlock(Blockchain& chain, const std::string& miner, const std::string& tag) {
+    return chain.addContent(testContent(tag, miner), miner) && chain.mineBlock(miner);
+}
+
+// The "block" gossip message handleP2PMessage expects
+inline std::string blockMessage(const Block& block) {
+    nlohmann::json j;
+    j["type"] = "block";
+    j["index"] = block.index;
+    j["prevHash"] = block.prevHash;
+    j["hash"] = block.hash;
+    j["merkleRoot"] = block.merkleRoot;
+    j["timestamp"] = block.timestamp;
+    j["miner"] = block.miner;
+    j["nonce"] = block.nonce;
+    j["difficulty"] = block.difficulty;
+    j["bits"] = block.bits;
+    j["transactions"] = nlohmann::json::array();
+    for (const auto& tx : block.transactions) {
+        j["transactions"].push_back({{"sender", tx.sender}, {"receiver", tx.receiver}, {"amount", tx.amount},
+                                     {"signature", tx.signature}, {"publicKeyPem", tx.publicKeyPem},
+                                     {"fee", tx.fee}, {"nonce", tx.nonce}});
+    }
+    j["contents"] = nlohmann::json::array();
+    for (const auto& c : block.contents) {
+        j["contents"].push_back({{"type", c.type}, {"filename", c.filename}, {"uploader", c.uploader},
+                                 {"hash", c.hash}, {"timestamp", c.timestamp}, {"publicKeyPem", c.publicKeyPem}});
+    }
+    return j.dump();
+}
+
+#endif // CHAIN_FIXTURES_H
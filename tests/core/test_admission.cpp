@@ -0,0 +1,93 @@
+// Per-sender nonces and pending debits at admission, and transaction checks on peer blocks
+#include "test_harness.h"
+#include "chain_fixtures.h"
+
+TEST(noncesMustContinueThePendingSequence) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 10);
+    CHECK(!chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 2)));
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 1)));
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 2)));
+    CHECK_EQ(chain.getNextNonce(alice.address), (uint64_t)3);
+    CHECK(!chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 0)));
+}
+
+TEST(pendingDebitsLimitFurtherSpending) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 10);
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 6, 0.01, 1)));
+    CHECK(!chain.addTransaction(signedTx(alice, "bob", 6, 0.01, 2)));
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 3, 0.01, 2)));
+}
+
+TEST(stakingCannotTakeFundsOwedToPendingTransactions) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 10);
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 6, 0.01, 1)));
+    CHECK(!chain.stake(alice.address, 6));
+    CHECK(chain.stake(alice.address, 3));
+}
+
+TEST(confirmedNonceAdvancesWithMinedBlocks) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 10);
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 1)));
+    CHECK(chain.mineBlock("miner"));
+    CHECK(chain.getMempool().empty());
+    CHECK(!chain.addTransaction(signedTx(alice, "bob", 1, 0.02, 1))); // already confirmed
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 2)));
+    CHECK_NEAR(chain.getBalance(alice.address), 10 - 1.01, 1e-9);
+}
+
+// theirs credits alice outside consensus, so her spend is only fundable there
+static Block unfundedSpendBlock(Blockchain& theirs, const TestWallet& alice) {
+    theirs.creditBalance(alice.address, 100);
+    CHECK(theirs.addTransaction(signedTx(alice, "bob", 50, 0.01, 1)));
+    CHECK(theirs.mineBlock("miner"));
+    return *theirs.tip();
+}
+
+TEST(peerBlockWithUnfundedSpendIsRejected) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    TestWallet alice = makeWallet();
+    Block block = unfundedSpendBlock(theirs, alice);
+    ours.handleP2PMessage(blockMessage(block), "peer");
+    CHECK_EQ(ours.getHeight(), 0);
+    CHECK_NEAR(ours.getBalance("bob"), 0.0, 1e-9);
+}
+
+TEST(validPeerBlockIsConnected) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    TestWallet alice = makeWallet();
+    CHECK(mineContentBlock(theirs, alice.address, "seed"));
+    ours.handleP2PMessage(blockMessage(*theirs.tip()), "peer");
+    CHECK(theirs.addTransaction(signedTx(alice, "bob", 0.5, 0.01, 1)));
+    CHECK(theirs.mineBlock("miner"));
+    ours.handleP2PMessage(blockMessage(*theirs.tip()), "peer");
+    CHECK_EQ(ours.getHeight(), 2);
+    CHECK_NEAR(ours.getBalance("bob"), 0.5, 1e-9);
+}
+
+TEST(forkWithUnfundedSpendIsRejectedAndStateKept) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    TestWallet alice = makeWallet();
+    CHECK(mineContentBlock(ours, "carol", "ours"));
+    unfundedSpendBlock(theirs, alice);
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(theirs, "miner", "t" + std::to_string(i)));
+    std::map<std::string, double> before = ours.getBalances();
+    std::string tipHash = ours.tip()->hash;
+    CHECK(!ours.resolveFork(theirs.getChain()));
+    CHECK_EQ(ours.tip()->hash, tipHash);
+    CHECK(ours.getBalances() == before);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,89 @@
+// Background block producer: lifecycle, PoW mining and DPoS slot filling
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include <chrono>
+#include <thread>
+
+// Polls for up to `seconds` until the chain reaches height
+static bool waitForHeight(const Blockchain& chain, int height, int seconds) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (chain.getHeight() < height) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return true;
+}
+
+TEST(producerStartsOnceAndStops) {
+    Blockchain chain(":memory:");
+    CHECK(chain.startBlockProducer("miner"));
+    CHECK(!chain.startBlockProducer("miner"));
+    CHECK(chain.getBlockProducerStats().running);
+    chain.stopBlockProducer();
+    CHECK(!chain.getBlockProducerStats().running);
+    chain.stopBlockProducer();
+    CHECK(chain.startBlockProducer("miner"));
+    chain.stopBlockProducer();
+}
+
+TEST(powProducerMinesWhatArrives) {
+    Blockchain chain(":memory:");
+    CHECK(chain.startBlockProducer("miner"));
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    CHECK(waitForHeight(chain, 1, 30));
+    CHECK(chain.addContent(testContent("b", "u"), "u"));
+    CHECK(waitForHeight(chain, 2, 30));
+    chain.stopBlockProducer();
+    BlockProducerStats stats = chain.getBlockProducerStats();
+    CHECK_EQ(stats.blocks, (uint64_t)2);
+    CHECK(stats.lastBlockAt > 0);
+    CHECK_EQ(chain.tip()->miner, std::string("miner"));
+}
+
+TEST(idleProducerSealsNothing) {
+    Blockchain chain(":memory:");
+    CHECK(chain.startBlockProducer("miner"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    chain.stopBlockProducer();
+    CHECK_EQ(chain.getHeight(), 0);
+    CHECK_EQ(chain.getBlockProducerStats().blocks, (uint64_t)0);
+}
+
+static void singleDelegate(Blockchain& chain) {
+    chain.setConsensusMode(ConsensusMode::DPoS);
+    chain.setDPoSParams(1, 1, 1);
+    chain.creditBalance("alice", 10);
+    CHECK(chain.delegateStake("alice", "alice", 10));
+}
+
+TEST(dposProducerFillsItsOwnSlots) {
+    Blockchain chain(":memory:");
+    singleDelegate(chain);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    CHECK(chain.startBlockProducer("alice"));
+    CHECK(waitForHeight(chain, 1, 5));
+    chain.stopBlockProducer();
+    CHECK_EQ(chain.tip()->miner, std::string("alice"));
+    CHECK(chain.verifyBlockProducer(1));
+}
+
+TEST(dposProducerSkipsOtherDelegatesSlots) {
+    Blockchain chain(":memory:");
+    singleDelegate(chain);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    CHECK(chain.startBlockProducer("bob"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    chain.stopBlockProducer();
+    CHECK_EQ(chain.getHeight(), 0);
+}
+
+// Would hang or terminate if the destructor left the thread running
+TEST(destructorStopsARunningProducer) {
+    Blockchain chain(":memory:");
+    singleDelegate(chain);
+    CHECK(chain.startBlockProducer("alice"));
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,91 @@
+// Block templates: limits, reuse, and what the block hash and merkle root commit to
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include <openssl/sha.h>
+#include <iomanip>
+#include <sstream>
+
+static std::string sha256Hex(const std::string& data) {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)data.data(), data.size(), hash);
+    std::stringstream out;
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i) out << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    return out.str();
+}
+
+static Block blockWith(const Transaction& tx) {
+    Block block;
+    block.index = 1;
+    block.prevHash = "parent";
+    block.timestamp = 1700000000;
+    block.miner = "miner";
+    block.nonce = 0;
+    block.difficulty = 1;
+    block.transactions = {tx};
+    return block;
+}
+
+TEST(feeAndNonceAreCommitted) {
+    Blockchain chain(":memory:");
+    Transaction tx = {"alice", "bob", 1.0, "sig", "pub", 0.01, 1};
+    Transaction bumpedFee = tx;
+    bumpedFee.fee = 0.02;
+    Transaction otherNonce = tx;
+    otherNonce.nonce = 2;
+    for (const Transaction& changed : {bumpedFee, otherNonce}) {
+        CHECK(Blockchain::txSigningData(changed) != Blockchain::txSigningData(tx));
+        CHECK(chain.calculateMerkleRoot({changed}) != chain.calculateMerkleRoot({tx}));
+        CHECK(chain.calculateHash(blockWith(changed)) != chain.calculateHash(blockWith(tx)));
+    }
+}
+
+TEST(legacyTransactionsKeepTheirPreimages) {
+    Blockchain chain(":memory:");
+    Transaction legacy = {"alice", "bob", 1.0, "sig", "pub", 0, 0};
+    CHECK_EQ(Blockchain::txSigningData(legacy), std::string("alicebob") + std::to_string(1.0));
+    CHECK_EQ(chain.calculateMerkleRoot({legacy}),
+             sha256Hex("alicebob" + std::to_string(1.0) + "sigpub"));
+}
+
+TEST(templateHonoursTransactionLimit) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 100);
+    for (uint64_t n = 1; n <= 5; ++n) CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, n)));
+    chain.setBlockLimits(1024 * 1024, 3, 500);
+    BlockTemplatePtr tpl = chain.getBlockTemplate();
+    CHECK_EQ(tpl->block.transactions.size(), (size_t)3);
+    CHECK_EQ(tpl->block.transactions[0].nonce, (uint64_t)1);
+    CHECK(chain.mineBlock("miner"));
+    CHECK_EQ(chain.getMempool().size(), (size_t)2);
+}
+
+TEST(templateHonoursByteLimit) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 100);
+    for (uint64_t n = 1; n <= 4; ++n) CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, n)));
+    size_t oneTx = Mempool::txSize(chain.getMempool()[0]);
+    chain.setBlockLimits(oneTx * 2 + oneTx / 2, 2000, 500);
+    BlockTemplatePtr tpl = chain.getBlockTemplate();
+    CHECK_EQ(tpl->block.transactions.size(), (size_t)2);
+    CHECK(tpl->txBytes <= oneTx * 2 + oneTx / 2);
+}
+
+TEST(templateIsReusedUntilPoolsChange) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 100);
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 1)));
+    BlockTemplatePtr first = chain.getBlockTemplate();
+    CHECK(chain.getBlockTemplate().get() == first.get());
+    CHECK(!chain.templateStale(*first));
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 2)));
+    CHECK(chain.templateStale(*first));
+    CHECK(chain.getBlockTemplate().get() != first.get());
+    CHECK_EQ(first->bodyData.empty(), false);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,57 @@
+// Rolling bloom filter behind replay detection
+#include "test_harness.h"
+#include "bloom_filter.h"
+#include "chain_fixtures.h"
+
+TEST(recentKeysAreAlwaysFound) {
+    RollingBloomFilter filter(1000, 0.001);
+    for (int i = 0; i < 1000; ++i) filter.insert("tx" + std::to_string(i));
+    // The last capacity/2 keys are guaranteed to be in a live generation
+    for (int i = 500; i < 1000; ++i) CHECK(filter.mayContain("tx" + std::to_string(i)));
+}
+
+TEST(falsePositiveRateStaysNearTarget) {
+    RollingBloomFilter filter(10000, 0.01);
+    for (int i = 0; i < 10000; ++i) filter.insert("in" + std::to_string(i));
+    int hits = 0;
+    for (int i = 0; i < 10000; ++i) hits += filter.mayContain("out" + std::to_string(i));
+    CHECK(hits < 300); // 1% target, generous slack for two live generations
+}
+
+TEST(oldKeysAgeOut) {
+    RollingBloomFilter filter(100, 0.001);
+    filter.insert("old");
+    for (int i = 0; i < 200; ++i) filter.insert("k" + std::to_string(i));
+    CHECK(!filter.mayContain("old"));
+}
+
+TEST(memoryIsFixedAndClearForgets) {
+    RollingBloomFilter filter(1000, 0.001);
+    size_t usage = filter.memoryUsage();
+    for (int i = 0; i < 5000; ++i) filter.insert("k" + std::to_string(i));
+    CHECK_EQ(filter.memoryUsage(), usage);
+    filter.clear();
+    CHECK(!filter.mayContain("k4999"));
+}
+
+TEST(confirmedTxStaysRejectedAfterReopen) {
+    std::string path = freshDbPath("replay");
+    TestWallet alice = makeWallet();
+    Transaction tx = signedTx(alice, "bob", 1, 0.01, 1);
+    {
+        Blockchain chain(path);
+        chain.loadFromDb();
+        chain.creditBalance(alice.address, 10);
+        CHECK(chain.addTransaction(tx));
+        CHECK(chain.mineBlock("miner"));
+        CHECK(chain.saveToDb());
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    reopened.creditBalance(alice.address, 10);
+    CHECK(!reopened.addTransaction(tx));
+}
+
+int main() {
+    return runTests();
+}
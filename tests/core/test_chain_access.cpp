@@ -0,0 +1,62 @@
+// Zero-copy block accessors and state snapshots
+#include "test_harness.h"
+#include "chain_fixtures.h"
+
+TEST(blockAtSharesTheStoredBlock) {
+    Blockchain chain(":memory:");
+    CHECK(mineContentBlock(chain, "miner", "a"));
+    BlockPtr first = chain.blockAt(1);
+    BlockPtr again = chain.blockAt(1);
+    CHECK(first != nullptr);
+    CHECK(first.get() == again.get());
+    CHECK(chain.tip().get() == first.get());
+    CHECK(chain.blockAt(2) == nullptr);
+    CHECK(chain.blockAt(-1) == nullptr);
+}
+
+TEST(heldBlocksSurviveChainGrowth) {
+    Blockchain chain(":memory:");
+    CHECK(mineContentBlock(chain, "miner", "a"));
+    BlockPtr held = chain.tip();
+    std::string hash = held->hash;
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(chain, "miner", "b" + std::to_string(i)));
+    CHECK_EQ(held->hash, hash);
+    CHECK_EQ(chain.getHeight(), 4);
+    CHECK(chain.blockAt(1).get() == held.get());
+}
+
+TEST(blocksInRangeIsInclusiveAndClamped) {
+    Blockchain chain(":memory:");
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(chain, "miner", "r" + std::to_string(i)));
+    std::vector<BlockPtr> range = chain.blocksInRange(1, 2);
+    CHECK_EQ(range.size(), (size_t)2);
+    if (range.size() == 2) {
+        CHECK_EQ(range[0]->index, 1);
+        CHECK_EQ(range[1]->index, 2);
+    }
+    CHECK_EQ(chain.blocksInRange(2, 100).size(), (size_t)2);
+}
+
+TEST(getChainIsADeepCopy) {
+    Blockchain chain(":memory:");
+    CHECK(mineContentBlock(chain, "miner", "a"));
+    std::vector<Block> copy = chain.getChain();
+    CHECK_EQ(copy.size(), (size_t)2);
+    copy[1].hash = "changed";
+    CHECK(chain.blockAt(1)->hash != "changed");
+}
+
+TEST(snapshotIsAStablePointInTimeView) {
+    Blockchain chain(":memory:");
+    CHECK(mineContentBlock(chain, "miner", "a"));
+    StateSnapshotPtr before = chain.snapshot();
+    CHECK(mineContentBlock(chain, "miner", "b"));
+    StateSnapshotPtr after = chain.snapshot();
+    CHECK_EQ(before->chain.size(), (size_t)2);
+    CHECK_EQ(after->chain.size(), (size_t)3);
+    CHECK(after->version > before->version);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,41 @@
+// Cumulative-work fork choice and cached per-block chainwork
+#include "test_harness.h"
+#include "chain_fixtures.h"
+
+TEST(chainWorkIsTheSumOfBlockWork) {
+    Blockchain chain(":memory:");
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(chain, "miner", "c" + std::to_string(i)));
+    double sum = 0;
+    for (int h = 0; h <= chain.getHeight(); ++h) {
+        BlockPtr block = chain.blockAt(h);
+        sum += Blockchain::blockWork(*block);
+        CHECK_NEAR(block->chainWork, sum, 1e-6 * sum);
+    }
+    CHECK_NEAR(chain.getChainWork(), sum, 1e-6 * sum);
+}
+
+TEST(forkWithLessWorkIsRejected) {
+    Blockchain chain(":memory:");
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(chain, "miner", "l" + std::to_string(i)));
+    std::vector<Block> shorter = chain.getChain();
+    shorter.pop_back();
+    std::string tipHash = chain.tip()->hash;
+    CHECK(!chain.resolveFork(shorter));
+    CHECK_EQ(chain.tip()->hash, tipHash);
+}
+
+TEST(forkWithMoreWorkIsAdopted) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    CHECK(mineContentBlock(ours, "alice", "o0"));
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(theirs, "bob", "t" + std::to_string(i)));
+    CHECK(theirs.getChainWork() > ours.getChainWork());
+    CHECK(ours.resolveFork(theirs.getChain()));
+    CHECK_EQ(ours.tip()->hash, theirs.tip()->hash);
+    CHECK_NEAR(ours.getChainWork(), theirs.getChainWork(), 1e-6 * theirs.getChainWork());
+    CHECK_NEAR(ours.getBalance("alice"), 0.0, 1e-9);
+}
+
+int main() {
+    return runTests();
+}
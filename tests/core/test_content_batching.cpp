@@ -0,0 +1,89 @@
+// Uploads sealed together into shared blocks
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include <chrono>
+#include <thread>
+
+TEST(batchIsDueOnceFull) {
+    Blockchain chain(":memory:");
+    chain.setContentBatching(3, 0);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    CHECK(chain.addContent(testContent("b", "u"), "u"));
+    CHECK(!chain.contentBatchDue());
+    CHECK(!chain.sealContentBatch("miner"));
+    CHECK(chain.addContent(testContent("c", "u"), "u"));
+    CHECK(chain.contentBatchDue());
+    CHECK(chain.sealContentBatch("miner"));
+    CHECK_EQ(chain.getHeight(), 1);
+    CHECK_EQ(chain.tip()->contents.size(), (size_t)3);
+    CHECK(!chain.contentBatchDue());
+}
+
+TEST(windowSealsAnAgedPartialBatch) {
+    Blockchain chain(":memory:");
+    chain.setContentBatching(10, 1);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+    CHECK(chain.contentBatchDue());
+}
+
+TEST(backdatedUploadDoesNotOpenTheWindow) {
+    Blockchain chain(":memory:");
+    chain.setContentBatching(10, 60);
+    Content backdated = testContent("old", "u");
+    backdated.timestamp -= 120;
+    CHECK(chain.addContent(backdated, "u"));
+    CHECK(!chain.contentBatchDue());
+}
+
+TEST(forceSealsWhateverIsPending) {
+    Blockchain chain(":memory:");
+    chain.setContentBatching(10, 0);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    CHECK(chain.sealContentBatch("miner", true));
+    CHECK_EQ(chain.tip()->contents.size(), (size_t)1);
+}
+
+TEST(statusTracksPendingThenConfirmed) {
+    Blockchain chain(":memory:");
+    chain.setContentBatching(10, 0);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    CHECK(chain.addContent(testContent("b", "u"), "u"));
+    ContentStatus pending = chain.getContentStatus("hash-b");
+    CHECK(pending.found && !pending.confirmed);
+    CHECK_EQ(pending.pendingPosition, (size_t)1);
+    CHECK_EQ(pending.pendingCount, (size_t)2);
+    CHECK(chain.sealContentBatch("miner", true));
+    CHECK(mineContentBlock(chain, "miner", "c"));
+    ContentStatus confirmed = chain.getContentStatus("hash-b");
+    CHECK(confirmed.confirmed);
+    CHECK_EQ(confirmed.height, 1);
+    CHECK_EQ(confirmed.confirmations, 2);
+    CHECK(!chain.getContentStatus("hash-missing").found);
+}
+
+TEST(pendingContentPoolIsBounded) {
+    Blockchain chain(":memory:");
+    chain.setPendingContentLimits(2, 1024 * 1024, 3600);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    CHECK(chain.addContent(testContent("b", "u"), "u"));
+    CHECK(!chain.addContent(testContent("c", "u"), "u"));
+}
+
+TEST(pendingUploadsExpireByArrivalNotTheirTimestamp) {
+    Blockchain chain(":memory:");
+    chain.setContentBatching(10, 0);
+    chain.setPendingContentLimits(10, 1024 * 1024, 60);
+    Content backdated = testContent("old", "u");
+    backdated.timestamp -= 3600;
+    CHECK(chain.addContent(backdated, "u"));
+    // The sweep runs at most once per second
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    CHECK(chain.addContent(testContent("new", "u"), "u"));
+    CHECK(chain.getContentStatus("hash-old").found);
+    CHECK_EQ(chain.getContentStatus("hash-old").pendingCount, (size_t)2);
+}
+
+int main() {
+    return runTests();
+}
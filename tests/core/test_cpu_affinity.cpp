@@ -0,0 +1,77 @@
+// CPU list parsing and thread placement configuration
+#include "test_harness.h"
+#include "cpu_affinity.h"
+#include <sched.h>
+
+static std::vector<int> parsed(const std::string& list) {
+    std::vector<int> cpus = {-1};
+    CHECK(parseCpuList(list, cpus));
+    return cpus;
+}
+
+static bool rejects(const std::string& list) {
+    std::vector<int> cpus;
+    return !parseCpuList(list, cpus);
+}
+
+TEST(listsExpandRangesSortedAndDeduplicated) {
+    CHECK(parsed("0-3,8") == std::vector<int>({0, 1, 2, 3, 8}));
+    CHECK(parsed("8,2-3,3,0") == std::vector<int>({0, 2, 3, 8}));
+    CHECK(parsed("5-5") == std::vector<int>({5}));
+    CHECK(parsed(",1,,2,") == std::vector<int>({1, 2}));
+    CHECK(parsed("").empty());
+}
+
+TEST(malformedListsAreRejected) {
+    for (const char* list : {"a", "1a", "1-", "-1", "3-1", "1-2-3", "1.5", "0-x"}) {
+        CHECK(rejects(list));
+    }
+    CHECK(rejects(std::to_string(CPU_SETSIZE)));
+    CHECK(!rejects(std::to_string(CPU_SETSIZE - 1)));
+}
+
+TEST(formatCollapsesRunsAndRoundTrips) {
+    CHECK_EQ(formatCpuList({0, 1, 2, 3, 8}), std::string("0-3,8"));
+    CHECK_EQ(formatCpuList({1, 3, 4}), std::string("1,3-4"));
+    CHECK_EQ(formatCpuList({}), std::string(""));
+    CHECK_EQ(formatCpuList(parsed("12,0-2,6-7")), std::string("0-2,6-7,12"));
+}
+
+TEST(defaultPlacementLeavesTheScheduler) {
+    ThreadPlacement placement;
+    CHECK(placement.configure("", ""));
+    CHECK_EQ(placement.describe(), std::string("scheduler default"));
+    CHECK(placement.miningSet() == allowedCpus());
+    CHECK_EQ(placement.pinMiningWorker(0), -1);
+}
+
+TEST(configureChecksCpusAgainstTheAffinityMask) {
+    std::vector<int> allowed = allowedCpus();
+    CHECK(!allowed.empty());
+    if (allowed.empty()) return;
+    ThreadPlacement placement;
+    std::string first = std::to_string(allowed.front());
+    CHECK(!placement.configure("x", ""));
+    CHECK(!placement.configure(first, first));
+    CHECK(!placement.configure("", formatCpuList(allowed)));
+    if (allowed.back() < CPU_SETSIZE - 1) CHECK(!placement.configure(std::to_string(CPU_SETSIZE - 1), ""));
+    // Failed calls leave the previous configuration alone
+    CHECK_EQ(placement.describe(), std::string("scheduler default"));
+    CHECK(placement.configure(first, ""));
+    CHECK(placement.getMiningCpus() == std::vector<int>({allowed.front()}));
+    CHECK(placement.miningSet() == std::vector<int>({allowed.front()}));
+}
+
+TEST(reservedCpusAreTakenOutOfTheMiningSet) {
+    std::vector<int> allowed = allowedCpus();
+    if (allowed.size() < 2) return; // needs a spare CPU to reserve
+    ThreadPlacement placement;
+    CHECK(placement.configure("", std::to_string(allowed.front())));
+    std::vector<int> rest(allowed.begin() + 1, allowed.end());
+    CHECK(placement.miningSet() == rest);
+    CHECK_EQ(placement.describe().rfind("mining " + formatCpuList(rest), 0), (size_t)0);
+}
+
+int main() {
+    return runTests();
+}
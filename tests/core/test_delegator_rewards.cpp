@@ -0,0 +1,84 @@
+// Delegator reward split, claims and their replay from the stake event log
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include <chrono>
+#include <thread>
+
+// Produces dave's next DPoS block; one-second slots, so wait for a fresh one
+static bool produce(Blockchain& chain, const std::string& tag) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    return chain.addContent(testContent(tag, "u"), "u") && chain.mineBlockDPoS("dave");
+}
+
+// alice and bob earn coins with PoW blocks, then back dave on a DPoS chain:
+// alice delegates before block 4, bob only before block 5
+static void buildChain(Blockchain& chain) {
+    CHECK(mineContentBlock(chain, "alice", "a1"));
+    CHECK(mineContentBlock(chain, "alice", "a2"));
+    CHECK(mineContentBlock(chain, "bob", "b1"));
+    chain.setConsensusMode(ConsensusMode::DPoS);
+    chain.setDPoSParams(1, 1, 1);
+    CHECK(chain.delegateStake("alice", "dave", 1.0));
+    CHECK(produce(chain, "d1"));
+    CHECK(chain.delegateStake("bob", "dave", 0.5));
+    CHECK(produce(chain, "d2"));
+    CHECK_EQ(chain.getHeight(), 5);
+}
+
+TEST(rewardsSplitOverStakeDelegatedBeforeTheBlock) {
+    Blockchain chain(":memory:");
+    buildChain(chain);
+    double first = chain.getBlockReward(4) * 0.9;
+    double second = chain.getBlockReward(5) * 0.9;
+    CHECK_NEAR(chain.getPendingDelegatorRewards("alice"), first + second * 2 / 3, 1e-9);
+    CHECK_NEAR(chain.getPendingDelegatorRewards("bob"), second / 3, 1e-9);
+    CHECK_NEAR(chain.getBalance("dave"), (chain.getBlockReward(4) + chain.getBlockReward(5)) * 0.1, 1e-9);
+}
+
+TEST(getBalanceLeavesRewardsUnclaimed) {
+    Blockchain chain(":memory:");
+    buildChain(chain);
+    double pending = chain.getPendingDelegatorRewards("alice");
+    double balance = chain.getBalance("alice");
+    uint64_t version = chain.snapshot()->version;
+    CHECK_NEAR(chain.getBalance("alice"), balance, 1e-12);
+    CHECK_NEAR(chain.getPendingDelegatorRewards("alice"), pending, 1e-12);
+    CHECK_EQ(chain.snapshot()->version, version);
+}
+
+TEST(claimMovesRewardsIntoTheBalance) {
+    Blockchain chain(":memory:");
+    buildChain(chain);
+    double pending = chain.getPendingDelegatorRewards("alice");
+    double balance = chain.getBalance("alice");
+    CHECK_NEAR(chain.claimDelegatorRewards("alice"), pending, 1e-12);
+    CHECK_NEAR(chain.getBalance("alice"), balance + pending, 1e-12);
+    CHECK_NEAR(chain.getPendingDelegatorRewards("alice"), 0.0, 1e-12);
+    CHECK_NEAR(chain.claimDelegatorRewards("alice"), 0.0, 1e-12);
+}
+
+TEST(reloadReplaysDelegationsRewardsAndClaims) {
+    std::string path = freshDbPath("delegator_rewards");
+    std::map<std::string, double> balances, pending, delegated;
+    {
+        Blockchain chain(path);
+        buildChain(chain);
+        chain.claimDelegatorRewards("bob");
+        CHECK(chain.saveToDb());
+        balances = chain.getBalances();
+        delegated = chain.getDelegatedStakes();
+        for (const std::string who : {"alice", "bob"}) pending[who] = chain.getPendingDelegatorRewards(who);
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    CHECK_EQ(reopened.getHeight(), 5);
+    for (const std::string who : {"alice", "bob", "dave"}) CHECK_NEAR(reopened.getBalance(who), balances[who], 1e-9);
+    for (const std::string who : {"alice", "bob"}) CHECK_NEAR(reopened.getPendingDelegatorRewards(who), pending[who], 1e-9);
+    CHECK_NEAR(reopened.getDelegatedStakes()["dave"], delegated["dave"], 1e-12);
+    CHECK(pending["alice"] > 0);
+    CHECK_NEAR(pending["bob"], 0.0, 1e-12);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,106 @@
+// Precomputed DPoS epoch schedule and slot checks on incoming blocks
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include <chrono>
+#include <thread>
+
+static void delegate(Blockchain& chain, const std::string& who, double amount) {
+    chain.creditBalance(who, amount);
+    CHECK(chain.delegateStake(who, who, amount));
+}
+
+TEST(slotsAndEpochsDivideTime) {
+    Blockchain chain(":memory:");
+    chain.setDPoSParams(10, 3, 2);
+    CHECK_EQ(chain.slotAt(1000), (uint64_t)100);
+    CHECK_EQ(chain.slotAt(1009), (uint64_t)100);
+    CHECK_EQ(chain.epochOfSlot(5), (uint64_t)0);
+    CHECK_EQ(chain.epochOfSlot(6), (uint64_t)1);
+}
+
+TEST(scheduleIsRoundRobinOverTheTopDelegates) {
+    Blockchain chain(":memory:");
+    chain.setConsensusMode(ConsensusMode::DPoS);
+    chain.setDPoSParams(10, 2, 2);
+    delegate(chain, "small", 1);
+    delegate(chain, "large", 5);
+    delegate(chain, "medium", 3);
+    uint64_t epoch = chain.epochOfSlot(chain.slotAt(std::time(nullptr)));
+    ProducerSchedule schedule = chain.getProducerSchedule(epoch);
+    CHECK_EQ(schedule.producers.size(), (size_t)2);
+    CHECK_EQ(schedule.slots.size(), (size_t)4);
+    if (schedule.producers.size() == 2 && schedule.slots.size() == 4) {
+        CHECK_EQ(schedule.producers[0], std::string("large"));
+        CHECK_EQ(schedule.producers[1], std::string("medium"));
+        CHECK_NEAR(schedule.totalStake, 8.0, 1e-9);
+        CHECK(schedule.slots[0] != schedule.slots[1]);
+        CHECK_EQ(schedule.slots[0], schedule.slots[2]);
+        for (size_t i = 0; i < schedule.slots.size(); ++i) {
+            CHECK_EQ(chain.getScheduledProducer(schedule.firstSlot + i), schedule.slots[i]);
+        }
+    }
+}
+
+// One delegate owns every slot, so blocks differ only in their timestamps
+static void singleDelegate(Blockchain& chain) {
+    chain.setConsensusMode(ConsensusMode::DPoS);
+    chain.setDPoSParams(1, 1, 60);
+    delegate(chain, "alice", 10);
+}
+
+TEST(blockForTheCurrentSlotIsAccepted) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    singleDelegate(ours);
+    singleDelegate(theirs);
+    CHECK(theirs.addContent(testContent("a", "u"), "u"));
+    CHECK(theirs.mineBlockDPoS("alice"));
+    ours.handleP2PMessage(blockMessage(*theirs.tip()), "peer");
+    CHECK_EQ(ours.getHeight(), 1);
+    CHECK(ours.verifyBlockProducer(1));
+}
+
+TEST(blockClaimingAFutureSlotIsRejected) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    singleDelegate(ours);
+    singleDelegate(theirs);
+    CHECK(theirs.addContent(testContent("a", "u"), "u"));
+    CHECK(theirs.mineBlockDPoS("alice"));
+    Block early = *theirs.tip();
+    early.timestamp += 3600;
+    early.hash = theirs.calculateHash(early);
+    ours.handleP2PMessage(blockMessage(early), "peer");
+    CHECK_EQ(ours.getHeight(), 0);
+    CHECK(!ours.resolveFork({theirs.getChain()[0], early}));
+}
+
+TEST(schedulesDoNotDependOnWhenBlocksArrive) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    for (Blockchain* chain : {&ours, &theirs}) {
+        chain->setConsensusMode(ConsensusMode::DPoS);
+        chain->setDPoSParams(1, 2, 1); // two-second epochs of two producers
+        delegate(*chain, "alice", 10);
+        delegate(*chain, "bob", 5);
+    }
+    for (const std::string tag : {"a", "b"}) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        CHECK(theirs.addContent(testContent(tag, "u"), "u"));
+        CHECK(theirs.mineBlockDPoS());
+    }
+    // We see both blocks only after their epochs are over, as a node with a clock
+    // running ahead would; the producer sets must still be the ones theirs used
+    std::this_thread::sleep_for(std::chrono::milliseconds(4100));
+    CHECK(ours.resolveFork(theirs.getChain()));
+    CHECK_EQ(ours.getHeight(), 2);
+    for (int h = 1; h <= 2; ++h) {
+        uint64_t epoch = ours.epochOfSlot(ours.slotAt(ours.blockAt(h)->timestamp));
+        CHECK(ours.getProducerSchedule(epoch).slots == theirs.getProducerSchedule(epoch).slots);
+        CHECK(ours.verifyBlockProducer(h));
+    }
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,132 @@
+// Per-epoch DPoS stake snapshots, derived from the chain at each epoch's boundary block
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include <sqlite3.h>
+#include <chrono>
+#include <thread>
+
+static void delegate(Blockchain& chain, const std::string& who, double amount) {
+    chain.creditBalance(who, amount);
+    CHECK(chain.delegateStake(who, who, amount));
+}
+
+static uint64_t currentEpoch(const Blockchain& chain) {
+    return chain.epochOfSlot(chain.slotAt(std::time(nullptr)));
+}
+
+// Minute-long epochs of two producers
+static void dposChain(Blockchain& chain) {
+    chain.setConsensusMode(ConsensusMode::DPoS);
+    chain.setDPoSParams(10, 2, 3);
+    delegate(chain, "alice", 5);
+}
+
+TEST(epochIsFrozenOnceItsFirstBlockLandsAndSaved) {
+    std::string path = freshDbPath("epoch_snapshots");
+    uint64_t epoch;
+    {
+        Blockchain chain(path);
+        dposChain(chain);
+        CHECK(chain.addContent(testContent("a", "u"), "u"));
+        CHECK(chain.mineBlockDPoS("alice"));
+        epoch = chain.epochOfSlot(chain.slotAt(chain.tip()->timestamp));
+        CHECK_EQ(chain.getProducerSchedule(epoch).producers.size(), (size_t)1);
+        // Stake logged after the epoch's first block waits for the next boundary
+        delegate(chain, "bob", 9);
+        CHECK_EQ(chain.getProducerSchedule(epoch).producers.size(), (size_t)1);
+        CHECK(chain.saveToDb());
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    StakeSnapshot snapshot;
+    CHECK(reopened.getStakeSnapshot(epoch, &snapshot));
+    CHECK_EQ(snapshot.validators.size(), (size_t)1);
+    if (snapshot.validators.size() == 1) CHECK_EQ(snapshot.validators[0].first, std::string("alice"));
+    CHECK_NEAR(snapshot.totalStake, 5.0, 1e-12);
+    CHECK_EQ(snapshot.boundaryHeight, 0);
+}
+
+TEST(pastEpochsAreDerivedFromTheChain) {
+    std::string path = freshDbPath("epoch_snapshots_past");
+    uint64_t first, second;
+    {
+        Blockchain chain(path);
+        chain.setConsensusMode(ConsensusMode::DPoS);
+        chain.setDPoSParams(1, 1, 1); // one-second epochs of one producer
+        delegate(chain, "alice", 10);
+        CHECK(chain.addContent(testContent("a", "u"), "u"));
+        CHECK(chain.mineBlockDPoS("alice"));
+        first = chain.epochOfSlot(chain.slotAt(chain.tip()->timestamp));
+        // Counts from the epoch after block 1, whose boundary it is
+        delegate(chain, "bob", 100);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        CHECK(chain.addContent(testContent("b", "u"), "u"));
+        CHECK(chain.mineBlockDPoS("bob"));
+        second = chain.epochOfSlot(chain.slotAt(chain.tip()->timestamp));
+        CHECK(chain.saveToDb());
+    }
+    // As on a node that never scheduled those epochs itself
+    sqlite3* db = nullptr;
+    CHECK(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+    CHECK(sqlite3_exec(db, "DELETE FROM stake_snapshots;", nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(db);
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    std::string expected;
+    CHECK(reopened.verifyBlockProducer(1, &expected));
+    CHECK_EQ(expected, std::string("alice"));
+    CHECK(reopened.verifyBlockProducer(2, &expected));
+    CHECK_EQ(expected, std::string("bob"));
+    StakeSnapshot snapshot;
+    CHECK(reopened.getStakeSnapshot(first, &snapshot));
+    CHECK_EQ(snapshot.validators.size(), (size_t)1);
+    CHECK(reopened.getStakeSnapshot(second, &snapshot));
+    CHECK_EQ(snapshot.boundaryHeight, 1);
+    CHECK_NEAR(snapshot.totalStake, 100.0, 1e-9); // bob alone: one producer per epoch
+}
+
+TEST(scheduleAskedForBeforeAnyDelegateIsNotPinnedEmpty) {
+    Blockchain chain(":memory:");
+    chain.setConsensusMode(ConsensusMode::DPoS);
+    chain.setDPoSParams(10, 2, 3);
+    uint64_t epoch = currentEpoch(chain);
+    CHECK(chain.getProducerSchedule(epoch).producers.empty());
+    delegate(chain, "alice", 5);
+    CHECK_EQ(chain.getProducerSchedule(epoch).producers.size(), (size_t)1);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    CHECK(chain.mineBlockDPoS("alice"));
+}
+
+TEST(futureEpochIsAPreviewOnly) {
+    Blockchain chain(":memory:");
+    dposChain(chain);
+    uint64_t next = currentEpoch(chain) + 1;
+    CHECK_EQ(chain.getProducerSchedule(next).producers.size(), (size_t)1);
+    delegate(chain, "bob", 9);
+    ProducerSchedule preview = chain.getProducerSchedule(next);
+    CHECK_EQ(preview.producers.size(), (size_t)2);
+    if (!preview.producers.empty()) CHECK_EQ(preview.producers[0], std::string("bob"));
+    StakeSnapshot snapshot;
+    CHECK(!chain.getStakeSnapshot(next, &snapshot));
+}
+
+TEST(blockFromAnElapsedEpochIsAccepted) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    for (Blockchain* chain : {&ours, &theirs}) {
+        chain->setConsensusMode(ConsensusMode::DPoS);
+        chain->setDPoSParams(1, 1, 1); // one-second epochs
+        delegate(*chain, "alice", 10);
+    }
+    CHECK(theirs.addContent(testContent("a", "u"), "u"));
+    CHECK(theirs.mineBlockDPoS("alice"));
+    // Its epoch is over by the time it arrives; the schedule comes from the chain, not our clock
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    ours.handleP2PMessage(blockMessage(*theirs.tip()), "peer");
+    CHECK_EQ(ours.getHeight(), 1);
+    CHECK(ours.verifyBlockProducer(1));
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,121 @@
+// BFT finality gadget tallies and the finalized-height guard on reorgs
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include "finality.h"
+#include <chrono>
+#include <thread>
+
+static FinalityVote vote(const TestWallet& voter, const std::string& hash, int height) {
+    return FinalityGadget::signVote(hash, height, voter.privPem, voter.pubPem);
+}
+
+// Three voters with equal stake; h1 <- h2 <- h3 at heights 1..3
+struct Voters {
+    TestWallet a = makeWallet(), b = makeWallet(), c = makeWallet();
+    std::map<std::string, double> stakes() const { return {{a.address, 1}, {b.address, 1}, {c.address, 1}}; }
+};
+
+static void linkBlocks(FinalityGadget& gadget) {
+    gadget.onBlock("h1", "h0", 1);
+    gadget.onBlock("h2", "h1", 2);
+    gadget.onBlock("h3", "h2", 3);
+}
+
+TEST(twoCertifiedBlocksFinalizeTheParent) {
+    Voters v;
+    FinalityGadget gadget;
+    gadget.setVoters(v.stakes());
+    linkBlocks(gadget);
+    // Two of three is not more than two thirds
+    CHECK_EQ(gadget.addVotes({vote(v.a, "h1", 1), vote(v.b, "h1", 1)}), (size_t)2);
+    CHECK(!gadget.isCertified("h1"));
+    CHECK_EQ(gadget.addVotes({vote(v.c, "h1", 1)}), (size_t)1);
+    CHECK(gadget.isCertified("h1"));
+    CHECK_EQ(gadget.getFinalizedHeight(), 0);
+    gadget.addVotes({vote(v.a, "h2", 2), vote(v.b, "h2", 2), vote(v.c, "h2", 2)});
+    CHECK_EQ(gadget.getFinalizedHeight(), 1);
+    CHECK_EQ(gadget.getFinalizedHash(), std::string("h1"));
+}
+
+TEST(badVotesAreNotCounted) {
+    Voters v;
+    TestWallet outsider = makeWallet();
+    FinalityGadget gadget;
+    gadget.setVoters(v.stakes());
+    linkBlocks(gadget);
+    FinalityVote forged = vote(v.a, "h1", 1);
+    forged.blockHash = "h2";
+    CHECK_EQ(gadget.addVotes({vote(outsider, "h1", 1), forged}), (size_t)0);
+    CHECK_EQ(gadget.invalidSignatureCount(), (uint64_t)1);
+    CHECK_EQ(gadget.addVotes({vote(v.b, "h1", 1)}), (size_t)1);
+    CHECK_EQ(gadget.addVotes({vote(v.b, "h1", 1), vote(v.b, "other", 1)}), (size_t)0);
+    CHECK_EQ(gadget.equivocationCount(), (uint64_t)1);
+}
+
+TEST(changingTheVoterSetClearsTallies) {
+    Voters v;
+    FinalityGadget gadget;
+    gadget.setVoters(v.stakes());
+    linkBlocks(gadget);
+    CHECK_EQ(gadget.addVotes({vote(v.a, "h1", 1)}), (size_t)1);
+    // The same set again keeps what was counted
+    gadget.setVoters(v.stakes());
+    CHECK_EQ(gadget.addVotes({vote(v.a, "h1", 1)}), (size_t)0);
+    // a's vote was weighed against three voters; with two, b alone must not certify
+    gadget.setVoters({{v.a.address, 1}, {v.b.address, 1}});
+    gadget.addVotes({vote(v.b, "h1", 1)});
+    CHECK(!gadget.isCertified("h1"));
+    CHECK_EQ(gadget.addVotes({vote(v.a, "h1", 1)}), (size_t)1);
+    CHECK(gadget.isCertified("h1"));
+}
+
+TEST(votesAtOrBelowTheFinalizedHeightAreIgnored) {
+    Voters v;
+    FinalityGadget gadget;
+    gadget.setVoters(v.stakes());
+    gadget.restoreFinalized(2, "h2");
+    CHECK_EQ(gadget.addVotes({vote(v.a, "h1", 1), vote(v.b, "h2", 2)}), (size_t)0);
+    CHECK_EQ(gadget.getFinalizedHeight(), 2);
+}
+
+// One delegate owning every one-second slot; waits for a fresh slot before producing
+static bool produce(Blockchain& chain, const TestWallet& delegate, const std::string& tag) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    return chain.addContent(testContent(tag, "u"), "u") && chain.mineBlockDPoS(delegate.address);
+}
+
+static void singleDelegate(Blockchain& chain, const TestWallet& delegate) {
+    chain.setConsensusMode(ConsensusMode::DPoS);
+    chain.setDPoSParams(1, 1, 60);
+    chain.creditBalance(delegate.address, 10);
+    CHECK(chain.delegateStake(delegate.address, delegate.address, 10));
+}
+
+TEST(reorgBelowTheFinalizedHeightIsRejected) {
+    TestWallet dave = makeWallet();
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    Blockchain control(":memory:"); // same genesis as the others, never finalized
+    singleDelegate(ours, dave);
+    singleDelegate(theirs, dave);
+    singleDelegate(control, dave);
+    CHECK(produce(ours, dave, "o1"));
+    CHECK(produce(ours, dave, "o2"));
+    std::vector<FinalityVote> votes;
+    for (int h = 1; h <= 2; ++h) votes.push_back(vote(dave, ours.blockAt(h)->hash, h));
+    CHECK_EQ(ours.submitFinalityVotes(votes), (size_t)2);
+    CHECK_EQ(ours.getFinalizedHeight(), 1);
+    // A heavier branch forking at height 1 must not displace the finalized block
+    for (int i = 0; i < 3; ++i) CHECK(produce(theirs, dave, "t" + std::to_string(i)));
+    CHECK(theirs.tip()->chainWork > ours.tip()->chainWork);
+    // Without finalized blocks the same branch wins
+    CHECK(produce(control, dave, "c1"));
+    CHECK(control.resolveFork(theirs.getChain()));
+    CHECK(!ours.resolveFork(theirs.getChain()));
+    CHECK_EQ(ours.getHeight(), 2);
+    CHECK_EQ(ours.blockAt(1)->hash, ours.getFinalizedHash());
+}
+
+int main() {
+    return runTests();
+}
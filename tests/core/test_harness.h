@@ -0,0 +1,75 @@
+#ifndef TEST_HARNESS_H
+#define TEST_HARNESS_H
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Minimal harness for the C++ core: TEST(name) registers a case, CHECK* record a
+// failure and keep going, and runTests() returns non-zero if anything failed.
+struct TestCase {
+    const char* name;
+    void (*fn)();
+};
+
+inline std::vector<TestCase>& testRegistry() {
+    static std::vector<TestCase> registry;
+    return registry;
+}
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct TestRegistrar {
+    TestRegistrar(const char* name, void (*fn)()) { testRegistry().push_back({name, fn}); }
+};
+
+#define TEST(name)                                          \
+    static void name();                                     \
+    static TestRegistrar name##Registrar(#name, name);      \
+    static void name()
+
+#define CHECK(cond)                                                                              \
+    do {                                                                                         \
+        if (!(cond)) {                                                                           \
+            ++testFailures();                                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+        }                                                                                        \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                        \
+    do {                                                                                      \
+        auto checkA = (a);                                                                    \
+        auto checkB = (b);                                                                    \
+        if (!(checkA == checkB)) {                                                            \
+            ++testFailures();                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #a ", " #b ") failed: " \
+                      << checkA << " != " << checkB << std::endl;                             \
+        }                                                                                     \
+    } while (0)
+
+#define CHECK_NEAR(a, b, eps)                                                                    \
+    do {                                                                                         \
+        double checkA = (a);                                                                     \
+        double checkB = (b);                                                                     \
+        if (std::fabs(checkA - checkB) > (eps)) {                                                \
+            ++testFailures();                                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_NEAR(" #a ", " #b ") failed: " \
+                      << checkA << " vs " << checkB << std::endl;                                \
+        }                                                                                        \
+    } while (0)
+
+inline int runTests() {
+    for (const auto& test : testRegistry()) {
+        int before = testFailures();
+        test.fn();
+        std::cout << (testFailures() == before ? "[ OK ] " : "[FAIL] ") << test.name << std::endl;
+    }
+    std::cout << testRegistry().size() << " tests, " << testFailures() << " failed checks" << std::endl;
+    return testFailures() == 0 ? 0 : 1;
+}
+
+#endif // TEST_HARNESS_H
@@ -0,0 +1,203 @@
+// Fee-rate indexed mempool: ordering, limits, eviction and replacement
+#include "test_harness.h"
+#include "blockchain.h"
+
+static Transaction plainTx(const std::string& sender, double fee, uint64_t nonce) {
+    return {sender, "receiver", 1.0, "sig", "pub", fee, nonce};
+}
+
+static std::string idOf(const std::string& sender, uint64_t nonce) {
+    return sender + "#" + std::to_string(nonce);
+}
+
+static Transaction bulkyTx(const std::string& sender, double feeRate, uint64_t nonce, size_t sigBytes) {
+    Transaction tx = plainTx(sender, 0, nonce);
+    tx.signature.assign(sigBytes, 's');
+    tx.fee = feeRate * Mempool::txSize(tx);
+    return tx;
+}
+
+static double rateOf(const Mempool& pool, const std::string& sender, uint64_t nonce) {
+    return pool.find(idOf(sender, nonce))->feeRate;
+}
+
+static bool add(Mempool& pool, const std::string& sender, double fee, uint64_t nonce,
+                std::vector<Transaction>* evicted = nullptr) {
+    return pool.insert(plainTx(sender, fee, nonce), idOf(sender, nonce), evicted);
+}
+
+TEST(bestFirstOrdersByFeeRate) {
+    Mempool pool;
+    CHECK(add(pool, "a", 0.01, 1));
+    CHECK(add(pool, "b", 0.05, 1));
+    CHECK(add(pool, "c", 0.03, 1));
+    std::vector<const Mempool::Entry*> best = pool.bestFirst(10);
+    CHECK_EQ(best.size(), (size_t)3);
+    if (best.size() == 3) {
+        CHECK_EQ(best[0]->tx.sender, std::string("b"));
+        CHECK_EQ(best[1]->tx.sender, std::string("c"));
+        CHECK_EQ(best[2]->tx.sender, std::string("a"));
+    }
+    CHECK(pool.maxFeeRate() > pool.minFeeRate());
+}
+
+TEST(equalFeeRatesKeepArrivalOrder) {
+    Mempool pool;
+    CHECK(add(pool, "first", 0.02, 1));
+    CHECK(add(pool, "second", 0.02, 1));
+    std::vector<const Mempool::Entry*> best = pool.bestFirst(2);
+    CHECK_EQ(best[0]->tx.sender, std::string("first"));
+}
+
+TEST(selectForBlockKeepsSenderNoncesInOrder) {
+    Mempool pool;
+    CHECK(add(pool, "a", 0.01, 1));
+    CHECK(add(pool, "a", 0.09, 2)); // pays more but depends on nonce 1
+    CHECK(add(pool, "b", 0.05, 1));
+    std::vector<const Mempool::Entry*> picked = pool.selectForBlock(10);
+    CHECK_EQ(picked.size(), (size_t)3);
+    if (picked.size() == 3) {
+        CHECK_EQ(picked[0]->txId, idOf("b", 1));
+        CHECK_EQ(picked[1]->txId, idOf("a", 1));
+        CHECK_EQ(picked[2]->txId, idOf("a", 2));
+    }
+    CHECK_EQ(pool.selectForBlock(1).size(), (size_t)1);
+}
+
+TEST(duplicatesAndTakenNoncesAreRejected) {
+    Mempool pool;
+    CHECK(add(pool, "a", 0.01, 1));
+    CHECK(!add(pool, "a", 0.01, 1));
+    CHECK(!pool.insert(plainTx("a", 0.02, 1), "other-id"));
+    CHECK_EQ(pool.size(), (size_t)1);
+}
+
+TEST(countLimitEvictsLowestFeeRate) {
+    Mempool pool;
+    pool.setLimits(2, SIZE_MAX, 3600);
+    CHECK(add(pool, "a", 0.01, 1));
+    CHECK(add(pool, "b", 0.05, 1));
+    std::vector<Transaction> evicted;
+    CHECK(add(pool, "c", 0.03, 1, &evicted));
+    CHECK_EQ(pool.size(), (size_t)2);
+    CHECK(!pool.contains(idOf("a", 1)));
+    CHECK_EQ(evicted.size(), (size_t)1);
+    CHECK_EQ(pool.evictionCount(), (uint64_t)1);
+    // Cannot outbid the cheapest remaining entry
+    CHECK(!add(pool, "d", 0.02, 1));
+    CHECK_EQ(pool.size(), (size_t)2);
+}
+
+TEST(evictionTakesTheVictimsLaterNonces) {
+    Mempool pool;
+    pool.setLimits(3, SIZE_MAX, 3600);
+    CHECK(add(pool, "a", 0.01, 1));
+    CHECK(add(pool, "a", 0.09, 2));
+    CHECK(add(pool, "b", 0.05, 1));
+    CHECK(add(pool, "c", 0.03, 1));
+    CHECK_EQ(pool.size(), (size_t)2);
+    CHECK(!pool.contains(idOf("a", 2)));
+}
+
+TEST(oldestPolicyEvictsByArrival) {
+    Mempool pool;
+    pool.setLimits(2, SIZE_MAX, 3600);
+    pool.setEvictionPolicy(MempoolEvictionPolicy::Oldest);
+    CHECK(add(pool, "a", 0.09, 1));
+    CHECK(add(pool, "b", 0.01, 1));
+    CHECK(add(pool, "c", 0.001, 1));
+    CHECK(!pool.contains(idOf("a", 1)));
+    CHECK(pool.contains(idOf("b", 1)));
+}
+
+TEST(byteLimitIsAccounted) {
+    Mempool pool;
+    CHECK(add(pool, "a", 0.01, 1));
+    size_t one = pool.bytes();
+    CHECK(one > Mempool::txSize(plainTx("a", 0.01, 1)));
+    CHECK(add(pool, "b", 0.01, 1));
+    CHECK_EQ(pool.bytes(), 2 * one);
+    CHECK(pool.remove(idOf("a", 1)));
+    CHECK_EQ(pool.bytes(), one);
+    pool.clear();
+    CHECK_EQ(pool.bytes(), (size_t)0);
+}
+
+TEST(expireDropsEntriesPastTtl) {
+    Mempool pool;
+    pool.setLimits(10, SIZE_MAX, 60);
+    std::time_t now = std::time(nullptr);
+    CHECK(pool.restore(plainTx("old", 0.01, 1), idOf("old", 1), now - 120));
+    CHECK(add(pool, "new", 0.01, 1));
+    std::vector<Transaction> expired;
+    CHECK_EQ(pool.expire(now, &expired), (size_t)1);
+    CHECK(pool.contains(idOf("new", 1)));
+    CHECK_EQ(pool.expiredCount(), (uint64_t)1);
+}
+
+TEST(failedInsertEvictsNothing) {
+    Mempool pool;
+    CHECK(add(pool, "a", 0.01, 1));
+    CHECK(add(pool, "b", 0.10, 1));
+    pool.setLimits(10, pool.bytes(), 3600);
+    uint64_t revision = pool.getRevision();
+    // Needs both slots, outbids a but not b
+    Transaction big = bulkyTx("c", (rateOf(pool, "a", 1) + rateOf(pool, "b", 1)) / 2, 1, pool.bytes() * 3 / 4);
+    std::vector<Transaction> evicted;
+    CHECK(!pool.insert(big, idOf("c", 1), &evicted));
+    CHECK_EQ(pool.size(), (size_t)2);
+    CHECK(pool.contains(idOf("a", 1)));
+    CHECK(evicted.empty());
+    CHECK_EQ(pool.evictionCount(), (uint64_t)0);
+    CHECK_EQ(pool.getRevision(), revision);
+}
+
+TEST(replaceSwapsEntryAndKeepsLaterNonces) {
+    Mempool pool;
+    CHECK(add(pool, "a", 0.01, 1));
+    CHECK(add(pool, "a", 0.01, 2));
+    Transaction replaced;
+    CHECK(pool.replace(plainTx("a", 0.05, 1), "a#1-bumped", &replaced));
+    CHECK_NEAR(replaced.fee, 0.01, 1e-12);
+    CHECK(!pool.contains(idOf("a", 1)));
+    CHECK(pool.contains("a#1-bumped"));
+    CHECK(pool.contains(idOf("a", 2)));
+    CHECK_EQ(pool.replacementCount(), (uint64_t)1);
+    CHECK(!pool.replace(plainTx("a", 0.05, 9), "a#9"));
+}
+
+TEST(failedReplaceChangesNothing) {
+    Mempool pool;
+    CHECK(add(pool, "a", 0.01, 1));
+    CHECK(add(pool, "b", 0.05, 1));
+    CHECK(add(pool, "c", 0.10, 1));
+    pool.setLimits(10, pool.bytes(), 3600);
+    uint64_t revision = pool.getRevision();
+    // Needs b's slot plus a's and c's; outbids a but not c
+    Transaction big = bulkyTx("b", (rateOf(pool, "a", 1) + rateOf(pool, "c", 1)) / 2, 1, pool.bytes() * 3 / 4);
+    std::vector<Transaction> evicted;
+    CHECK(!pool.replace(big, "b#1-bumped", nullptr, &evicted));
+    CHECK_EQ(pool.size(), (size_t)3);
+    CHECK(pool.contains(idOf("a", 1)));
+    CHECK(pool.contains(idOf("b", 1)));
+    CHECK(evicted.empty());
+    CHECK_EQ(pool.replacementCount(), (uint64_t)0);
+    CHECK_EQ(pool.getRevision(), revision);
+}
+
+TEST(pendingDebitsTrackSenderTotals) {
+    Mempool pool;
+    CHECK(add(pool, "a", 0.5, 1));
+    CHECK(add(pool, "a", 0.5, 2));
+    CHECK_NEAR(pool.pendingDebit("a"), 3.0, 1e-9);
+    CHECK_EQ(pool.nextNonce("a", 0), (uint64_t)3);
+    CHECK(pool.remove(idOf("a", 2)));
+    CHECK_NEAR(pool.pendingDebit("a"), 1.5, 1e-9);
+    CHECK(pool.remove(idOf("a", 1)));
+    CHECK_EQ(pool.pendingDebit("a"), 0.0);
+    CHECK_EQ(pool.nextNonce("a", 7), (uint64_t)8);
+}
+
+int main() {
+    return runTests();
+}
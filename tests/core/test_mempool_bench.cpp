@@ -0,0 +1,21 @@
+// Mempool admission benchmark
+#include "test_harness.h"
+#include "bench.h"
+
+TEST(everyPreSignedTransactionIsAdmitted) {
+    MempoolBenchConfig config;
+    config.wallets = 4;
+    config.txsPerWallet = 3;
+    config.threads = 2;
+    MempoolBenchReport report = runMempoolBench(config);
+    CHECK_EQ(report.submitted, (size_t)12);
+    CHECK_EQ(report.accepted, (size_t)12);
+    CHECK_EQ(report.threads, 2u);
+    CHECK(report.acceptedPerSecond > 0);
+    CHECK(report.p99Micros >= report.p50Micros);
+    CHECK(report.verifyMicros > 0);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,76 @@
+// Paginated mempool and pending-content queries
+#include "test_harness.h"
+#include "chain_fixtures.h"
+
+// Five transactions from alice with fees 0.01..0.05 in nonce (and arrival) order
+static TestWallet fillMempool(Blockchain& chain) {
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 100);
+    for (uint64_t n = 1; n <= 5; ++n) CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01 * n, n)));
+    return alice;
+}
+
+TEST(feeOrderPagesDoNotOverlap) {
+    Blockchain chain(":memory:");
+    fillMempool(chain);
+    std::vector<Mempool::Entry> first = chain.queryMempool(MempoolOrder::FeeRate, 0, 2);
+    std::vector<Mempool::Entry> second = chain.queryMempool(MempoolOrder::FeeRate, 2, 2);
+    std::vector<Mempool::Entry> last = chain.queryMempool(MempoolOrder::FeeRate, 4, 2);
+    CHECK_EQ(first.size(), (size_t)2);
+    CHECK_EQ(second.size(), (size_t)2);
+    CHECK_EQ(last.size(), (size_t)1);
+    CHECK(first[0].feeRate >= first[1].feeRate && first[1].feeRate >= second[0].feeRate);
+    CHECK_EQ(first[0].tx.nonce, (uint64_t)5);
+    CHECK(chain.queryMempool(MempoolOrder::FeeRate, 5, 2).empty());
+}
+
+TEST(newestOrderStartsWithTheLatestArrival) {
+    Blockchain chain(":memory:");
+    fillMempool(chain);
+    std::vector<Mempool::Entry> page = chain.queryMempool(MempoolOrder::Newest, 0, 3);
+    CHECK_EQ(page.size(), (size_t)3);
+    CHECK_EQ(page[0].tx.nonce, (uint64_t)5);
+    CHECK_EQ(page[2].tx.nonce, (uint64_t)3);
+}
+
+TEST(lookupsBySenderAndTxid) {
+    Blockchain chain(":memory:");
+    TestWallet alice = fillMempool(chain);
+    std::vector<Mempool::Entry> mine = chain.getMempoolBySender(alice.address);
+    CHECK_EQ(mine.size(), (size_t)5);
+    CHECK_EQ(mine[0].tx.nonce, (uint64_t)1);
+    Mempool::Entry found;
+    CHECK(chain.findMempoolTx(mine[2].txId, &found));
+    CHECK_EQ(found.tx.nonce, (uint64_t)3);
+    CHECK(!chain.findMempoolTx("missing", &found));
+    CHECK(chain.getMempoolBySender("nobody").empty());
+}
+
+TEST(statsSummarizeBothPools) {
+    Blockchain chain(":memory:");
+    fillMempool(chain);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    MempoolStats stats = chain.getMempoolStats();
+    CHECK_EQ(stats.count, (size_t)5);
+    CHECK(stats.bytes > stats.txBytes);
+    CHECK(stats.maxFeeRate > stats.minFeeRate);
+    size_t histogramCount = 0;
+    for (const auto& bucket : stats.feeHistogram) histogramCount += bucket.count;
+    CHECK_EQ(histogramCount, (size_t)5);
+    CHECK_EQ(stats.pendingContents, (size_t)1);
+    CHECK(stats.pendingContentBytes > 0);
+}
+
+TEST(pendingContentsPageInArrivalOrder) {
+    Blockchain chain(":memory:");
+    for (int i = 0; i < 5; ++i) CHECK(chain.addContent(testContent("c" + std::to_string(i), "u"), "u"));
+    std::vector<Content> page = chain.getPendingContents(1, 2);
+    CHECK_EQ(page.size(), (size_t)2);
+    CHECK_EQ(page[0].hash, std::string("hash-c1"));
+    CHECK_EQ(page[1].hash, std::string("hash-c2"));
+    CHECK(chain.getPendingContents(5, 2).empty());
+}
+
+int main() {
+    return runTests();
+}
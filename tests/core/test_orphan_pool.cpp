@@ -0,0 +1,129 @@
+// Orphan pool for out-of-order block arrival
+#include "test_harness.h"
+#include "chain_fixtures.h"
+
+static Block orphan(const std::string& hash, const std::string& prevHash, size_t payload = 0) {
+    Block block;
+    block.index = 5;
+    block.hash = hash;
+    block.prevHash = prevHash;
+    block.timestamp = 0;
+    block.nonce = 0;
+    block.difficulty = 1;
+    block.miner = std::string(payload, 'm');
+    return block;
+}
+
+TEST(childrenComeBackInArrivalOrder) {
+    OrphanBlockPool pool;
+    CHECK(pool.add(orphan("b", "a"), "peer", 100));
+    CHECK(pool.add(orphan("c", "a"), "peer", 100));
+    CHECK(pool.add(orphan("d", "x"), "peer", 100));
+    CHECK(!pool.add(orphan("b", "a"), "peer", 100));
+    std::vector<Block> children = pool.takeChildren("a");
+    CHECK_EQ(children.size(), (size_t)2);
+    if (children.size() == 2) {
+        CHECK_EQ(children[0].hash, std::string("b"));
+        CHECK_EQ(children[1].hash, std::string("c"));
+    }
+    CHECK_EQ(pool.size(), (size_t)1);
+    CHECK_EQ(pool.connectedCount(), (uint64_t)2);
+}
+
+TEST(limitsEvictTheOldest) {
+    OrphanBlockPool pool;
+    pool.setLimits(2, SIZE_MAX, 3600);
+    CHECK(pool.add(orphan("a", "p"), "peer", 100));
+    CHECK(pool.add(orphan("b", "p"), "peer", 100));
+    CHECK(pool.add(orphan("c", "p"), "peer", 100));
+    CHECK(!pool.contains("a"));
+    CHECK_EQ(pool.evictionCount(), (uint64_t)1);
+    pool.setLimits(10, OrphanBlockPool::blockSize(orphan("x", "p")) / 2, 3600);
+    CHECK(!pool.add(orphan("big", "p", 64), "peer", 100));
+}
+
+TEST(expireDropsStaleOrphans) {
+    OrphanBlockPool pool;
+    pool.setLimits(10, SIZE_MAX, 60);
+    CHECK(pool.add(orphan("old", "p"), "peer", 100));
+    CHECK(pool.add(orphan("new", "p"), "peer", 150));
+    CHECK_EQ(pool.expire(170), (size_t)1);
+    CHECK(pool.contains("new"));
+    CHECK_EQ(pool.bytes(), OrphanBlockPool::blockSize(orphan("new", "p")));
+}
+
+TEST(onePeerCannotTakeThePool) {
+    OrphanBlockPool pool;
+    pool.setLimits(10, SIZE_MAX, 3600);
+    pool.setPeerLimit(2);
+    CHECK(pool.add(orphan("a", "p"), "spammer", 100));
+    CHECK(pool.add(orphan("b", "p"), "spammer", 100));
+    CHECK(!pool.add(orphan("c", "p"), "spammer", 100));
+    CHECK(pool.add(orphan("d", "p"), "honest", 100));
+    CHECK_EQ(pool.peerRejectionCount(), (uint64_t)1);
+    // Connected orphans free the peer's share again
+    CHECK_EQ(pool.takeChildren("p").size(), (size_t)3);
+    CHECK(pool.add(orphan("c", "p"), "spammer", 100));
+}
+
+TEST(outOfOrderBlocksConnectWhenTheParentArrives) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(theirs, "miner", "o" + std::to_string(i)));
+    ours.handleP2PMessage(blockMessage(*theirs.blockAt(3)), "peer");
+    ours.handleP2PMessage(blockMessage(*theirs.blockAt(2)), "peer");
+    CHECK_EQ(ours.getHeight(), 0);
+    CHECK_EQ(ours.getOrphanCount(), (size_t)2);
+    ours.handleP2PMessage(blockMessage(*theirs.blockAt(1)), "peer");
+    CHECK_EQ(ours.getHeight(), 3);
+    CHECK_EQ(ours.getOrphanCount(), (size_t)0);
+}
+
+TEST(orphansFailingHeaderChecksAreNotPooled) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    for (int i = 0; i < 2; ++i) CHECK(mineContentBlock(theirs, "miner", "h" + std::to_string(i)));
+    Block wrongHash = *theirs.blockAt(2);
+    wrongHash.hash[10] = wrongHash.hash[10] == 'a' ? 'b' : 'a';
+    ours.handleP2PMessage(blockMessage(wrongHash), "peer");
+    // Self-consistent hash that misses its own target
+    Block noWork = *theirs.blockAt(2);
+    do {
+        ++noWork.nonce;
+        noWork.hash = theirs.calculateHash(noWork);
+    } while (Uint256::fromHex(noWork.hash) <= Blockchain::blockTarget(noWork));
+    ours.handleP2PMessage(blockMessage(noWork), "peer");
+    Block zeroWork = *theirs.blockAt(2);
+    zeroWork.difficulty = 0;
+    zeroWork.bits = 0;
+    zeroWork.hash = theirs.calculateHash(zeroWork);
+    ours.handleP2PMessage(blockMessage(zeroWork), "peer");
+    CHECK_EQ(ours.getOrphanCount(), (size_t)0);
+    ours.handleP2PMessage(blockMessage(*theirs.blockAt(1)), "peer");
+    CHECK_EQ(ours.getHeight(), 1);
+}
+
+TEST(cheapOrphansAtTheEasiestTargetAreNotPooled) {
+    Blockchain ours(":memory:");
+    // A long target block time makes our fast test blocks retarget hard
+    CHECK(ours.setRetargetParams(3600, 45));
+    for (int i = 0; i < 2; ++i) CHECK(mineContentBlock(ours, "miner", "t" + std::to_string(i)));
+    Uint256 ceiling = Blockchain::powLimit();
+    ceiling >>= 8;
+    CHECK(Uint256::fromCompact(ours.getNextBits()) < ceiling);
+    Block cheap = *ours.blockAt(1);
+    cheap.index = 5;
+    cheap.prevHash = std::string(64, 'f');
+    cheap.timestamp = std::time(nullptr);
+    cheap.bits = Blockchain::powLimit().toCompact();
+    do {
+        ++cheap.nonce;
+        cheap.hash = ours.calculateHash(cheap);
+    } while (Uint256::fromHex(cheap.hash) > Blockchain::blockTarget(cheap));
+    ours.handleP2PMessage(blockMessage(cheap), "peer");
+    CHECK_EQ(ours.getOrphanCount(), (size_t)0);
+}
+
+int main() {
+    return runTests();
+}
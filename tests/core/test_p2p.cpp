@@ -0,0 +1,81 @@
+// Peer policy (bans, rate limits) and message delivery over the TLS transport
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include <chrono>
+#include <thread>
+
+static bool waitForHeight(const Blockchain& chain, int height, int seconds) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (chain.getHeight() < height) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return true;
+}
+
+TEST(blockedPeersAreIgnoredAndDropped) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    CHECK(mineContentBlock(theirs, "miner", "a"));
+    ours.blockPeer("bad");
+    CHECK(ours.isPeerBlocked("bad"));
+    ours.handleP2PMessage(blockMessage(*theirs.tip()), "bad");
+    CHECK_EQ(ours.getHeight(), 0);
+    ours.unblockPeer("bad");
+    ours.handleP2PMessage(blockMessage(*theirs.tip()), "bad");
+    CHECK_EQ(ours.getHeight(), 1);
+}
+
+TEST(floodingPeerIsRateLimitedThenBlocked) {
+    Blockchain chain(":memory:");
+    // At most two one-second windows pass, so one of them overflows
+    for (int i = 0; i < 2000; ++i) chain.handleP2PMessage("{\"type\":\"noop\"}", "flood");
+    CHECK(chain.isPeerBlocked("flood"));
+    CHECK(!chain.isPeerBlocked("quiet"));
+}
+
+TEST(serverReceivesBlocksOverTls) {
+    // Built together so both carry the same genesis
+    Blockchain sender(":memory:");
+    Blockchain receiver(":memory:");
+    CHECK(receiver.startP2PServer(18481));
+    CHECK(!receiver.startP2PServer(18481));
+    CHECK(mineContentBlock(sender, "miner", "a"));
+    sender.broadcastBlockToPeer(*sender.tip(), "127.0.0.1", 18481);
+    CHECK(waitForHeight(receiver, 1, 10));
+    receiver.stopP2PServer();
+}
+
+TEST(helloTriggersSyncFromTheLongerPeer) {
+    Blockchain ahead(":memory:");
+    Blockchain behind(":memory:");
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(ahead, "miner", "s" + std::to_string(i)));
+    ahead.localAddress = "127.0.0.1:18482";
+    behind.localAddress = "127.0.0.1:18483";
+    CHECK(ahead.startP2PServer(18482));
+    CHECK(behind.startP2PServer(18483));
+    // Each side adds the other and the shorter one fetches what it lacks
+    ahead.connectToPeerTCP("127.0.0.1", 18483);
+    CHECK(waitForHeight(behind, 3, 20));
+    CHECK_EQ(behind.tip()->hash, ahead.tip()->hash);
+    CHECK(behind.getPeers().count("127.0.0.1:18482"));
+    ahead.stopP2PServer();
+    behind.stopP2PServer();
+}
+
+TEST(knownPeersPersist) {
+    std::string path = freshDbPath("known_peers");
+    {
+        Blockchain chain(path);
+        chain.addKnownPeer("10.0.0.1", 9000);
+        chain.addKnownPeer("10.0.0.1", 9000);
+    }
+    Blockchain reopened(path);
+    auto peers = reopened.getKnownPeers();
+    CHECK_EQ(peers.size(), (size_t)1);
+    CHECK(peers.count({"10.0.0.1", 9000}));
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,96 @@
+// Multi-threaded full-chain verification
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include <sqlite3.h>
+
+TEST(parallelVerifyAcceptsValidChain) {
+    Blockchain chain(":memory:");
+    for (int i = 0; i < 5; ++i) CHECK(mineContentBlock(chain, "miner", "v" + std::to_string(i)));
+    ChainVerifyReport report = chain.verifyChainParallel(3);
+    CHECK(report.valid);
+    CHECK_EQ(report.threads, 3u);
+    CHECK_EQ(report.blocksChecked, (size_t)6);
+    CHECK_EQ(report.firstInvalidHeight, -1);
+    CHECK_EQ(chain.getVerifiedHeight(), 5);
+}
+
+TEST(singleThreadMatchesMany) {
+    Blockchain chain(":memory:");
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(chain, "miner", "s" + std::to_string(i)));
+    ChainVerifyReport one = chain.verifyChainParallel(1);
+    ChainVerifyReport many = chain.verifyChainParallel(8);
+    CHECK(one.valid && many.valid);
+    CHECK_EQ(one.blocksChecked, many.blocksChecked);
+    CHECK_EQ(one.txsChecked, many.txsChecked);
+}
+
+TEST(moreThreadsThanBlocks) {
+    Blockchain chain(":memory:");
+    CHECK(mineContentBlock(chain, "miner", "t0"));
+    ChainVerifyReport report = chain.verifyChainParallel(16);
+    CHECK(report.valid);
+    CHECK_EQ(report.threads, 16u);
+    CHECK_EQ(report.blocksChecked, (size_t)2);
+}
+
+// Rewrites stored blocks with a bad merkle root (not covered by the block hash)
+static void tamperMerkleRoots(const std::string& path, const Blockchain& chain, std::vector<int> heights) {
+    sqlite3* db = nullptr;
+    CHECK(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+    for (int height : heights) {
+        Block forged = *chain.blockAt(height);
+        forged.merkleRoot = "tampered";
+        std::string sql = "UPDATE blocks SET data = '" + blockMessage(forged) + "' WHERE id = " + std::to_string(height) + ";";
+        CHECK(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+    }
+    sqlite3_close(db);
+}
+
+TEST(earliestFailureAcrossChunksIsReported) {
+    std::string path = freshDbPath("parallel_chunks");
+    {
+        Blockchain chain(path);
+        // Past the first 64-block chunk; stake blocks need no mining
+        chain.setConsensusMode(ConsensusMode::PoS);
+        chain.creditBalance("alice", 10);
+        CHECK(chain.stake("alice", 10));
+        for (int i = 0; i < 70; ++i) CHECK(chain.addContent(testContent("c" + std::to_string(i), "u"), "u") && chain.mineBlockPoS());
+        CHECK(chain.saveToDb());
+        tamperMerkleRoots(path, chain, {68, 66});
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    for (unsigned threads : {1u, 4u}) {
+        ChainVerifyReport report = reopened.verifyChainParallel(threads);
+        CHECK(!report.valid);
+        CHECK_EQ(report.firstInvalidHeight, 66);
+        CHECK_EQ(report.reason, std::string("merkle root mismatch"));
+        CHECK_EQ(report.blocksChecked, (size_t)66);
+    }
+    CHECK_EQ(reopened.getVerifiedHeight(), 0);
+}
+
+TEST(agreesWithTheSerialAuditOnABadChain) {
+    std::string path = freshDbPath("parallel_serial");
+    {
+        Blockchain chain(path);
+        for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(chain, "miner", "a" + std::to_string(i)));
+        CHECK(chain.saveToDb());
+        tamperMerkleRoots(path, chain, {2});
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    CHECK(!reopened.verifyChain(true));
+    ChainVerifyReport report = reopened.verifyChainParallel(3);
+    CHECK(!report.valid);
+    CHECK_EQ(report.firstInvalidHeight, 2);
+    // A clean chain passes both
+    Blockchain clean(":memory:");
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(clean, "miner", "a" + std::to_string(i)));
+    CHECK(clean.verifyChain(true));
+    CHECK(clean.verifyChainParallel(3).valid);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,87 @@
+// Proof-of-work kernels: both must find exactly what calculateHash accepts
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include "pow_kernel.h"
+#include "uint256.h"
+
+// The next block of a chain with one pending upload, stamped for miner
+static Block pendingBlock(Blockchain& chain, std::string* bodyData) {
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    BlockTemplatePtr tpl = chain.getBlockTemplate();
+    Block block = tpl->block;
+    block.timestamp = std::time(nullptr);
+    block.miner = "miner";
+    *bodyData = tpl->bodyData;
+    return block;
+}
+
+static PowSearcher searcherFor(const Block& block, const std::string& bodyData, const std::string& targetHex,
+                               PowKernel kernel) {
+    return PowSearcher(Blockchain::headerPrefix(block), Blockchain::headerSuffix(block, bodyData), targetHex, kernel);
+}
+
+TEST(kernelsFindTheFirstNonceCalculateHashAccepts) {
+    Blockchain chain(":memory:");
+    std::string body;
+    Block block = pendingBlock(chain, &body);
+    std::string target = Uint256::fromCompact(block.bits).toHex();
+    int64_t found[2] = {-1, -1};
+    int i = 0;
+    for (PowKernel kernel : {PowKernel::OneShot, PowKernel::Midstate}) {
+        uint64_t hashes = 0;
+        CHECK(searcherFor(block, body, target, kernel).search(0, 1 << 20, &found[i], &hashes));
+        CHECK_EQ(hashes, (uint64_t)found[i] + 1);
+        ++i;
+    }
+    CHECK_EQ(found[0], found[1]);
+    for (int64_t nonce = 0; nonce <= found[1]; ++nonce) {
+        block.nonce = (int)nonce;
+        bool meets = Uint256::fromHex(chain.calculateHash(block)) <= Uint256::fromHex(target);
+        CHECK_EQ(meets, nonce == found[1]);
+    }
+}
+
+TEST(targetIsInclusive) {
+    Blockchain chain(":memory:");
+    std::string body;
+    Block block = pendingBlock(chain, &body);
+    block.nonce = 12345;
+    std::string hash = chain.calculateHash(block);
+    for (PowKernel kernel : {PowKernel::OneShot, PowKernel::Midstate}) {
+        int64_t nonce = 0;
+        uint64_t hashes = 0;
+        CHECK(searcherFor(block, body, hash, kernel).search(12345, 12346, &nonce, &hashes));
+        CHECK_EQ(nonce, (int64_t)12345);
+        CHECK_EQ(hashes, (uint64_t)1);
+    }
+}
+
+TEST(missesCountEveryAttempt) {
+    Blockchain chain(":memory:");
+    std::string body;
+    Block block = pendingBlock(chain, &body);
+    PowSearcher searcher = searcherFor(block, body, std::string(64, '0'), PowKernel::Midstate);
+    int64_t nonce = -1;
+    uint64_t hashes = 0;
+    CHECK(!searcher.search(0, 1000, &nonce, &hashes));
+    CHECK_EQ(hashes, (uint64_t)1000);
+    CHECK(!searcher.search(5, 5, &nonce, &hashes));
+    CHECK_EQ(hashes, (uint64_t)1000);
+    CHECK_EQ(nonce, (int64_t)-1);
+}
+
+TEST(shortTargetsAreLeftPadded) {
+    // 63 hex digits read as 0fff...f, so the first digest byte must be below 0x10
+    PowSearcher searcher("prefix", "suffix", std::string(63, 'f'));
+    int64_t nonce = -1;
+    uint64_t hashes = 0;
+    CHECK(searcher.search(0, 1000, &nonce, &hashes));
+    std::string input = "prefix" + std::to_string(nonce) + "suffix";
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)input.data(), input.size(), hash);
+    CHECK(hash[0] < 0x10);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,61 @@
+// Replace-by-fee keyed on (sender, nonce)
+#include "test_harness.h"
+#include "chain_fixtures.h"
+
+static bool pendingHasFee(const Blockchain& chain, double fee) {
+    for (const auto& tx : chain.getMempool()) {
+        if (std::fabs(tx.fee - fee) < 1e-9) return true;
+    }
+    return false;
+}
+
+TEST(betterPayingVersionReplacesTheSlot) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 10);
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 1)));
+    CHECK(chain.addTransaction(signedTx(alice, "carol", 1, 0.05, 1)));
+    CHECK_EQ(chain.getMempool().size(), (size_t)1);
+    CHECK(pendingHasFee(chain, 0.05));
+    CHECK(chain.mineBlock("miner"));
+    CHECK_NEAR(chain.getBalance("carol"), 1.0, 1e-9);
+    CHECK_NEAR(chain.getBalance("bob"), 0.0, 1e-9);
+}
+
+TEST(replacementMustClearBothFeeBumps) {
+    Blockchain chain(":memory:");
+    chain.setReplacementFeeRatio(1.5);
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 10);
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.10, 1)));
+    CHECK(!chain.addTransaction(signedTx(alice, "bob", 1, 0.14, 1))); // under the ratio
+    CHECK(!chain.addTransaction(signedTx(alice, "bob", 1, 0.10, 1))); // identical: duplicate txid
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.16, 1)));
+    CHECK(pendingHasFee(chain, 0.16));
+}
+
+TEST(replacementKeepsLaterNoncesAndFundingRules) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 5);
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 2, 0.01, 1)));
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 2, 0.01, 2)));
+    // Releasing nonce 1's debit still leaves nonce 2's owed
+    CHECK(!chain.addTransaction(signedTx(alice, "bob", 3.5, 0.05, 1)));
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 2.5, 0.05, 1)));
+    CHECK_EQ(chain.getMempool().size(), (size_t)2);
+    CHECK_EQ(chain.getNextNonce(alice.address), (uint64_t)3);
+}
+
+TEST(confirmedNonceCannotBeReplaced) {
+    Blockchain chain(":memory:");
+    TestWallet alice = makeWallet();
+    chain.creditBalance(alice.address, 10);
+    CHECK(chain.addTransaction(signedTx(alice, "bob", 1, 0.01, 1)));
+    CHECK(chain.mineBlock("miner"));
+    CHECK(!chain.addTransaction(signedTx(alice, "carol", 1, 0.5, 1)));
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,161 @@
+// LWMA retargeting and the target checks on fork and audit paths
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include "uint256.h"
+#include <sqlite3.h>
+
+// count + 1 PoW headers at the given compact target, spaced solveTime apart
+static std::vector<Block> headers(size_t count, uint32_t bits, int solveTime) {
+    std::vector<Block> blocks(count + 1);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        blocks[i].difficulty = 1;
+        blocks[i].bits = bits;
+        blocks[i].timestamp = 1000000 + (std::time_t)i * solveTime;
+    }
+    return blocks;
+}
+
+static std::vector<const Block*> pointers(const std::vector<Block>& blocks) {
+    std::vector<const Block*> history;
+    for (const auto& block : blocks) history.push_back(&block);
+    return history;
+}
+
+// How much harder the next target is than the headers' own
+static double workRatio(const std::vector<Block>& blocks, size_t window) {
+    uint32_t next = Blockchain::lwmaNextBits(pointers(blocks), 60, window);
+    return Uint256::fromCompact(next).work() / Uint256::fromCompact(blocks.back().bits).work();
+}
+
+TEST(emptyHistoryStartsAtThePowLimit) {
+    CHECK_EQ(Blockchain::lwmaNextBits({}, 60, 45), Blockchain::powLimit().toCompact());
+}
+
+TEST(onTargetSolveTimesKeepTheTarget) {
+    CHECK_NEAR(workRatio(headers(45, 0x1d00ffff, 60), 45), 1.0, 1e-3);
+}
+
+TEST(fastBlocksRaiseTheWork) {
+    CHECK_NEAR(workRatio(headers(45, 0x1d00ffff, 30), 45), 2.0, 1e-2);
+}
+
+TEST(slowSolveTimesAreClampedAtSixTargets) {
+    CHECK_NEAR(workRatio(headers(45, 0x1d00ffff, 3600), 45), 1.0 / 6, 1e-3);
+}
+
+TEST(onlyTheWindowCounts) {
+    // Fast blocks followed by a window's worth on target: the fast ones fall out
+    std::vector<Block> blocks = headers(20, 0x1d00ffff, 10);
+    std::time_t t = blocks.back().timestamp;
+    for (int i = 1; i <= 10; ++i) {
+        Block block = blocks.back();
+        block.timestamp = t + i * 60;
+        blocks.push_back(block);
+    }
+    CHECK_NEAR(workRatio(blocks, 10), 1.0, 1e-3);
+}
+
+TEST(targetNeverExceedsThePowLimit) {
+    uint32_t limit = Blockchain::powLimit().toCompact();
+    CHECK_EQ(Blockchain::lwmaNextBits(pointers(headers(45, limit, 3600)), 60, 45), limit);
+}
+
+// Re-mines a block after changing its bits so the proof still holds
+static Block withBits(const Blockchain& chain, Block block, uint32_t bits) {
+    block.bits = bits;
+    for (block.nonce = 0;; ++block.nonce) {
+        block.hash = chain.calculateHash(block);
+        if (Uint256::fromHex(block.hash) <= Blockchain::blockTarget(block)) return block;
+    }
+}
+
+TEST(auditsRederiveBitsFromTheStoredAncestry) {
+    std::string path = freshDbPath("retarget_audit");
+    uint32_t easiest = Blockchain::powLimit().toCompact();
+    {
+        Blockchain chain(path);
+        for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(chain, "miner", "a" + std::to_string(i)));
+        CHECK(chain.saveToDb());
+        CHECK(chain.verifyChainParallel(2).valid);
+        // Swap the tip for a copy mined at the easiest target
+        Block forged = withBits(chain, *chain.tip(), easiest);
+        CHECK(forged.bits != chain.tip()->bits);
+        sqlite3* db = nullptr;
+        CHECK(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+        std::string sql = "UPDATE blocks SET data = '" + blockMessage(forged) + "' WHERE id = 3;";
+        CHECK(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+        sqlite3_close(db);
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    CHECK_EQ(reopened.tip()->bits, easiest);
+    CHECK(!reopened.verifyChain(true));
+    ChainVerifyReport report = reopened.verifyChainParallel(2);
+    CHECK(!report.valid);
+    CHECK_EQ(report.firstInvalidHeight, 3);
+    CHECK_EQ(report.reason, std::string("bits do not match the retarget"));
+}
+
+TEST(forkBlocksAreCheckedAgainstTheirOwnBranch) {
+    Blockchain ours(":memory:");
+    Blockchain control(":memory:");
+    Blockchain theirs(":memory:");
+    CHECK(mineContentBlock(theirs, "miner", "t1"));
+    CHECK(mineContentBlock(theirs, "miner", "t2"));
+    std::vector<Block> branch = theirs.getChain();
+    CHECK(control.resolveFork(branch));
+    // The second block's parent is off our chain, so only the branch's own history can catch it
+    branch[2] = withBits(theirs, branch[2], Blockchain::powLimit().toCompact());
+    CHECK(!ours.resolveFork(branch));
+    CHECK_EQ(ours.getHeight(), 0);
+}
+
+TEST(legacyBlocksBelowTheActivationHeightStillAudit) {
+    std::string path = freshDbPath("retarget_legacy");
+    {
+        Blockchain chain(path);
+        for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(chain, "miner", "a" + std::to_string(i)));
+        CHECK(chain.saveToDb());
+        // Rewrite it as a chain from before LWMA: two leading-zero blocks, then one retargeted from them
+        std::vector<Block> blocks = chain.getChain();
+        for (size_t h = 1; h < blocks.size(); ++h) {
+            blocks[h].prevHash = blocks[h - 1].hash;
+            std::vector<Block> ancestry(blocks.begin(), blocks.begin() + h);
+            std::vector<const Block*> history = pointers(ancestry);
+            uint32_t bits = h < 3 ? 0 : Blockchain::lwmaNextBits(history, chain.getTargetBlockTime(), chain.getRetargetWindow());
+            blocks[h] = withBits(chain, blocks[h], bits);
+        }
+        sqlite3* db = nullptr;
+        CHECK(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+        for (size_t h = 1; h < blocks.size(); ++h) {
+            std::string sql = "UPDATE blocks SET data = '" + blockMessage(blocks[h]) + "' WHERE id = " + std::to_string(h) + ";";
+            CHECK(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+        }
+        CHECK(sqlite3_exec(db, "DELETE FROM chain_meta WHERE key = 'lwma_activation_height';", nullptr, nullptr, nullptr) == SQLITE_OK);
+        sqlite3_close(db);
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    CHECK_EQ(reopened.getChain()[1].bits, (uint32_t)0);
+    CHECK(reopened.verifyChain(true));
+    CHECK(reopened.verifyChainParallel(2).valid);
+    // Blocks from here on still need a target
+    CHECK(mineContentBlock(reopened, "miner", "b"));
+    CHECK(reopened.tip()->bits != 0);
+    CHECK(reopened.verifyChain(true));
+}
+
+TEST(retargetParamsArePinnedOnceBlocksUseThem) {
+    Blockchain chain(":memory:");
+    CHECK(chain.setRetargetParams(60, 10));
+    CHECK(mineContentBlock(chain, "miner", "a"));
+    CHECK(mineContentBlock(chain, "miner", "b"));
+    CHECK(!chain.setRetargetParams(120, 20));
+    CHECK_EQ(chain.getTargetBlockTime(), 60);
+    CHECK_EQ(chain.getRetargetWindow(), (size_t)10);
+    CHECK(chain.verifyChainParallel(2).valid);
+}
+
+int main() {
+    return runTests();
+}
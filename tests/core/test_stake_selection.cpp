@@ -0,0 +1,141 @@
+// Stake-weighted producer selection and the producer checks on stake blocks
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include "stake_index.h"
+
+TEST(selectMapsPointsToStakeRanges) {
+    StakeIndex index;
+    index.set("a", 1);
+    index.set("b", 2);
+    index.set("c", 3);
+    CHECK_NEAR(index.total(), 6.0, 1e-12);
+    CHECK_EQ(index.select(0), std::string("a"));
+    CHECK_EQ(index.select(0.99), std::string("a"));
+    CHECK_EQ(index.select(1.0), std::string("b"));
+    CHECK_EQ(index.select(2.99), std::string("b"));
+    CHECK_EQ(index.select(3.0), std::string("c"));
+    CHECK_EQ(index.select(5.99), std::string("c"));
+}
+
+TEST(updatesKeepSlotsAndSkipZeroWeights) {
+    StakeIndex index;
+    index.set("a", 1);
+    index.set("b", 1);
+    index.add("a", -1);
+    CHECK_NEAR(index.weightOf("a"), 0.0, 1e-12);
+    for (double r : {0.0, 0.5, 0.99}) CHECK_EQ(index.select(r), std::string("b"));
+    index.add("a", 3);
+    CHECK_EQ(index.size(), (size_t)2);
+    CHECK_EQ(index.select(0.5), std::string("a"));
+    index.clear();
+    CHECK(index.select(0).empty());
+    CHECK(index.selectSeeded("seed").empty());
+}
+
+TEST(seededSelectionIsDeterministicAndStakeWeighted) {
+    StakeIndex index;
+    index.set("small", 1);
+    index.set("large", 9);
+    CHECK_EQ(index.selectSeeded("block-hash"), index.selectSeeded("block-hash"));
+    int large = 0;
+    for (int i = 0; i < 2000; ++i) large += index.selectSeeded("seed" + std::to_string(i)) == "large";
+    CHECK(large > 1650 && large < 1950);
+    double unit = StakeIndex::seedToUnit("x");
+    CHECK(unit >= 0 && unit < 1);
+}
+
+// Two stakers with equal stake on a fresh PoS chain
+static void stakeEqually(Blockchain& chain) {
+    chain.setConsensusMode(ConsensusMode::PoS);
+    for (const std::string staker : {"alice", "bob"}) {
+        chain.creditBalance(staker, 10);
+        CHECK(chain.stake(staker, 10));
+    }
+}
+
+TEST(posBlockFromTheSelectedStakerIsAccepted) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    stakeEqually(ours);
+    stakeEqually(theirs);
+    CHECK(theirs.addContent(testContent("a", "u"), "u"));
+    CHECK(theirs.mineBlockPoS());
+    ours.handleP2PMessage(blockMessage(*theirs.tip()), "peer");
+    CHECK_EQ(ours.getHeight(), 1);
+}
+
+TEST(posBlockFromAnotherStakerIsRejected) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    stakeEqually(ours);
+    stakeEqually(theirs);
+    CHECK(theirs.addContent(testContent("a", "u"), "u"));
+    CHECK(theirs.mineBlockPoS());
+    Block forged = *theirs.tip();
+    forged.miner = forged.miner == "alice" ? "bob" : "alice";
+    forged.hash = theirs.calculateHash(forged);
+    ours.handleP2PMessage(blockMessage(forged), "peer");
+    CHECK_EQ(ours.getHeight(), 0);
+}
+
+// Sole staker alice, then a much larger stake from bob once block 1 exists
+static void stakeAlice(Blockchain& chain) {
+    chain.setConsensusMode(ConsensusMode::PoS);
+    chain.creditBalance("alice", 10);
+    CHECK(chain.stake("alice", 10));
+}
+
+static void stakeBobHeavily(Blockchain& chain) {
+    chain.creditBalance("bob", 1e12);
+    CHECK(chain.stake("bob", 1e12));
+}
+
+TEST(laterStakeDoesNotUnseatAStoredProducer) {
+    Blockchain chain(":memory:");
+    stakeAlice(chain);
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    CHECK(chain.mineBlockPoS());
+    stakeBobHeavily(chain);
+    std::string expected;
+    CHECK(chain.verifyBlockProducer(1, &expected));
+    CHECK_EQ(expected, std::string("alice"));
+    CHECK(chain.addContent(testContent("b", "u"), "u"));
+    CHECK(chain.mineBlockPoS());
+    CHECK_EQ(chain.tip()->miner, std::string("bob"));
+}
+
+TEST(reorgChecksProducersAgainstTheStakeTheySaw) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    stakeAlice(ours);
+    stakeAlice(theirs);
+    CHECK(ours.addContent(testContent("a", "u"), "u"));
+    CHECK(ours.mineBlockPoS());
+    // Logged on our branch only, so it has no say over their blocks
+    stakeBobHeavily(ours);
+    for (const std::string tag : {"b", "c"}) {
+        CHECK(theirs.addContent(testContent(tag, "u"), "u"));
+        CHECK(theirs.mineBlockPoS());
+    }
+    CHECK(ours.resolveFork(theirs.getChain()));
+    CHECK_EQ(ours.getHeight(), 2);
+    CHECK(ours.verifyBlockProducer(1) && ours.verifyBlockProducer(2));
+    CHECK(ours.addContent(testContent("d", "u"), "u"));
+    CHECK(ours.mineBlockPoS());
+    CHECK_EQ(ours.tip()->miner, std::string("bob"));
+}
+
+TEST(zeroWorkBlockIsRejectedUnderPoW) {
+    Blockchain ours(":memory:");
+    Blockchain theirs(":memory:");
+    stakeEqually(theirs);
+    CHECK(theirs.addContent(testContent("a", "u"), "u"));
+    CHECK(theirs.mineBlockPoS());
+    ours.handleP2PMessage(blockMessage(*theirs.tip()), "peer");
+    CHECK_EQ(ours.getHeight(), 0);
+    CHECK(!ours.resolveFork(theirs.getChain()));
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,96 @@
+// Copy-on-write state maps behind published snapshots
+#include "test_harness.h"
+#include "chain_fixtures.h"
+
+TEST(cowMapClonesOnlyWhenShared) {
+    CowMap<std::map<std::string, double>> map;
+    map.edit()["a"] = 1;
+    CHECK_EQ(map.cloneCount(), (uint64_t)0);
+    auto published = map.share();
+    CHECK(published.get() == &map.get());
+    map.edit()["a"] = 2;
+    CHECK_EQ(map.cloneCount(), (uint64_t)1);
+    CHECK_EQ(published->at("a"), 1.0);
+    CHECK_EQ(map.get().at("a"), 2.0);
+    map.edit()["b"] = 3; // no longer shared: edits in place
+    CHECK_EQ(map.cloneCount(), (uint64_t)1);
+}
+
+TEST(cowMapDroppedShareMeansNoClone) {
+    CowMap<std::map<std::string, uint64_t>> map;
+    { auto published = map.share(); }
+    map.edit()["a"] = 1;
+    CHECK_EQ(map.cloneCount(), (uint64_t)0);
+}
+
+static BlockPtr blockAtHeight(int index) {
+    Block block;
+    block.index = index;
+    return std::make_shared<const Block>(block);
+}
+
+TEST(blockListSharesItsStoreWithViews) {
+    BlockList list;
+    for (int i = 0; i < 3; ++i) list.push_back(blockAtHeight(i));
+    ChainView first = list.share();
+    for (int i = 3; i < 50; ++i) list.push_back(blockAtHeight(i));
+    ChainView second = list.share();
+    CHECK_EQ(list.copyCount(), (uint64_t)1); // the initial allocation only
+    CHECK(first.begin() == second.begin());
+    CHECK_EQ(first.size(), (size_t)3);
+    CHECK_EQ(second.size(), (size_t)50);
+    CHECK_EQ(second.back()->index, 49);
+}
+
+TEST(blockListTruncationLeavesViewsIntact) {
+    BlockList list;
+    for (int i = 0; i < 5; ++i) list.push_back(blockAtHeight(i));
+    ChainView published = list.share();
+    // A reorg drops two blocks and connects a different pair
+    list.resize(3);
+    list.push_back(blockAtHeight(30));
+    list.push_back(blockAtHeight(40));
+    CHECK_EQ(list.copyCount(), (uint64_t)2);
+    CHECK_EQ(published.size(), (size_t)5);
+    CHECK_EQ(published[3]->index, 3);
+    CHECK_EQ(published[4]->index, 4);
+    CHECK_EQ(list[3]->index, 30);
+    // The new store is not shared yet, so later appends stay in place
+    list.push_back(blockAtHeight(50));
+    CHECK_EQ(list.copyCount(), (uint64_t)2);
+}
+
+TEST(publishingDoesNotCopyTheChain) {
+    Blockchain chain(":memory:");
+    CHECK(mineContentBlock(chain, "miner", "a"));
+    StateSnapshotPtr before = chain.snapshot();
+    CHECK(mineContentBlock(chain, "miner", "b"));
+    chain.creditBalance("alice", 1);
+    StateSnapshotPtr after = chain.snapshot();
+    CHECK(before->chain.begin() == after->chain.begin());
+    CHECK_EQ(before->chain.size(), (size_t)2);
+    CHECK_EQ(after->chain.size(), (size_t)3);
+}
+
+TEST(untouchedMapsAreSharedAcrossSnapshots) {
+    Blockchain chain(":memory:");
+    CHECK(mineContentBlock(chain, "miner", "a"));
+    StateSnapshotPtr before = chain.snapshot();
+    CHECK(mineContentBlock(chain, "miner", "b"));
+    StateSnapshotPtr after = chain.snapshot();
+    // Mining credits the miner but leaves stakes alone
+    CHECK(before->balances != after->balances);
+    CHECK(before->stakes == after->stakes);
+    CHECK(before->balances->at("miner") < after->balances->at("miner"));
+}
+
+TEST(snapshotBalancesMatchGetBalance) {
+    Blockchain chain(":memory:");
+    CHECK(mineContentBlock(chain, "miner", "a"));
+    StateSnapshotPtr state = chain.snapshot();
+    CHECK_NEAR(state->balances->at("miner"), chain.getBalance("miner"), 1e-9);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,65 @@
+// 256-bit targets: compact encoding, hex parsing and arithmetic
+#include "test_harness.h"
+#include "uint256.h"
+
+TEST(compactRoundTripsForNormalizedValues) {
+    for (uint32_t compact : {0x1d00ffffu, 0x1b0404cbu, 0x207fffffu, 0x03123456u, 0x01120000u, 0x02008000u}) {
+        CHECK_EQ(Uint256::fromCompact(compact).toCompact(), compact);
+    }
+}
+
+TEST(compactDecodesExponentAndMantissa) {
+    CHECK_EQ(Uint256::fromCompact(0x03123456).toHex(), std::string(58, '0') + "123456");
+    CHECK_EQ(Uint256::fromCompact(0x01120000).toHex(), std::string(62, '0') + "12");
+    CHECK_EQ(Uint256::fromCompact(0x05123456).toHex(), std::string(54, '0') + "1234560000");
+    // Exponents beyond 32 bytes do not fit
+    CHECK(Uint256::fromCompact(0x217fffff).isZero());
+}
+
+TEST(compactKeepsTheSignBitClear) {
+    // 0x80 would set the mantissa's top bit, so it moves up a byte
+    CHECK_EQ(Uint256(0x80).toCompact(), (uint32_t)0x02008000);
+    CHECK(Uint256::fromCompact(0x02008000) == Uint256(0x80));
+}
+
+TEST(compactTruncatesToTheTopMantissaBits) {
+    Uint256 value = Uint256::fromHex("00000000ffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    Uint256 rounded = Uint256::fromCompact(value.toCompact());
+    CHECK(rounded <= value);
+    CHECK_EQ(rounded.toHex(), "00000000ffff0000000000000000000000000000000000000000000000000000");
+    CHECK_EQ(rounded.toCompact(), value.toCompact());
+}
+
+TEST(hexRoundTripsAndPadsShortInput) {
+    std::string hex = "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f";
+    CHECK_EQ(Uint256::fromHex(hex).toHex(), hex);
+    CHECK(Uint256::fromHex("ff") == Uint256(255));
+}
+
+TEST(leadingZerosMatchTheLegacyRuleAndItsWork) {
+    CHECK_EQ(Uint256::fromLeadingZeros(1).toHex(), "0" + std::string(63, 'f'));
+    CHECK_EQ(Uint256::fromLeadingZeros(3).toHex(), "000" + std::string(61, 'f'));
+    CHECK_NEAR(Uint256::fromLeadingZeros(3).work(), 4096.0, 1e-6);
+    CHECK_NEAR(Uint256::fromLeadingZeros(5).work() / Uint256::fromLeadingZeros(4).work(), 16.0, 1e-9);
+}
+
+TEST(shiftsAndWordArithmetic) {
+    Uint256 value(1);
+    value <<= 200;
+    CHECK_EQ(value.bitLength(), 201u);
+    value >>= 199;
+    CHECK(value == Uint256(2));
+    Uint256 product(0xffffffffULL);
+    product *= 0x10000;
+    CHECK(product == Uint256(0xffffffff0000ULL));
+    product /= 0x10000;
+    CHECK(product == Uint256(0xffffffffULL));
+    product += Uint256(1);
+    CHECK(product == Uint256(0x100000000ULL));
+    CHECK(Uint256(3) < Uint256(4));
+    CHECK(Uint256().isZero());
+}
+
+int main() {
+    return runTests();
+}
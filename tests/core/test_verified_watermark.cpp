@@ -0,0 +1,79 @@
+// Incremental validation above the persisted verified-height watermark
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include <sqlite3.h>
+
+TEST(verifyAdvancesWatermarkToTip) {
+    Blockchain chain(":memory:");
+    CHECK_EQ(chain.getVerifiedHeight(), 0);
+    for (int i = 0; i < 3; ++i) CHECK(mineContentBlock(chain, "miner", "w" + std::to_string(i)));
+    CHECK(chain.verifyChain(false));
+    CHECK_EQ(chain.getVerifiedHeight(), 3);
+    CHECK(mineContentBlock(chain, "miner", "w3"));
+    CHECK(chain.isValidChain());
+    CHECK_EQ(chain.getVerifiedHeight(), 4);
+}
+
+TEST(fullVerifyStillSucceedsFromGenesis) {
+    Blockchain chain(":memory:");
+    for (int i = 0; i < 2; ++i) CHECK(mineContentBlock(chain, "miner", "f" + std::to_string(i)));
+    CHECK(chain.verifyChain(false));
+    CHECK(chain.verifyChain(true));
+    CHECK_EQ(chain.getVerifiedHeight(), 2);
+}
+
+TEST(watermarkSurvivesReopen) {
+    std::string path = freshDbPath("watermark");
+    {
+        Blockchain chain(path);
+        for (int i = 0; i < 2; ++i) CHECK(mineContentBlock(chain, "miner", "p" + std::to_string(i)));
+        CHECK(chain.verifyChain(false));
+        CHECK(chain.saveToDb());
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    CHECK_EQ(reopened.getHeight(), 2);
+    CHECK_EQ(reopened.getVerifiedHeight(), 2);
+}
+
+TEST(routineCheckAdvancesArePersisted) {
+    std::string path = freshDbPath("watermark_routine");
+    {
+        Blockchain chain(path);
+        for (int i = 0; i < 2; ++i) CHECK(mineContentBlock(chain, "miner", "r" + std::to_string(i)));
+        CHECK(chain.saveToDb());
+        CHECK(chain.isValidChain());
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    CHECK_EQ(reopened.getVerifiedHeight(), 2);
+}
+
+// The merkle root is outside the block hash, so only the per-block checks catch this
+TEST(serialAndParallelAuditsRejectTheSameTampering) {
+    std::string path = freshDbPath("watermark_merkle");
+    {
+        Blockchain chain(path);
+        for (int i = 0; i < 2; ++i) CHECK(mineContentBlock(chain, "miner", "m" + std::to_string(i)));
+        CHECK(chain.saveToDb());
+        Block forged = *chain.tip();
+        forged.merkleRoot = "not-a-merkle-root";
+        sqlite3* db = nullptr;
+        CHECK(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+        std::string sql = "UPDATE blocks SET data = '" + blockMessage(forged) + "' WHERE id = 2;";
+        CHECK(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+        sqlite3_close(db);
+    }
+    Blockchain reopened(path);
+    CHECK(reopened.loadFromDb());
+    CHECK(!reopened.verifyChain(true));
+    CHECK_EQ(reopened.getVerifiedHeight(), 0);
+    ChainVerifyReport report = reopened.verifyChainParallel(2);
+    CHECK(!report.valid);
+    CHECK_EQ(report.firstInvalidHeight, 2);
+    CHECK_EQ(report.reason, std::string("merkle root mismatch"));
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,165 @@
+// Work server: share checks, nonce ranges and misbehaving workers
+#include "test_harness.h"
+#include "chain_fixtures.h"
+#include "work_server.h"
+#include <openssl/sha.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <cerrno>
+
+// Blocking test client with a receive timeout; rcvbuf > 0 shrinks its socket buffer
+struct Client {
+    int fd = -1;
+    std::string inbox;
+    explicit Client(int port, int rcvbuf = 0) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (rcvbuf > 0) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        timeval timeout{3, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    ~Client() {
+        if (fd >= 0) close(fd);
+    }
+    void send(const std::string& data) { ::send(fd, data.data(), data.size(), MSG_NOSIGNAL); }
+    void send(const nlohmann::json& message) { send(message.dump() + "\n"); }
+    // Next message, or null on timeout or disconnect
+    nlohmann::json read() {
+        size_t end;
+        while ((end = inbox.find('\n')) == std::string::npos) {
+            char buffer[65536];
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return nullptr;
+            inbox.append(buffer, n);
+        }
+        std::string line = inbox.substr(0, end);
+        inbox.erase(0, end + 1);
+        return nlohmann::json::parse(line);
+    }
+    // True once the server has closed the connection
+    bool closedByServer() {
+        char buffer[65536];
+        for (;;) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n == 0) return true;
+            if (n < 0) return errno == ECONNRESET;
+        }
+    }
+};
+
+static std::string hashHex(const std::string& data) {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), hash);
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char c : hash) {
+        hex.push_back(digits[c >> 4]);
+        hex.push_back(digits[c & 0xf]);
+    }
+    return hex;
+}
+
+static std::string unhex(const std::string& hex) {
+    std::string raw;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) raw.push_back((char)std::stoi(hex.substr(i, 2), nullptr, 16));
+    return raw;
+}
+
+// First nonce in the job's range whose hash meets the given target field
+static int64_t findNonce(const nlohmann::json& job, const std::string& targetField) {
+    std::string prefix = unhex(job["prefix"]), suffix = unhex(job["suffix"]);
+    std::string target = job[targetField];
+    for (int64_t nonce = job["nonceStart"]; nonce < job["nonceEnd"].get<int64_t>(); ++nonce) {
+        if (hashHex(prefix + std::to_string(nonce) + suffix) <= target) return nonce;
+    }
+    return -1;
+}
+
+static nlohmann::json subscribe(Client& client, const std::string& name) {
+    client.send(nlohmann::json{{"method", "subscribe"}, {"worker", name}});
+    return client.read();
+}
+
+static nlohmann::json submit(Client& client, const nlohmann::json& job, int64_t nonce) {
+    client.send(nlohmann::json{{"method", "submit"}, {"jobId", job["jobId"]}, {"nonce", nonce}});
+    return client.read();
+}
+
+TEST(workersMineBlocksFromTheirOwnRanges) {
+    Blockchain chain(":memory:");
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    WorkServer server(chain, "pool");
+    CHECK(server.start(18461));
+    Client alice(18461), bob(18461);
+    nlohmann::json aliceJob = subscribe(alice, "alice");
+    nlohmann::json bobJob = subscribe(bob, "bob");
+    CHECK_EQ(aliceJob.value("method", ""), std::string("job"));
+    CHECK_EQ(bobJob.value("jobId", 0), aliceJob.value("jobId", 0));
+    CHECK(bobJob.value("nonceStart", 0) >= aliceJob.value("nonceEnd", 0));
+    // A share from alice's range does not count when bob submits it
+    int64_t share = findNonce(aliceJob, "shareTarget");
+    CHECK(share > 0);
+    nlohmann::json stolen = submit(bob, bobJob, share);
+    CHECK(!stolen.value("accepted", true));
+    CHECK_EQ(stolen.value("reason", ""), std::string("nonce outside assigned range"));
+    CHECK(submit(alice, aliceJob, share).value("accepted", false));
+    CHECK_EQ(submit(alice, aliceJob, share).value("reason", ""), std::string("duplicate share"));
+    int64_t nonce = findNonce(aliceJob, "target");
+    CHECK(nonce > 0);
+    nlohmann::json result = submit(alice, aliceJob, nonce);
+    CHECK(result.value("block", false));
+    CHECK_EQ(chain.getHeight(), 1);
+    CHECK_EQ(chain.tip()->miner, std::string("pool"));
+    server.stop();
+    WorkServerStats stats = server.getStats();
+    CHECK_EQ(stats.blocksFound, (uint64_t)1);
+    CHECK_EQ(stats.sharesRejected, (uint64_t)2);
+}
+
+TEST(overlongLineDisconnectsTheWorker) {
+    Blockchain chain(":memory:");
+    WorkServer server(chain, "pool");
+    CHECK(server.start(18462));
+    Client client(18462);
+    client.send(std::string(64 * 1024, 'x'));
+    CHECK(client.closedByServer());
+    server.stop();
+}
+
+TEST(workerThatStopsReadingDoesNotStallTheOthers) {
+    Blockchain chain(":memory:");
+    CHECK(chain.addContent(testContent("a", "u"), "u"));
+    WorkServer server(chain, "pool");
+    CHECK(server.start(18463));
+    Client stalled(18463, 4096);
+    subscribe(stalled, "stalled");
+    // Every request gets a job back that is never read
+    std::string requests;
+    for (int i = 0; i < 20000; ++i) requests += nlohmann::json{{"method", "exhausted"}, {"jobId", 1}}.dump() + "\n";
+    std::thread flood([&] { stalled.send(requests); });
+    Client healthy(18463);
+    CHECK_EQ(subscribe(healthy, "healthy").value("method", ""), std::string("job"));
+    flood.join();
+    // The stalled worker is dropped once its backlog passes the cap
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (server.getStats().workers != 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    CHECK_EQ(server.getStats().workers, (size_t)1);
+    server.stop();
+}
+
+int main() {
+    return runTests();
+}